@@ -0,0 +1,75 @@
+#include "AudioClock.h"
+
+juce::int64 AudioClock::getHostTimeNs(const uint64_t* deviceHostTimeNs)
+{
+    if (deviceHostTimeNs != nullptr)
+        return static_cast<juce::int64>(*deviceHostTimeNs);
+
+    auto ticks = juce::Time::getHighResolutionTicks();
+    auto ticksPerSecond = juce::Time::getHighResolutionTicksPerSecond();
+
+    // Split the conversion so the multiplication can't overflow on long uptimes
+    return (ticks / ticksPerSecond) * 1000000000LL
+         + ((ticks % ticksPerSecond) * 1000000000LL) / ticksPerSecond;
+}
+
+void AudioClock::publish(const Anchor& anchor)
+{
+    // Seqlock: an odd sequence number means a write is in progress
+    auto seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    hostTimeNs.store(anchor.hostTimeNs, std::memory_order_relaxed);
+    position.store(anchor.position, std::memory_order_relaxed);
+    deviceSamples.store(anchor.deviceSamples, std::memory_order_relaxed);
+    sampleRate.store(anchor.sampleRate, std::memory_order_relaxed);
+    running.store(anchor.isRunning, std::memory_order_relaxed);
+
+    sequence.store(seq + 2, std::memory_order_release);
+}
+
+bool AudioClock::read(Anchor& anchor) const
+{
+    for (int attempt = 0; attempt < 16; ++attempt)
+    {
+        auto before = sequence.load(std::memory_order_acquire);
+
+        if (before == 0)
+            return false;
+
+        if ((before & 1) != 0)
+            continue;
+
+        anchor.hostTimeNs = hostTimeNs.load(std::memory_order_relaxed);
+        anchor.position = position.load(std::memory_order_relaxed);
+        anchor.deviceSamples = deviceSamples.load(std::memory_order_relaxed);
+        anchor.sampleRate = sampleRate.load(std::memory_order_relaxed);
+        anchor.isRunning = running.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (sequence.load(std::memory_order_relaxed) == before)
+            return anchor.sampleRate > 0.0;
+    }
+
+    return false;
+}
+
+void AudioClock::reset()
+{
+    sequence.store(0, std::memory_order_release);
+}
+
+double AudioClock::getPositionAt(const Anchor& anchor, juce::int64 timeNs, double targetSampleRate)
+{
+    if (anchor.sampleRate <= 0.0)
+        return 0.0;
+
+    auto seconds = static_cast<double>(anchor.position) / anchor.sampleRate;
+
+    if (anchor.isRunning)
+        seconds += static_cast<double>(timeNs - anchor.hostTimeNs) * 1.0e-9;
+
+    return seconds * targetSampleRate;
+}
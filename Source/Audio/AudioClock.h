@@ -0,0 +1,49 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Shared timeline between the playback callback and the recording callback.
+ * The playback side publishes where the transport was at a given host time, the
+ * recording side maps its own block timestamps onto that timeline to find out
+ * which song sample each recorded sample belongs to.
+ */
+class AudioClock
+{
+public:
+    struct Anchor
+    {
+        juce::int64 hostTimeNs = 0;
+        juce::int64 position = 0;       // Transport position in samples at hostTimeNs
+        juce::int64 deviceSamples = 0;  // Samples the playback device has processed, for drift estimation
+        double sampleRate = 0.0;
+        bool isRunning = false;
+    };
+
+    AudioClock() = default;
+
+    // Host time of the current block, from the device when it provides one, otherwise
+    // from the high resolution counter (which shares the same epoch on all platforms)
+    static juce::int64 getHostTimeNs(const uint64_t* deviceHostTimeNs);
+
+    // Writer side - a single real-time thread
+    void publish(const Anchor& anchor);
+
+    // Reader side - any thread. Returns false if no anchor has been published yet
+    bool read(Anchor& anchor) const;
+
+    void reset();
+
+    // Song position (in samples at targetSampleRate) that the given host time corresponds to
+    static double getPositionAt(const Anchor& anchor, juce::int64 hostTimeNs, double targetSampleRate);
+
+private:
+    std::atomic<juce::uint32> sequence { 0 };
+    std::atomic<juce::int64> hostTimeNs { 0 };
+    std::atomic<juce::int64> position { 0 };
+    std::atomic<juce::int64> deviceSamples { 0 };
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<bool> running { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioClock)
+};
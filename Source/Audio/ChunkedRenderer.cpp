@@ -0,0 +1,152 @@
+#include "ChunkedRenderer.h"
+
+namespace
+{
+    // How many chunks each thread may render ahead of the one the sink is waiting for. Keeps
+    // every core busy through uneven chunks without holding the whole song in memory.
+    constexpr int chunksAheadPerThread = 2;
+
+    struct ChunkJob
+    {
+        juce::AudioBuffer<float> audio;
+        juce::WaitableEvent done;
+        bool succeeded = false;
+    };
+
+    bool renderChunk(ChunkedRenderer::Processor& processor, const ChunkedRenderer::Chunk& chunk, juce::int64 warmupSamples,
+                     juce::AudioBuffer<float>& audio, std::atomic<bool>& cancelled, const std::function<bool()>& shouldExit)
+    {
+        auto numChannels = audio.getNumChannels();
+        auto latency = processor.getLatencySamples();
+        auto endSample = chunk.startSample + chunk.numSamples;
+
+        // A full render starts from silence at zero, so never warm up from before it
+        auto renderStart = juce::jmax<juce::int64>(0, chunk.startSample - warmupSamples);
+        auto renderEnd = endSample + latency;
+
+        juce::AudioBuffer<float> block(numChannels, ChunkedRenderer::blockSize);
+        processor.reset();
+
+        for (auto position = renderStart; position < renderEnd; position += ChunkedRenderer::blockSize)
+        {
+            if (cancelled || shouldExit())
+            {
+                cancelled = true;
+                return false;
+            }
+
+            auto blockLength = static_cast<int>(juce::jmin<juce::int64>(ChunkedRenderer::blockSize, renderEnd - position));
+            processor.process(block, position, blockLength);
+
+            // What comes out of the processor is from latency samples earlier
+            auto outputStart = position - latency;
+            auto first = juce::jmax(chunk.startSample, outputStart);
+            auto last = juce::jmin(endSample, outputStart + blockLength);
+
+            if (last > first)
+                for (int channel = 0; channel < numChannels; ++channel)
+                    audio.copyFrom(channel, static_cast<int>(first - chunk.startSample), block, channel,
+                                   static_cast<int>(first - outputStart), static_cast<int>(last - first));
+        }
+
+        return true;
+    }
+}
+
+juce::Array<ChunkedRenderer::Chunk> ChunkedRenderer::split(juce::int64 startSample, juce::int64 numSamples, juce::int64 chunkSamples)
+{
+    juce::Array<Chunk> chunks;
+    chunkSamples = juce::jmax<juce::int64>(1, chunkSamples);
+
+    for (juce::int64 offset = 0; offset < numSamples; offset += chunkSamples)
+        chunks.add({ startSample + offset, juce::jmin(chunkSamples, numSamples - offset) });
+
+    return chunks;
+}
+
+bool ChunkedRenderer::render(const juce::Array<Chunk>& chunks, int numChannels, juce::int64 warmupSamples,
+                             const std::function<std::unique_ptr<Processor>()>& createProcessor,
+                             const Sink& sink, const std::function<bool()>& shouldExit,
+                             const std::function<void(double progress)>& onProgress)
+{
+    auto numChunks = chunks.size();
+
+    if (numChunks == 0)
+        return true;
+
+    auto numThreads = juce::jmin(numChunks, juce::SystemStats::getNumCpus());
+
+    // Readers aren't thread-safe, so every worker needs its own processor. They're handed back
+    // after each chunk rather than thrown away, so files are opened once per thread, not per chunk.
+    std::vector<std::unique_ptr<Processor>> idleProcessors;
+    juce::CriticalSection processorLock;
+
+    std::vector<std::unique_ptr<ChunkJob>> jobs(static_cast<size_t>(numChunks));
+    std::atomic<bool> cancelled { false };
+
+    // Declared last so it's gone - and every job finished - before anything the jobs use
+    juce::ThreadPool pool(juce::ThreadPoolOptions{}
+                              .withThreadName("ChunkedRenderer")
+                              .withNumberOfThreads(numThreads));
+
+    auto runJob = [&](int index)
+    {
+        auto& job = *jobs[static_cast<size_t>(index)];
+        std::unique_ptr<Processor> processor;
+
+        {
+            const juce::ScopedLock sl(processorLock);
+
+            if (!idleProcessors.empty())
+            {
+                processor = std::move(idleProcessors.back());
+                idleProcessors.pop_back();
+            }
+        }
+
+        if (processor == nullptr)
+            processor = createProcessor();
+
+        if (processor != nullptr)
+        {
+            job.audio.setSize(numChannels, static_cast<int>(chunks[index].numSamples));
+            job.succeeded = renderChunk(*processor, chunks[index], warmupSamples, job.audio, cancelled, shouldExit);
+
+            const juce::ScopedLock sl(processorLock);
+            idleProcessors.push_back(std::move(processor));
+        }
+
+        job.done.signal();
+    };
+
+    auto maxChunksAhead = numThreads * chunksAheadPerThread;
+    auto numSubmitted = 0;
+    auto succeeded = true;
+
+    for (int index = 0; index < numChunks && succeeded; ++index)
+    {
+        for (; numSubmitted < juce::jmin(numChunks, index + maxChunksAhead); ++numSubmitted)
+        {
+            jobs[static_cast<size_t>(numSubmitted)] = std::make_unique<ChunkJob>();
+            pool.addJob([&runJob, numSubmitted]() { runJob(numSubmitted); });
+        }
+
+        auto& job = jobs[static_cast<size_t>(index)];
+        job->done.wait();
+
+        succeeded = job->succeeded && sink(index, job->audio);
+        job.reset();
+
+        if (succeeded && onProgress != nullptr)
+            onProgress(static_cast<double>(index + 1) / numChunks);
+    }
+
+    if (!succeeded)
+    {
+        // Drop what hasn't started and wait for what has, since the jobs point at this frame
+        cancelled = true;
+        pool.removeAllJobs(true, -1);
+    }
+
+    return succeeded;
+}
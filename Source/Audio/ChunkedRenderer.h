@@ -0,0 +1,54 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Renders a song in chunks on all cores and hands them back in order. Each chunk is run
+ * through a processor of its own, starting some warm-up before the chunk so filters and
+ * limiters have settled by the first sample that's kept, and running on past the end by the
+ * processor's latency. Chunks always line up sample for sample, but they only match one pass
+ * over the whole song as closely as the warm-up allows: anything with unbounded memory, like a
+ * limiter's release, starts each chunk from rest and is only caught up by decay. The caller
+ * picks the warm-up from its slowest time constant for however close it needs that to be.
+ */
+class ChunkedRenderer
+{
+public:
+    // One copy of the processing chain. Workers create their own and reuse them between chunks.
+    class Processor
+    {
+    public:
+        virtual ~Processor() = default;
+
+        // Forget everything from the last chunk
+        virtual void reset() = 0;
+
+        // Produces the song from startSample, getLatencySamples() late
+        virtual void process(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples) = 0;
+
+        virtual int getLatencySamples() const { return 0; }
+    };
+
+    struct Chunk
+    {
+        juce::int64 startSample = 0;
+        juce::int64 numSamples = 0;
+    };
+
+    // Splits a range into chunks of chunkSamples, the last one shorter
+    static juce::Array<Chunk> split(juce::int64 startSample, juce::int64 numSamples, juce::int64 chunkSamples);
+
+    // Called on the rendering thread, in chunk order. Returning false stops the render.
+    using Sink = std::function<bool(int chunkIndex, const juce::AudioBuffer<float>& audio)>;
+
+    // False if cancelled, a processor couldn't be created or the sink failed
+    static bool render(const juce::Array<Chunk>& chunks, int numChannels, juce::int64 warmupSamples,
+                       const std::function<std::unique_ptr<Processor>()>& createProcessor,
+                       const Sink& sink, const std::function<bool()>& shouldExit,
+                       const std::function<void(double progress)>& onProgress = nullptr);
+
+    static constexpr int blockSize = 8192;
+
+private:
+    ChunkedRenderer() = delete;
+};
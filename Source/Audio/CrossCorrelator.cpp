@@ -0,0 +1,116 @@
+#include "CrossCorrelator.h"
+
+CrossCorrelator::Result CrossCorrelator::findBestLag(const float* signal, int signalLength,
+                                                     const float* reference, int referenceLength,
+                                                     int minLag, int maxLag)
+{
+    Result result;
+
+    if (signal == nullptr || reference == nullptr || signalLength <= 0 || referenceLength <= 0)
+        return result;
+
+    // Lags outside of this range don't overlap at all
+    minLag = juce::jmax(minLag, -(referenceLength - 1));
+    maxLag = juce::jmin(maxLag, signalLength - 1);
+
+    if (minLag > maxLag)
+        return result;
+
+    std::vector<float> correlation;
+    computeCorrelation(signal, signalLength, reference, referenceLength, minLag, maxLag, correlation);
+
+    auto bestValue = 0.0f;
+
+    for (int i = 0; i < static_cast<int>(correlation.size()); ++i)
+    {
+        auto value = std::abs(correlation[static_cast<size_t>(i)]);
+
+        if (!result.found || value > bestValue)
+        {
+            bestValue = value;
+            result.lag = minLag + i;
+            result.found = true;
+        }
+    }
+
+    if (result.found)
+        result.confidence = getNormalisedCorrelation(signal, signalLength, reference, referenceLength, result.lag);
+
+    return result;
+}
+
+void CrossCorrelator::computeCorrelation(const float* signal, int signalLength,
+                                         const float* reference, int referenceLength,
+                                         int minLag, int maxLag, std::vector<float>& correlation)
+{
+    correlation.assign(static_cast<size_t>(juce::jmax(0, maxLag - minLag + 1)), 0.0f);
+
+    if (correlation.empty() || signalLength <= 0 || referenceLength <= 0)
+        return;
+
+    // Zero padding to at least the sum of both lengths keeps the circular correlation linear
+    auto fftOrder = juce::jmax(1, static_cast<int>(std::ceil(std::log2(static_cast<double>(signalLength + referenceLength)))));
+    auto fftSize = 1 << fftOrder;
+
+    juce::dsp::FFT fft(fftOrder);
+    std::vector<float> signalSpectrum(static_cast<size_t>(fftSize) * 2, 0.0f);
+    std::vector<float> referenceSpectrum(static_cast<size_t>(fftSize) * 2, 0.0f);
+
+    juce::FloatVectorOperations::copy(signalSpectrum.data(), signal, signalLength);
+    juce::FloatVectorOperations::copy(referenceSpectrum.data(), reference, referenceLength);
+
+    fft.performRealOnlyForwardTransform(signalSpectrum.data());
+    fft.performRealOnlyForwardTransform(referenceSpectrum.data());
+
+    // S * conj(R) on interleaved complex data, written out so the compiler can vectorise it
+    auto* s = signalSpectrum.data();
+    const auto* r = referenceSpectrum.data();
+
+    for (int bin = 0; bin < fftSize; ++bin)
+    {
+        auto sr = s[2 * bin], si = s[2 * bin + 1];
+        auto rr = r[2 * bin], ri = r[2 * bin + 1];
+        s[2 * bin] = sr * rr + si * ri;
+        s[2 * bin + 1] = si * rr - sr * ri;
+    }
+
+    fft.performRealOnlyInverseTransform(signalSpectrum.data());
+
+    // Negative lags wrap around to the end of the buffer
+    for (int lag = minLag; lag <= maxLag; ++lag)
+    {
+        if (lag <= -referenceLength || lag >= signalLength)
+            continue;
+
+        auto index = lag >= 0 ? lag : fftSize + lag;
+        correlation[static_cast<size_t>(lag - minLag)] = signalSpectrum[static_cast<size_t>(index)];
+    }
+}
+
+float CrossCorrelator::getNormalisedCorrelation(const float* signal, int signalLength,
+                                                const float* reference, int referenceLength, int lag)
+{
+    // Overlapping region of signal[n + lag] and reference[n]
+    auto start = juce::jmax(0, -lag);
+    auto end = juce::jmin(referenceLength, signalLength - lag);
+
+    if (end <= start)
+        return 0.0f;
+
+    double dot = 0.0, signalEnergy = 0.0, referenceEnergy = 0.0;
+
+    for (int n = start; n < end; ++n)
+    {
+        auto x = static_cast<double>(signal[n + lag]);
+        auto y = static_cast<double>(reference[n]);
+        dot += x * y;
+        signalEnergy += x * x;
+        referenceEnergy += y * y;
+    }
+
+    if (signalEnergy <= 0.0 || referenceEnergy <= 0.0)
+        return 0.0f;
+
+    // Polarity doesn't matter - an inverted microphone is still aligned
+    return static_cast<float>(std::abs(dot) / std::sqrt(signalEnergy * referenceEnergy));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * FFT based cross-correlation used to find how far one signal is shifted against another.
+ */
+class CrossCorrelator
+{
+public:
+    struct Result
+    {
+        int lag = 0;                // signal[n + lag] best matches reference[n]
+        float confidence = 0.0f;    // Normalised correlation at the lag, 0..1
+        bool found = false;
+    };
+
+    // Searches lags in [minLag, maxLag] for the best match of reference inside signal
+    static Result findBestLag(const float* signal, int signalLength,
+                              const float* reference, int referenceLength,
+                              int minLag, int maxLag);
+
+    // Raw correlation sum(signal[n + lag] * reference[n]) for every lag in [minLag, maxLag]
+    static void computeCorrelation(const float* signal, int signalLength,
+                                   const float* reference, int referenceLength,
+                                   int minLag, int maxLag, std::vector<float>& correlation);
+
+    // Normalised correlation of reference against signal at one lag
+    static float getNormalisedCorrelation(const float* signal, int signalLength,
+                                          const float* reference, int referenceLength, int lag);
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CrossCorrelator)
+};
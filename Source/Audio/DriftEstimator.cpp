@@ -0,0 +1,102 @@
+#include "DriftEstimator.h"
+
+namespace
+{
+    // Both devices need this much history before their rates are trusted
+    constexpr double minimumObservationSeconds = 5.0;
+
+    // Real crystals are within a few hundred ppm - anything beyond that is a measurement glitch
+    constexpr double maximumDrift = 1.0e-3;
+}
+
+void DriftEstimator::Regression::add(double x, double y)
+{
+    if (count == 0.0)
+    {
+        firstX = x;
+        firstY = y;
+    }
+
+    // Counters can be huge after a long session - only the change matters for the slope
+    y -= firstY;
+    lastX = x;
+    count += 1.0;
+    sumX += x;
+    sumY += y;
+    sumXX += x * x;
+    sumXY += x * y;
+}
+
+double DriftEstimator::Regression::getSlope() const
+{
+    auto denominator = count * sumXX - sumX * sumX;
+
+    if (count < 2.0 || denominator <= 0.0)
+        return 0.0;
+
+    return (count * sumXY - sumX * sumY) / denominator;
+}
+
+DriftEstimator::DriftEstimator()
+{
+}
+
+DriftEstimator::~DriftEstimator()
+{
+}
+
+void DriftEstimator::reset(double newPlaybackNominalRate, double newRecordingNominalRate)
+{
+    playback = {};
+    recording = {};
+    hasOrigin = false;
+    originNs = 0;
+
+    playbackNominalRate = newPlaybackNominalRate;
+    recordingNominalRate = newRecordingNominalRate;
+    ratio = 1.0;
+}
+
+void DriftEstimator::addPlaybackObservation(juce::int64 hostTimeNs, juce::int64 deviceSamples)
+{
+    // The same playback anchor is seen by several recording blocks - only count it once
+    if (deviceSamples == playback.lastSamples)
+        return;
+
+    playback.lastSamples = deviceSamples;
+    playback.add(toSeconds(hostTimeNs), static_cast<double>(deviceSamples));
+    updateRatio();
+}
+
+void DriftEstimator::addRecordingObservation(juce::int64 hostTimeNs, juce::int64 deviceSamples)
+{
+    recording.lastSamples = deviceSamples;
+    recording.add(toSeconds(hostTimeNs), static_cast<double>(deviceSamples));
+    updateRatio();
+}
+
+double DriftEstimator::toSeconds(juce::int64 hostTimeNs)
+{
+    // Relative to the first observation so the regression sums stay well conditioned
+    if (!hasOrigin)
+    {
+        originNs = hostTimeNs;
+        hasOrigin = true;
+    }
+
+    return static_cast<double>(hostTimeNs - originNs) * 1.0e-9;
+}
+
+void DriftEstimator::updateRatio()
+{
+    if (playback.getSpan() < minimumObservationSeconds || recording.getSpan() < minimumObservationSeconds)
+        return;
+
+    auto playbackRate = playback.getSlope() / playbackNominalRate;
+    auto recordingRate = recording.getSlope() / recordingNominalRate;
+
+    if (playbackRate <= 0.0 || recordingRate <= 0.0)
+        return;
+
+    ratio = juce::jlimit(1.0 - maximumDrift, 1.0 + maximumDrift, recordingRate / playbackRate);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Continuously estimates the clock drift between the playback and recording devices.
+ * Each device's sample counter is regressed against host time to find its true rate; the
+ * ratio of the two (relative to their nominal rates) is how many recorded samples arrive
+ * per sample of song time. All observations come from the recording callback, the ratio
+ * can be read from any thread.
+ */
+class DriftEstimator
+{
+public:
+    DriftEstimator();
+    ~DriftEstimator();
+
+    // Call before the producer starts
+    void reset(double playbackNominalRate, double recordingNominalRate);
+
+    void addPlaybackObservation(juce::int64 hostTimeNs, juce::int64 deviceSamples);
+    void addRecordingObservation(juce::int64 hostTimeNs, juce::int64 deviceSamples);
+
+    // Recorded samples per song sample, 1.0 when the devices run in lockstep
+    double getRatio() const { return ratio.load(); }
+    double getDriftPpm() const { return (ratio.load() - 1.0) * 1.0e6; }
+
+private:
+    // Online least squares fit of samples against seconds
+    struct Regression
+    {
+        double count = 0.0, sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+        double firstX = 0.0, firstY = 0.0, lastX = 0.0;
+        juce::int64 lastSamples = -1;
+
+        void add(double x, double y);
+        double getSlope() const;
+        double getSpan() const { return lastX - firstX; }
+    };
+
+    Regression playback, recording;
+    juce::int64 originNs = 0;
+    bool hasOrigin = false;
+
+    double playbackNominalRate = 44100.0;
+    double recordingNominalRate = 44100.0;
+
+    std::atomic<double> ratio { 1.0 };
+
+    double toSeconds(juce::int64 hostTimeNs);
+    void updateRatio();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DriftEstimator)
+};
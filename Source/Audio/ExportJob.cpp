@@ -0,0 +1,196 @@
+#include "ExportJob.h"
+#include "IntermediateAudio.h"
+#include "ProcessRunner.h"
+#include "ProcessProgress.h"
+
+namespace
+{
+    constexpr int exportBlockSize = 65536;
+}
+
+ExportJob::ExportJob(const juce::File& source, const juce::File& destination, Codec exportCodec)
+    : Thread("ExportJob"),
+      sourceFile(source),
+      destinationFile(destination),
+      codec(exportCodec)
+{
+}
+
+ExportJob::~ExportJob()
+{
+}
+
+juce::String ExportJob::getCodecName(Codec codec)
+{
+    switch (codec)
+    {
+        case Codec::Wav16:      return "WAV (16-bit)";
+        case Codec::Wav24:      return "WAV (24-bit)";
+        case Codec::Flac:       return "FLAC";
+        case Codec::OggVorbis:  return "Ogg Vorbis";
+        case Codec::Mp3:        return "MP3 (320 kbps)";
+    }
+
+    return {};
+}
+
+juce::String ExportJob::getFileExtension(Codec codec)
+{
+    switch (codec)
+    {
+        case Codec::Wav16:
+        case Codec::Wav24:      return ".wav";
+        case Codec::Flac:       return ".flac";
+        case Codec::OggVorbis:  return ".ogg";
+        case Codec::Mp3:        return ".mp3";
+    }
+
+    return {};
+}
+
+void ExportJob::run()
+{
+    updateProgress(0.0, "Exporting " + getCodecName(codec) + "...");
+
+    if (!sourceFile.existsAsFile())
+    {
+        if (onExportComplete)
+            onExportComplete(false, "Mix file not found: " + sourceFile.getFullPathName());
+        return;
+    }
+
+    // Encoded next to the destination and moved into place, so a failed export leaves nothing behind
+    juce::TemporaryFile tempFile(destinationFile);
+    auto encoded = codec == Codec::Mp3 ? encodeWithFFmpeg(tempFile.getFile()) : encodeNatively(tempFile.getFile());
+
+    if (threadShouldExit())
+        return;
+
+    if (!encoded || !tempFile.overwriteTargetFileWithTemporary())
+    {
+        if (onExportComplete)
+            onExportComplete(false, "Failed to export " + getCodecName(codec) + " to " + destinationFile.getFullPathName());
+        return;
+    }
+
+    updateProgress(1.0, "Export complete");
+
+    if (onExportComplete)
+        onExportComplete(true, "Exported to " + destinationFile.getFullPathName());
+}
+
+bool ExportJob::encodeNatively(const juce::File& target)
+{
+    auto reader = IntermediateAudio::createReader(sourceFile);
+
+    if (reader == nullptr)
+        return false;
+
+    std::unique_ptr<juce::AudioFormat> format;
+    int bitsPerSample = 24;
+    int qualityIndex = 0;
+
+    switch (codec)
+    {
+        case Codec::Wav16:
+            format = std::make_unique<juce::WavAudioFormat>();
+            bitsPerSample = 16;
+            break;
+        case Codec::Wav24:
+            format = std::make_unique<juce::WavAudioFormat>();
+            break;
+        case Codec::Flac:
+            format = std::make_unique<juce::FlacAudioFormat>();
+            break;
+        case Codec::OggVorbis:
+            format = std::make_unique<juce::OggVorbisAudioFormat>();
+            bitsPerSample = 16;
+            qualityIndex = format->getQualityOptions().size() - 1;
+            break;
+        case Codec::Mp3:
+            return false;
+    }
+
+    std::unique_ptr<juce::FileOutputStream> stream(target.createOutputStream());
+
+    if (stream == nullptr)
+        return false;
+
+    std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), reader->sampleRate, reader->numChannels,
+                                                                            bitsPerSample, {}, qualityIndex));
+
+    if (writer == nullptr)
+        return false;
+
+    stream.release();
+
+    auto numChannels = static_cast<int>(reader->numChannels);
+    juce::AudioBuffer<float> buffer(numChannels, exportBlockSize);
+
+    for (juce::int64 position = 0; position < reader->lengthInSamples; position += exportBlockSize)
+    {
+        if (threadShouldExit())
+            return false;
+
+        auto numSamples = static_cast<int>(juce::jmin<juce::int64>(exportBlockSize, reader->lengthInSamples - position));
+        reader->read(&buffer, 0, numSamples, position, true, numChannels > 1);
+
+        if (!writer->writeFromAudioSampleBuffer(buffer, 0, numSamples))
+            return false;
+
+        updateProgress(static_cast<double>(position + numSamples) / reader->lengthInSamples,
+                       "Exporting " + getCodecName(codec) + "...");
+    }
+
+    return true;
+}
+
+bool ExportJob::encodeWithFFmpeg(const juce::File& target)
+{
+    auto message = "Encoding " + getCodecName(codec) + " with FFmpeg...";
+    updateProgress(0.0, message);
+
+    // ffmpeg reports how far into the song it is, so the duration turns that into a fraction
+    double durationSeconds = 0.0;
+
+    if (auto reader = IntermediateAudio::createReader(sourceFile))
+        durationSeconds = reader->lengthInSamples / reader->sampleRate;
+
+    juce::StringArray ffmpegArgs;
+    ffmpegArgs.add("ffmpeg");
+    ffmpegArgs.add("-y");
+    ffmpegArgs.add("-nostats");
+    ffmpegArgs.add("-progress"); ffmpegArgs.add("pipe:1");
+    ffmpegArgs.add("-i"); ffmpegArgs.add(sourceFile.getFullPathName());
+    ffmpegArgs.add("-codec:a"); ffmpegArgs.add("libmp3lame");
+    ffmpegArgs.add("-b:a"); ffmpegArgs.add("320k");
+    ffmpegArgs.add(target.getFullPathName());
+
+    ProcessRunner ffmpegProcess;
+    if (!ffmpegProcess.start(ffmpegArgs, false))
+        return false;
+
+    ProcessProgress::FFmpeg progress(durationSeconds);
+
+    auto onLine = [&](const juce::String& line)
+    {
+        if (progress.parseLine(line))
+            updateProgress(progress.getFraction(), message + " (" + ProcessProgress::formatDuration(progress.getSecondsLeft()) + " left)");
+    };
+
+    if (ffmpegProcess.waitForExit(-1, onLine) != ProcessRunner::Result::Finished)
+        return false;
+
+    return ffmpegProcess.getExitCode() == 0 && target.getSize() > 0;
+}
+
+void ExportJob::updateProgress(double progress, const juce::String& message)
+{
+    if (onProgressUpdate)
+    {
+        // The callback goes by copy, as the job may be gone by the time it runs
+        juce::MessageManager::callAsync([callback = onProgressUpdate, progress, message]() {
+            callback(progress, message);
+        });
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Encodes a finished float mix into a delivery format on a background thread. This is the
+ * only lossy step in the pipeline, and it only happens when the user asks for a file. WAV,
+ * FLAC and Ogg Vorbis are encoded in-process; MP3 goes through ffmpeg.
+ */
+class ExportJob : public juce::Thread
+{
+public:
+    enum class Codec
+    {
+        Wav16,
+        Wav24,
+        Flac,
+        OggVorbis,
+        Mp3
+    };
+
+    ExportJob(const juce::File& sourceFile, const juce::File& destinationFile, Codec codec);
+    ~ExportJob() override;
+
+    void run() override;
+
+    static juce::String getCodecName(Codec codec);
+    static juce::String getFileExtension(Codec codec);
+
+    std::function<void(bool success, const juce::String& message)> onExportComplete;
+    std::function<void(double progress, const juce::String& statusMessage)> onProgressUpdate;
+
+private:
+    juce::File sourceFile;
+    juce::File destinationFile;
+    Codec codec;
+
+    bool encodeNatively(const juce::File& target);
+    bool encodeWithFFmpeg(const juce::File& target);
+
+    void updateProgress(double progress, const juce::String& message);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ExportJob)
+};
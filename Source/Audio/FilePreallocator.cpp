@@ -0,0 +1,52 @@
+#include "FilePreallocator.h"
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+bool FilePreallocator::reserve(const juce::File& file, juce::int64 numBytes)
+{
+    if (numBytes <= 0)
+        return false;
+
+   #if JUCE_LINUX || JUCE_MAC
+    auto fd = ::open(file.getFullPathName().toRawUTF8(), O_WRONLY);
+
+    if (fd < 0)
+        return false;
+
+   #if JUCE_LINUX
+    // KEEP_SIZE leaves the length alone, so the writer still appends from the current end
+    auto reserved = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(numBytes)) == 0;
+   #else
+    // Ask for one contiguous run first, then settle for whatever the volume can give us
+    fstore_t store { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(numBytes), 0 };
+    auto reserved = ::fcntl(fd, F_PREALLOCATE, &store) != -1;
+
+    if (!reserved)
+    {
+        store.fst_flags = F_ALLOCATEALL;
+        reserved = ::fcntl(fd, F_PREALLOCATE, &store) != -1;
+    }
+   #endif
+
+    ::close(fd);
+    return reserved;
+   #else
+    juce::ignoreUnused(file);
+    return false;
+   #endif
+}
+
+void FilePreallocator::releaseUnused(const juce::File& file)
+{
+    if (!file.existsAsFile())
+        return;
+
+    // Truncating at the current end gives back anything reserved past it
+    juce::FileOutputStream stream(file);
+
+    if (stream.openedOk())
+        stream.truncate();
+}
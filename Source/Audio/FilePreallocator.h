@@ -0,0 +1,19 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Reserves disk space for a file that is about to be written sequentially, so a long take
+ * is laid out in as few extents as possible and the filesystem doesn't have to find new
+ * blocks while we're recording. The reservation doesn't change the file's visible size;
+ * whatever wasn't used is handed back once the file is finished.
+ */
+class FilePreallocator
+{
+public:
+    // Best effort - returns false if the platform or filesystem doesn't support it
+    static bool reserve(const juce::File& file, juce::int64 numBytes);
+
+    // Frees any reserved space beyond the end of the file. Call once nothing has it open for writing.
+    static void releaseUnused(const juce::File& file);
+};
@@ -0,0 +1,491 @@
+#include "HttpClient.h"
+
+#if JUCE_LINUX
+ #include <sys/socket.h>
+#endif
+
+namespace
+{
+    constexpr int chunkSize = 65536;
+    constexpr int connectTimeoutMs = 10000;
+    constexpr int waitSliceMs = 100;       // How often a quiet socket checks for cancellation
+    constexpr int reportIntervalMs = 250;
+    constexpr size_t maxLineLength = 65536;
+
+    bool hasTimeLeft(juce::uint32 deadline)
+    {
+        return static_cast<juce::int32>(deadline - juce::Time::getMillisecondCounter()) > 0;
+    }
+}
+
+HttpClient::HttpClient(const juce::String& baseUrl)
+{
+    juce::URL url(baseUrl.trim());
+    host = url.getDomain();
+    port = url.getPort() > 0 ? url.getPort() : 80;
+    basePath = url.getSubPath().trimCharactersAtEnd("/");
+}
+
+HttpClient::~HttpClient()
+{
+    disconnect();
+}
+
+bool HttpClient::supportsUrl(const juce::String& url)
+{
+    return url.trim().startsWithIgnoreCase("http://");
+}
+
+int HttpClient::get(const juce::String& path, juce::OutputStream& responseBody, int timeoutMs, const ProgressCallback& onProgress,
+                    int timeoutForBodyMs)
+{
+    return perform("GET", path, {}, {}, responseBody, timeoutMs, onProgress, timeoutForBodyMs);
+}
+
+int HttpClient::postMultipart(const juce::String& path, const juce::Array<FormField>& fields, juce::OutputStream& responseBody,
+                              int timeoutMs, const ProgressCallback& onProgress, int timeoutForBodyMs)
+{
+    auto boundary = "LucidKaraoke" + juce::String::toHexString(juce::Random::getSystemRandom().nextInt64());
+    std::vector<BodyPart> body;
+
+    auto addText = [&body](const juce::String& text)
+    {
+        BodyPart part;
+        part.data.append(text.toRawUTF8(), text.getNumBytesAsUTF8());
+        body.push_back(std::move(part));
+    };
+
+    for (auto& field : fields)
+    {
+        juce::String head = "--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + field.name + "\"";
+
+        if (field.file == juce::File())
+        {
+            addText(head + "\r\n\r\n" + field.value + "\r\n");
+            continue;
+        }
+
+        if (!field.file.existsAsFile())
+        {
+            lastError = "File not found: " + field.file.getFullPathName();
+            return 0;
+        }
+
+        // Only the headers around the file are held in memory - the file itself is read as it's sent
+        addText(head + "; filename=\"" + field.file.getFileName().replace("\"", "%22") + "\"\r\n"
+                + "Content-Type: application/octet-stream\r\n\r\n");
+
+        BodyPart filePart;
+        filePart.file = field.file;
+        body.push_back(std::move(filePart));
+
+        addText("\r\n");
+    }
+
+    addText("--" + boundary + "--\r\n");
+
+    return perform("POST", path, "multipart/form-data; boundary=" + boundary, body, responseBody, timeoutMs, onProgress,
+                   timeoutForBodyMs);
+}
+
+void HttpClient::disconnect()
+{
+    if (socket != nullptr)
+        socket->close();
+
+    socket.reset();
+    pending.clear();
+}
+
+int HttpClient::perform(const juce::String& method, const juce::String& path, const juce::String& contentType,
+                        const std::vector<BodyPart>& body, juce::OutputStream& responseBody, int timeoutMs,
+                        const ProgressCallback& onProgress, int timeoutForBodyMs)
+{
+    lastError.clear();
+    deadline = juce::Time::getMillisecondCounter() + static_cast<juce::uint32>(juce::jmax(0, timeoutMs));
+    bodyTimeoutMs = timeoutForBodyMs;
+    lastReportTime = 0;
+    progressCallback = onProgress;
+    progress = {};
+
+    for (auto& part : body)
+        progress.totalToSend += part.getSize();
+
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        auto reused = socket != nullptr;
+
+        if (!reused && !connect())
+            return 0;
+
+        auto gotResponse = false;
+        auto status = exchange(method, path, contentType, body, responseBody, gotResponse);
+
+        if (status > 0)
+            return status;
+
+        disconnect();
+
+        // A kept-alive connection the server had already dropped fails before any response -
+        // that's the only case worth sending again, on a fresh one
+        if (gotResponse || !reused || cancelled || !hasTimeLeft(deadline))
+            return 0;
+    }
+
+    return 0;
+}
+
+int HttpClient::exchange(const juce::String& method, const juce::String& path, const juce::String& contentType,
+                         const std::vector<BodyPart>& body, juce::OutputStream& responseBody, bool& gotResponse)
+{
+    cancelled = false;
+    progress.bytesSent = 0;
+    progress.bytesReceived = 0;
+    progress.totalToReceive = -1;
+    progress.waitingForResponse = false;
+    pending.clear();
+
+    auto fullPath = "/" + (basePath.isNotEmpty() ? basePath + "/" : juce::String()) + path.trimCharactersAtStart("/");
+
+    juce::String head;
+    head << method << " " << fullPath << " HTTP/1.1\r\n"
+         << "Host: " << host << ":" << port << "\r\n"
+         << "User-Agent: LucidKaraoke\r\n"
+         << "Accept: */*\r\n"
+         << "Connection: keep-alive\r\n";
+
+    if (!body.empty())
+        head << "Content-Type: " << contentType << "\r\n"
+             << "Content-Length: " << progress.totalToSend << "\r\n";
+
+    head << "\r\n";
+
+    if (!send(head.toRawUTF8(), static_cast<int>(head.getNumBytesAsUTF8())))
+        return 0;
+
+    juce::HeapBlock<char> chunk(chunkSize);
+
+    for (auto& part : body)
+    {
+        if (part.file == juce::File())
+        {
+            if (!send(part.data.getData(), static_cast<int>(part.data.getSize())))
+                return 0;
+
+            progress.bytesSent += static_cast<juce::int64>(part.data.getSize());
+            continue;
+        }
+
+        juce::FileInputStream input(part.file);
+
+        if (!input.openedOk())
+        {
+            fail("Couldn't read " + part.file.getFullPathName());
+            return 0;
+        }
+
+        for (;;)
+        {
+            auto numRead = input.read(chunk, chunkSize);
+
+            if (numRead <= 0)
+                break;
+
+            if (!send(chunk, numRead) || !report(false))
+                return 0;
+
+            progress.bytesSent += numRead;
+        }
+    }
+
+    progress.waitingForResponse = true;
+
+    if (!report(true))
+        return 0;
+
+    juce::String statusLine;
+
+    if (!readLine(statusLine))
+        return 0;
+
+    gotResponse = true;
+    progress.waitingForResponse = false;
+
+    auto status = statusLine.fromFirstOccurrenceOf(" ", false, false).getIntValue();
+
+    if (!statusLine.startsWith("HTTP/") || status <= 0)
+    {
+        fail("Malformed response: " + statusLine);
+        return 0;
+    }
+
+    auto keepAlive = statusLine.startsWith("HTTP/1.1");
+    juce::int64 contentLength = -1;
+    auto chunked = false;
+
+    for (;;)
+    {
+        juce::String line;
+
+        if (!readLine(line))
+            return 0;
+
+        if (line.isEmpty())
+            break;
+
+        auto name = line.upToFirstOccurrenceOf(":", false, false).trim();
+        auto value = line.fromFirstOccurrenceOf(":", false, false).trim();
+
+        if (name.equalsIgnoreCase("Content-Length"))
+            contentLength = value.getLargeIntValue();
+        else if (name.equalsIgnoreCase("Transfer-Encoding"))
+            chunked = value.containsIgnoreCase("chunked");
+        else if (name.equalsIgnoreCase("Connection"))
+            keepAlive = value.equalsIgnoreCase("keep-alive") || (keepAlive && !value.equalsIgnoreCase("close"));
+    }
+
+    // The server has answered, so however long the body takes is down to the link rather than the server
+    if (bodyTimeoutMs >= 0)
+        deadline = juce::Time::getMillisecondCounter() + static_cast<juce::uint32>(bodyTimeoutMs);
+
+    if (method == "HEAD" || status == 204 || status == 304)
+    {
+        // No body
+    }
+    else if (chunked)
+    {
+        for (;;)
+        {
+            juce::String sizeLine;
+
+            if (!readLine(sizeLine))
+                return 0;
+
+            auto size = sizeLine.upToFirstOccurrenceOf(";", false, false).trim().getHexValue64();
+
+            if (size == 0)
+                break;
+
+            juce::String chunkEnd;
+
+            if (!readBody(responseBody, size) || !readLine(chunkEnd))
+                return 0;
+        }
+
+        // Trailers, if any, up to the blank line
+        juce::String trailer;
+
+        do
+        {
+            if (!readLine(trailer))
+                return 0;
+        }
+        while (trailer.isNotEmpty());
+    }
+    else if (contentLength >= 0)
+    {
+        progress.totalToReceive = contentLength;
+
+        if (!readBody(responseBody, contentLength))
+            return 0;
+    }
+    else
+    {
+        // Delimited by the server closing the connection
+        keepAlive = false;
+
+        if (!readBody(responseBody, -1))
+            return 0;
+    }
+
+    responseBody.flush();
+    report(true);
+
+    if (!keepAlive)
+        disconnect();
+
+    return status;
+}
+
+bool HttpClient::connect()
+{
+    socket = std::make_unique<juce::StreamingSocket>();
+    auto remainingMs = static_cast<juce::int32>(deadline - juce::Time::getMillisecondCounter());
+
+    if (remainingMs <= 0 || !socket->connect(host, port, juce::jmin(remainingMs, connectTimeoutMs)))
+    {
+        socket.reset();
+        return fail("Couldn't connect to " + host + ":" + juce::String(port));
+    }
+
+    return true;
+}
+
+bool HttpClient::send(const void* data, int numBytes)
+{
+    auto* bytes = static_cast<const char*>(data);
+
+    while (numBytes > 0)
+    {
+        if (!hasTimeLeft(deadline))
+            return fail("Timed out sending the request");
+
+        auto ready = socket->waitUntilReady(false, waitSliceMs);
+
+        if (ready < 0)
+            return fail("Connection lost while sending");
+
+        if (ready == 0)
+        {
+            if (!report(false))
+                return false;
+
+            continue;
+        }
+
+       #if JUCE_LINUX
+        // A server that has dropped the connection would otherwise raise SIGPIPE
+        auto numWritten = static_cast<int>(::send(socket->getRawSocketHandle(), bytes, static_cast<size_t>(numBytes), MSG_NOSIGNAL));
+       #else
+        auto numWritten = socket->write(bytes, numBytes);
+       #endif
+
+        if (numWritten <= 0)
+            return fail("Connection lost while sending");
+
+        bytes += numWritten;
+        numBytes -= numWritten;
+    }
+
+    return true;
+}
+
+int HttpClient::receive(char* destination, int maxBytes)
+{
+    for (;;)
+    {
+        if (!hasTimeLeft(deadline))
+        {
+            fail("Timed out waiting for the response");
+            return -1;
+        }
+
+        auto ready = socket->waitUntilReady(true, waitSliceMs);
+
+        if (ready < 0)
+        {
+            fail("Connection lost while receiving");
+            return -1;
+        }
+
+        if (ready == 0)
+        {
+            if (!report(false))
+                return -1;
+
+            continue;
+        }
+
+        auto numRead = socket->read(destination, maxBytes, false);
+
+        if (numRead < 0)
+            fail("Connection lost while receiving");
+
+        return numRead;
+    }
+}
+
+bool HttpClient::readLine(juce::String& line)
+{
+    for (;;)
+    {
+        auto end = pending.find("\r\n");
+
+        if (end != std::string::npos)
+        {
+            line = juce::String::fromUTF8(pending.data(), static_cast<int>(end));
+            pending.erase(0, end + 2);
+            return true;
+        }
+
+        if (pending.size() > maxLineLength)
+            return fail("Response header line too long");
+
+        char buffer[4096];
+        auto numRead = receive(buffer, static_cast<int>(sizeof(buffer)));
+
+        if (numRead < 0)
+            return false;
+
+        if (numRead == 0)
+            return fail("Connection closed before the response was complete");
+
+        pending.append(buffer, static_cast<size_t>(numRead));
+    }
+}
+
+bool HttpClient::readBody(juce::OutputStream& responseBody, juce::int64 numBytes)
+{
+    juce::HeapBlock<char> chunk(chunkSize);
+
+    // numBytes is -1 to read until the server closes
+    while (numBytes != 0)
+    {
+        auto wanted = numBytes < 0 ? chunkSize : static_cast<int>(juce::jmin<juce::int64>(chunkSize, numBytes));
+        int numRead = 0;
+
+        if (!pending.empty())
+        {
+            numRead = juce::jmin(wanted, static_cast<int>(pending.size()));
+            std::memcpy(chunk, pending.data(), static_cast<size_t>(numRead));
+            pending.erase(0, static_cast<size_t>(numRead));
+        }
+        else
+        {
+            numRead = receive(chunk, wanted);
+
+            if (numRead < 0)
+                return false;
+
+            if (numRead == 0)
+                return numBytes < 0 || fail("Connection closed before the response was complete");
+        }
+
+        if (!responseBody.write(chunk, static_cast<size_t>(numRead)))
+            return fail("Couldn't store the response");
+
+        progress.bytesReceived += numRead;
+
+        if (numBytes > 0)
+            numBytes -= numRead;
+
+        if (!report(false))
+            return false;
+    }
+
+    return true;
+}
+
+bool HttpClient::report(bool force)
+{
+    auto now = juce::Time::getMillisecondCounter();
+
+    if (!force && now - lastReportTime < static_cast<juce::uint32>(reportIntervalMs))
+        return true;
+
+    lastReportTime = now;
+
+    if (progressCallback != nullptr && !progressCallback(progress))
+    {
+        cancelled = true;
+        return fail("Cancelled");
+    }
+
+    return true;
+}
+
+bool HttpClient::fail(const juce::String& error)
+{
+    lastError = error;
+    return false;
+}
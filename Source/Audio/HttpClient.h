@@ -0,0 +1,93 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * A small HTTP/1.1 client for the separation service, over a plain socket. Connections are
+ * kept alive, so a health check and the upload after it share one. Multipart bodies are
+ * streamed from disk a chunk at a time rather than assembled in memory, and responses are
+ * streamed into an output stream as they arrive, with progress reported in bytes both ways.
+ * Only plain http - anything else has to go through curl.
+ */
+class HttpClient
+{
+public:
+    struct Progress
+    {
+        juce::int64 bytesSent = 0;
+        juce::int64 totalToSend = 0;
+        juce::int64 bytesReceived = 0;
+        juce::int64 totalToReceive = -1;  // -1 until the response says how long it is
+        bool waitingForResponse = false;  // Everything sent, nothing back yet
+    };
+
+    // Called as bytes move, and a few times a second while the server is quiet. Return false to cancel.
+    using ProgressCallback = std::function<bool(const Progress& progress)>;
+
+    // A form field, or a file part when file is set
+    struct FormField
+    {
+        juce::String name;
+        juce::String value;
+        juce::File file;
+    };
+
+    explicit HttpClient(const juce::String& baseUrl);
+    ~HttpClient();
+
+    static bool supportsUrl(const juce::String& url);
+
+    // These return the HTTP status, or 0 if there wasn't one - see getLastError(). With a
+    // bodyTimeoutMs, timeoutMs only lasts until the response headers are in, and the body then
+    // gets bodyTimeoutMs from there - for a server that answers quickly but may send a lot.
+    int get(const juce::String& path, juce::OutputStream& responseBody, int timeoutMs,
+            const ProgressCallback& onProgress = nullptr, int bodyTimeoutMs = -1);
+
+    int postMultipart(const juce::String& path, const juce::Array<FormField>& fields, juce::OutputStream& responseBody,
+                      int timeoutMs, const ProgressCallback& onProgress = nullptr, int bodyTimeoutMs = -1);
+
+    juce::String getLastError() const { return lastError; }
+
+    void disconnect();
+
+private:
+    // A request body is sent as a run of these, each either bytes or a whole file
+    struct BodyPart
+    {
+        juce::MemoryBlock data;
+        juce::File file;
+
+        juce::int64 getSize() const { return file != juce::File() ? file.getSize() : static_cast<juce::int64>(data.getSize()); }
+    };
+
+    juce::String host;
+    int port = 80;
+    juce::String basePath;
+
+    std::unique_ptr<juce::StreamingSocket> socket;
+    std::string pending;  // Received but not yet consumed
+    juce::String lastError;
+    bool cancelled = false;
+
+    juce::uint32 deadline = 0;
+    int bodyTimeoutMs = -1;
+    juce::uint32 lastReportTime = 0;
+    Progress progress;
+    ProgressCallback progressCallback;
+
+    int perform(const juce::String& method, const juce::String& path, const juce::String& contentType,
+                const std::vector<BodyPart>& body, juce::OutputStream& responseBody, int timeoutMs,
+                const ProgressCallback& onProgress, int timeoutForBodyMs);
+    int exchange(const juce::String& method, const juce::String& path, const juce::String& contentType,
+                 const std::vector<BodyPart>& body, juce::OutputStream& responseBody, bool& gotResponse);
+
+    bool connect();
+    bool send(const void* data, int numBytes);
+    int receive(char* destination, int maxBytes);  // 0 once the server has closed, -1 on failure
+    bool readLine(juce::String& line);
+    bool readBody(juce::OutputStream& responseBody, juce::int64 numBytes);
+    bool report(bool force);
+    bool fail(const juce::String& error);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HttpClient)
+};
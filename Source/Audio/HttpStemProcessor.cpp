@@ -1,5 +1,167 @@
 #include "HttpStemProcessor.h"
 #include "RVCProcessor.h"
+#include "ChunkedRenderer.h"
+#include "PolyphaseResampler.h"
+#include "IntermediateAudio.h"
+#include "ProcessRunner.h"
+#include "ProcessProgress.h"
+#include "Sha256.h"
+#include "StemArchive.h"
+
+namespace
+{
+    // Short enough that a song splits across every core
+    constexpr double mixChunkSeconds = 10.0;
+    
+    // Separated segments: long enough that the model has context, with room either side of a
+    // join for a crossfade. A few at a time keeps the service busy without starving the upload.
+    constexpr double segmentSeconds = 30.0;
+    constexpr double segmentOverlapSeconds = 2.0;
+    constexpr int maxParallelSegments = 3;
+    constexpr int segmentProgressIntervalMs = 250;
+    
+    // 24-bit, so nothing audible is lost handing audio to the service or keeping its stems
+    std::unique_ptr<juce::AudioFormatWriter> createFlacWriter(const juce::File& file, double sampleRate, int numChannels)
+    {
+        file.deleteFile();
+        std::unique_ptr<juce::FileOutputStream> stream(file.createOutputStream());
+        
+        if (stream == nullptr)
+            return nullptr;
+        
+        juce::FlacAudioFormat flacFormat;
+        std::unique_ptr<juce::AudioFormatWriter> writer(flacFormat.createWriterFor(stream.get(), sampleRate,
+                                                                                   static_cast<unsigned int>(numChannels), 24, {}, 0));
+        
+        // The writer owns the stream from here
+        if (writer != nullptr)
+            stream.release();
+        
+        return writer;
+    }
+
+    // Passes a stop request for one thread on to a worker it's waiting for
+    class StopForwarder : private juce::Thread::Listener
+    {
+    public:
+        StopForwarder(juce::Thread& waitingThread, juce::Thread& workerThread)
+            : waiting(waitingThread), worker(workerThread)
+        {
+            waiting.addListener(this);
+        }
+        
+        ~StopForwarder() override
+        {
+            waiting.removeListener(this);
+        }
+        
+    private:
+        juce::Thread& waiting;
+        juce::Thread& worker;
+        
+        void exitSignalSent() override
+        {
+            worker.signalThreadShouldExit();
+        }
+    };
+    
+    // Sums stems the way amix does - each input at 1/n - resampling any that don't match the first
+    class StemSum : public ChunkedRenderer::Processor
+    {
+    public:
+        StemSum(const juce::File& directory, const juce::StringArray& stemNames)
+        {
+            for (auto& name : stemNames)
+            {
+                auto reader = HttpStemProcessor::createStemReader(directory, name);
+                
+                if (reader == nullptr)
+                {
+                    stems.clear();
+                    return;
+                }
+                
+                if (stems.empty())
+                    sampleRate = reader->sampleRate;
+                
+                auto stem = std::make_unique<Stem>();
+                stem->step = reader->sampleRate / sampleRate;
+                stem->resampler.prepare(PolyphaseResampler::Quality::High, stem->step);
+                stem->source.setSize(2, static_cast<int>(std::ceil(ChunkedRenderer::blockSize * stem->step))
+                                            + 2 * stem->resampler.getHalfLength() + 2);
+                stem->reader = std::move(reader);
+                stems.push_back(std::move(stem));
+            }
+            
+            scratch.setSize(2, ChunkedRenderer::blockSize);
+        }
+        
+        bool isValid() const { return !stems.empty(); }
+        double getSampleRate() const { return sampleRate; }
+        
+        // As long as the longest stem, like amix with duration=longest
+        juce::int64 getLengthInSamples() const
+        {
+            juce::int64 length = 0;
+            
+            for (auto& stem : stems)
+                length = juce::jmax(length, static_cast<juce::int64>(std::ceil(stem->reader->lengthInSamples / stem->step)));
+            
+            return length;
+        }
+        
+        void reset() override {}
+        
+        void process(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples) override
+        {
+            auto gain = 1.0f / static_cast<float>(stems.size());
+            buffer.clear(0, numSamples);
+            
+            for (auto& stem : stems)
+            {
+                readStem(*stem, startSample, numSamples);
+                
+                for (int channel = 0; channel < 2; ++channel)
+                    buffer.addFrom(channel, 0, scratch, channel, 0, numSamples, gain);
+            }
+        }
+        
+    private:
+        struct Stem
+        {
+            std::unique_ptr<juce::AudioFormatReader> reader;
+            double step = 1.0;  // Stem samples per output sample
+            PolyphaseResampler resampler;
+            juce::AudioBuffer<float> source;
+        };
+        
+        std::vector<std::unique_ptr<Stem>> stems;
+        double sampleRate = 44100.0;
+        juce::AudioBuffer<float> scratch;
+        
+        // Mono stems come back on both sides
+        void readStem(Stem& stem, juce::int64 startSample, int numSamples)
+        {
+            if (stem.step == 1.0)
+            {
+                stem.reader->read(&scratch, 0, numSamples, startSample, true, true);
+                return;
+            }
+            
+            auto halfLength = stem.resampler.getHalfLength();
+            auto firstPosition = static_cast<double>(startSample) * stem.step;
+            auto sourceStart = static_cast<juce::int64>(std::floor(firstPosition)) - halfLength + 1;
+            auto lastPosition = firstPosition + (numSamples - 1) * stem.step;
+            auto sourceLength = static_cast<int>(static_cast<juce::int64>(std::floor(lastPosition)) + halfLength + 1 - sourceStart);
+            
+            stem.reader->read(&stem.source, 0, sourceLength, sourceStart, true, true);
+            
+            for (int channel = 0; channel < 2; ++channel)
+                stem.resampler.process(stem.source.getReadPointer(channel), firstPosition - static_cast<double>(sourceStart),
+                                       scratch.getWritePointer(channel), numSamples);
+        }
+    };
+}
 
 HttpStemProcessor::HttpStemProcessor(const juce::File& initialInputFile, const juce::File& initialOutputDirectory, const juce::String& url,
                                    int retries, int delayMs, int maxDelay)
@@ -9,7 +171,9 @@ HttpStemProcessor::HttpStemProcessor(const juce::File& initialInputFile, const j
       serviceUrl(url),
       maxRetries(retries),
       baseDelayMs(delayMs),
-      maxDelayMs(maxDelay)
+      maxDelayMs(maxDelay),
+      client(url),
+      segments(std::make_shared<StemSegments>(initialOutputDirectory.getChildFile("segments")))
 {
     updateProgress(0.0, "Initializing stem processor...");
 }
@@ -76,33 +240,57 @@ void HttpStemProcessor::run()
 }
 
 bool HttpStemProcessor::isServiceAvailable()
+{
+    // The in-process client only speaks plain http, so https services still go through curl
+    if (!HttpClient::supportsUrl(serviceUrl))
+        return isServiceAvailableWithCurl();
+    
+    juce::MemoryOutputStream response;
+    auto status = client.get("/health", response, 6000, [this](const HttpClient::Progress&) { return !threadShouldExit(); });
+    
+    if (status != 200)
+        return false;
+    
+    auto text = response.toString();
+    return text.contains("healthy") || text.contains("status");
+}
+
+bool HttpStemProcessor::isServiceAvailableWithCurl()
 {
     // Use curl with timeout for health check to avoid hanging
-    juce::ChildProcess healthCheck;
-    juce::String healthCommand = "curl -s --max-time 5 " + serviceUrl + "/health";
+    juce::StringArray healthArgs;
+    healthArgs.add("curl");
+    healthArgs.add("-s");
+    healthArgs.add("--max-time");
+    healthArgs.add("5");
+    healthArgs.add(serviceUrl + "/health");
     
-    if (!healthCheck.start(healthCommand))
+    ProcessRunner healthCheck;
+    
+    if (!healthCheck.start(healthArgs))
         return false;
     
-    bool finished = healthCheck.waitForProcessToFinish(6000); // 6 second timeout
-    if (!finished)
-    {
-        healthCheck.kill();
+    if (healthCheck.waitForExit(6000) != ProcessRunner::Result::Finished) // 6 second timeout
         return false;
-    }
     
     if (healthCheck.getExitCode() != 0)
         return false;
     
-    juce::String response = healthCheck.readAllProcessOutput();
+    juce::String response = healthCheck.getOutput();
     return response.contains("healthy") || response.contains("status");
 }
 
 bool HttpStemProcessor::sendSeparationRequest()
 {
-    // For now, use a simplified approach with curl command
-    // This avoids the complex multipart form handling in JUCE
-    updateProgress(0.3, "Uploading audio file...");
+    // Hashed once, and kept across retries
+    if (inputHash.isEmpty())
+    {
+        updateProgress(0.3, "Checking for stems already on the server...");
+        inputHash = Sha256::hashFile(inputFile, [this]() { return threadShouldExit(); });
+    }
+    
+    if (threadShouldExit())
+        return false;
     
     // Create temporary file path for output
     juce::File tempZip = outputDirectory.getChildFile("stems_temp.zip");
@@ -119,18 +307,171 @@ bool HttpStemProcessor::sendSeparationRequest()
         }
     }
     
+    if (segmentedSeparation && HttpClient::supportsUrl(serviceUrl))
+    {
+        // The whole song only comes back in one piece if the service already has it
+        if (inputHash.isEmpty() || postSeparation(client, inputFile, inputHash, tempZip, false, createTransferReporter(false)) != 200)
+        {
+            tempZip.deleteFile();
+            return !threadShouldExit() && separateInSegments() && stitchSegments();
+        }
+    }
+    else
+    {
+        auto received = HttpClient::supportsUrl(serviceUrl) ? downloadStems(tempZip) : downloadStemsWithCurl(tempZip);
+        
+        if (!received)
+            return false;
+    }
+    
+    // Check if we got a response file
+    if (!tempZip.exists() || tempZip.getSize() == 0)
+    {
+        updateProgress(0.88, "No response received");
+        return false;
+    }
+    
+    updateProgress(0.88, "Opening stems...");
+    
+    return keepStemArchive(tempZip);
+}
+
+bool HttpStemProcessor::downloadStems(const juce::File& tempZip)
+{
+    // Ask by hash first - if the service has separated this exact file before, nothing is uploaded
+    if (inputHash.isNotEmpty())
+    {
+        auto status = postSeparation(client, inputFile, inputHash, tempZip, false, createTransferReporter(false));
+        
+        if (status == 200)
+            return true;
+        
+        if (threadShouldExit())
+            return false;
+        
+        // 404 means it hasn't; anything else is a service that predates hashes, or a real failure the upload will hit too
+        juce::Logger::writeToLog("Service has no stems for " + inputHash + " (" + (status > 0 ? "HTTP " + juce::String(status) : client.getLastError()) + "), uploading");
+        tempZip.deleteFile();
+    }
+    
+    auto status = postSeparation(client, inputFile, inputHash, tempZip, true, createTransferReporter(true));
+    
+    if (threadShouldExit())
+        return false;
+    
+    if (status != 200)
+    {
+        // An error response is the service's JSON detail rather than an archive
+        auto reason = status > 0 ? "HTTP " + juce::String(status) + ": " + tempZip.loadFileAsString() : client.getLastError();
+        juce::Logger::writeToLog("Separation request failed: " + reason);
+        tempZip.deleteFile();
+        updateProgress(0.87, "Request failed");
+        return false;
+    }
+    
+    return true;
+}
+
+int HttpStemProcessor::postSeparation(HttpClient& via, const juce::File& audioFile, const juce::String& audioHash,
+                                      const juce::File& tempZip, bool includeAudio, const HttpClient::ProgressCallback& onProgress)
+{
+    juce::Array<HttpClient::FormField> fields;
+    
+    if (includeAudio)
+        fields.add({ "audio_file", {}, audioFile });
+    
+    if (audioHash.isNotEmpty())
+        fields.add({ "audio_hash", audioHash, {} });
+    
+    fields.add({ "format", losslessStems ? "flac" : "mp3", {} });
+    fields.add({ "bitrate", "320", {} });
+    fields.add({ "model", separationModel, {} });
+    
+    tempZip.deleteFile();
+    juce::FileOutputStream zipStream(tempZip);
+    
+    if (!zipStream.openedOk())
+        return 0;
+    
+    // The audio is streamed from disk and the archive straight back to it. A lookup by hash
+    // is answered straight away or not at all, so it gets a much shorter wait for the answer -
+    // but a hit is the whole archive, which gets as long to arrive as it would after an upload.
+    return via.postMultipart("/separate", fields, zipStream, includeAudio ? 300000 : 30000, onProgress,
+                             includeAudio ? -1 : 300000);
+}
+
+HttpClient::ProgressCallback HttpStemProcessor::createTransferReporter(bool includeAudio)
+{
+    auto startTime = juce::Time::getMillisecondCounter();
+    
+    return [this, startTime, includeAudio](const HttpClient::Progress& progress)
+    {
+        auto uploadFraction = progress.totalToSend > 0 ? static_cast<double>(progress.bytesSent) / progress.totalToSend : 1.0;
+        auto downloadFraction = progress.totalToReceive > 0 ? static_cast<double>(progress.bytesReceived) / progress.totalToReceive : 0.0;
+        
+        if (includeAudio || progress.bytesReceived > 0)
+            reportTransfer(uploadFraction, progress.bytesSent, downloadFraction, progress.bytesReceived, {}, startTime);
+        
+        return !threadShouldExit();
+    };
+}
+
+bool HttpStemProcessor::downloadStemsWithCurl(const juce::File& tempZip)
+{
+    // Same as the native path: by hash first, and the audio only if the service doesn't have it
+    if (inputHash.isNotEmpty())
+    {
+        if (runCurlSeparation(tempZip, false))
+            return true;
+        
+        if (threadShouldExit())
+            return false;
+        
+        tempZip.deleteFile();
+    }
+    
+    return runCurlSeparation(tempZip, true);
+}
+
+bool HttpStemProcessor::runCurlSeparation(const juce::File& tempZip, bool includeAudio)
+{
     // Use curl to upload file and download result with proper quoting
     juce::StringArray curlArgs;
     curlArgs.add("curl");
     curlArgs.add("-v");
     curlArgs.add("-X");
     curlArgs.add("POST");
+    
+    if (includeAudio)
+    {
+        curlArgs.add("-F");
+        curlArgs.add("audio_file=@" + inputFile.getFullPathName());
+    }
+    else
+    {
+        // A miss is an HTTP error, which should fail the lookup rather than land in the zip
+        curlArgs.add("--fail");
+        
+        // A lookup is answered straight away or not at all, so give up on one that goes quiet for
+        // 30 seconds. A hit is the whole archive, which keeps bytes moving however slow the link.
+        curlArgs.add("--speed-limit");
+        curlArgs.add("1");
+        curlArgs.add("--speed-time");
+        curlArgs.add("30");
+    }
+    
+    if (inputHash.isNotEmpty())
+    {
+        curlArgs.add("-F");
+        curlArgs.add("audio_hash=" + inputHash);
+    }
+    
     curlArgs.add("-F");
-    curlArgs.add("audio_file=@" + inputFile.getFullPathName());
-    curlArgs.add("-F");
-    curlArgs.add("format=mp3");
+    curlArgs.add(juce::String("format=") + (losslessStems ? "flac" : "mp3"));
     curlArgs.add("-F");
     curlArgs.add("bitrate=320");
+    curlArgs.add("-F");
+    curlArgs.add(juce::String("model=") + separationModel);
     curlArgs.add("-o");
     curlArgs.add(tempZip.getFullPathName());
     curlArgs.add(serviceUrl + "/separate");
@@ -138,204 +479,401 @@ bool HttpStemProcessor::sendSeparationRequest()
     
     juce::String curlCommand = curlArgs.joinIntoString(" ");
     
-    updateProgress(0.4, "Processing audio...");
-    
-    juce::ChildProcess curlProcess;
-    if (!curlProcess.start(curlCommand))
+    ProcessRunner curlProcess;
+    if (!curlProcess.start(curlArgs))
     {
         updateProgress(0.45, "Failed to send request");
         return false;
     }
     
-    // Monitor progress
-    int timeout = 300000; // 5 minutes
-    int elapsed = 0;
-    int checkInterval = 2000; // Check every 2 seconds
+    // Follow curl's meter: bytes up, then the wait while the server separates, then bytes down
+    ProcessProgress::CurlTransfer transfer;
+    auto startTime = juce::Time::getMillisecondCounter();
     
-    while (curlProcess.isRunning() && elapsed < timeout)
+    auto onLine = [&](const juce::String& line)
     {
-        if (threadShouldExit())
-        {
-            curlProcess.kill();
-            return false;
-        }
-        
-        Thread::sleep(checkInterval);
-        elapsed += checkInterval;
-        
-        // Update progress based on elapsed time (rough estimate)
-        double processingProgress = 0.4 + (elapsed * 0.45 / timeout);
-        updateProgress(processingProgress, "Processing audio... (" + juce::String(elapsed / 1000) + "s)");
-    }
+        if (transfer.parseLine(line) && (includeAudio || transfer.getBytesReceived() > 0))
+            reportTransfer(transfer.getUploadFraction(), transfer.getBytesSent(), transfer.getDownloadFraction(),
+                           transfer.getBytesReceived(), transfer.getTimeLeft(), startTime);
+    };
+    
+    auto result = curlProcess.waitForExit(300000, onLine); // 5 minutes
     
-    if (curlProcess.isRunning())
+    if (result == ProcessRunner::Result::Cancelled)
+        return false;
+    
+    if (result == ProcessRunner::Result::TimedOut)
     {
-        curlProcess.kill();
-        updateProgress(0.85, "Request timed out");
+        if (includeAudio)
+            updateProgress(0.85, "Request timed out");
         return false;
     }
     
     int exitCode = curlProcess.getExitCode();
-    juce::String output = curlProcess.readAllProcessOutput();
-
+    
     // Log the output for debugging
     juce::Logger::writeToLog("cURL command: " + curlCommand);
     juce::Logger::writeToLog("cURL exit code: " + juce::String(exitCode));
-    juce::Logger::writeToLog("cURL output (stdout/stderr): " + output);
+    juce::Logger::writeToLog("cURL output (stdout/stderr): " + curlProcess.getOutput());
 
     if (exitCode != 0)
     {
-        updateProgress(0.87, "Request failed");
+        if (includeAudio)
+            updateProgress(0.87, "Request failed");
         return false;
     }
     
-    updateProgress(0.85, "Downloading results...");
+    return true;
+}
+
+void HttpStemProcessor::reportTransfer(double uploadFraction, juce::int64 bytesSent, double downloadFraction,
+                                       juce::int64 bytesReceived, const juce::String& timeLeft, juce::uint32 startTime)
+{
+    auto uploadSize = inputFile.getSize();
+    auto eta = timeLeft.isNotEmpty() ? " (" + timeLeft + " left)" : juce::String();
     
-    // Check if we got a response file
-    if (!tempZip.exists() || tempZip.getSize() == 0)
+    if (uploadFraction < 1.0)
     {
-        updateProgress(0.88, "No response received");
-        return false;
+        updateProgress(0.3 + 0.1 * uploadFraction,
+                       "Uploading audio... " + juce::File::descriptionOfSizeInBytes(juce::jmin(bytesSent, uploadSize))
+                           + " of " + juce::File::descriptionOfSizeInBytes(uploadSize) + eta);
+    }
+    else if (bytesReceived == 0)
+    {
+        // The service says nothing while it works, so all there is to show is how long it's taking
+        auto elapsed = juce::Time::getMillisecondCounter() - startTime;
+        updateProgress(0.4, "Separating stems on the server... (" + juce::String(elapsed / 1000) + "s)");
+    }
+    else
+    {
+        updateProgress(0.8 + 0.05 * downloadFraction,
+                       "Downloading stems... " + juce::File::descriptionOfSizeInBytes(bytesReceived)
+                           + " (" + juce::String(juce::roundToInt(downloadFraction * 100.0)) + "%)" + eta);
     }
-    
-        updateProgress(0.88, "Extracting stems...");
-    
-    // Use juce::ZipFile to extract the downloaded archive
-    bool success = extractStems(tempZip);
-    tempZip.deleteFile(); // Clean up
-    
-    return success;
 }
 
-bool HttpStemProcessor::extractStems(const juce::File& zipFile)
+bool HttpStemProcessor::keepStemArchive(const juce::File& zipFile)
 {
-    if (!zipFile.existsAsFile())
-        return false;
-
-    juce::ZipFile archive(zipFile);
-    if (archive.getNumEntries() == 0)
+    // Kept whole and read in place from now on, so the stems never go to disk a second time
+    if (!StemArchive::hasStem(zipFile, "drums"))
+    {
+        juce::Logger::writeToLog("No stems in the archive from the service: " + zipFile.getFullPathName());
+        zipFile.deleteFile();
         return false;
+    }
+    
+    return zipFile.moveFileTo(outputDirectory.getChildFile(StemArchive::fileName));
+}
 
-    auto result = archive.uncompressTo(outputDirectory);
-    if (result.failed())
+bool HttpStemProcessor::separateInSegments()
+{
+    if (!segments->isPlanned())
     {
-        juce::Logger::writeToLog("Failed to extract zip file: " + result.getErrorMessage());
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(inputFile));
+        
+        if (reader == nullptr)
+            return false;
+        
+        segments->plan(reader->lengthInSamples, reader->sampleRate,
+                       static_cast<juce::int64>(segmentSeconds * reader->sampleRate),
+                       static_cast<juce::int64>(segmentOverlapSeconds * reader->sampleRate));
+    }
+    
+    if (segments->getDirectory().createDirectory().failed())
         return false;
+    
+    auto numSegments = segments->getNumSegments();
+    auto numWorkers = juce::jmin(maxParallelSegments, numSegments - segments->getNumReady());
+    SegmentRun pass;
+    
+    auto reportSegments = [this, numSegments]()
+    {
+        auto numReady = segments->getNumReady();
+        
+        if (numReady > 0 && !firstSegmentReported)
+        {
+            firstSegmentReported = true;
+            
+            if (onFirstSegmentReady)
+                onFirstSegmentReady();
+        }
+        
+        updateProgress(0.3 + 0.55 * numReady / numSegments,
+                       "Separating stems... " + juce::String(numReady) + " of " + juce::String(numSegments) + " segments"
+                           + (numReady > 0 && numReady < numSegments ? " - karaoke playback available" : ""));
+    };
+    
+    if (numWorkers > 0)
+    {
+        // Declared after everything the workers use, so they've all finished before any of it goes
+        juce::ThreadPool pool(juce::ThreadPoolOptions{}
+                                  .withThreadName("SegmentSeparation")
+                                  .withNumberOfThreads(numWorkers));
+        
+        for (int i = 0; i < numWorkers; ++i)
+            pool.addJob([this, &pass]() { separateSegments(pass); });
+        
+        // Workers stop by themselves once everything's been handed out
+        while (pool.getNumJobs() > 0)
+        {
+            reportSegments();
+            
+            if (threadShouldExit())
+                pass.stop.signal();
+            
+            pass.progress.wait(segmentProgressIntervalMs);
+        }
     }
-
-    return true;
+    
+    reportSegments();
+    return !pass.failed && !threadShouldExit() && segments->isComplete();
 }
 
-bool HttpStemProcessor::downloadAndExtractStems(const juce::MemoryBlock& zipData)
+void HttpStemProcessor::separateSegments(SegmentRun& pass)
 {
-    // This function is now deprecated, extraction is handled by extractStems.
-    // Kept for compatibility in case it's called elsewhere, but should be removed in the future.
-    juce::File tempZip = outputDirectory.getChildFile("stems_temp.zip");
-    if (tempZip.replaceWithData(zipData.getData(), zipData.getSize()))
+    // Every worker has a connection and an input reader of its own
+    HttpClient segmentClient(serviceUrl);
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> input(formatManager.createReaderFor(inputFile));
+    
+    if (input == nullptr)
+        pass.failed = true;
+    
+    while (!pass.failed && !threadShouldExit())
     {
-        return extractStems(tempZip);
+        auto index = segments->takeNext();
+        
+        if (index < 0)
+            break;
+        
+        auto separated = false;
+        
+        for (int attempt = 0; attempt <= maxRetries && !separated && !threadShouldExit(); ++attempt)
+        {
+            // Backing off the same way as a whole-song request, cut short by a stop
+            if (attempt > 0 && pass.stop.wait(juce::jmin(baseDelayMs * (1 << (attempt - 1)), maxDelayMs)))
+                break;
+            
+            separated = separateSegment(segmentClient, *input, index);
+        }
+        
+        if (separated)
+        {
+            segments->markReady(index);
+        }
+        else
+        {
+            segments->giveBack(index);
+            pass.failed = true;
+            pass.stop.signal();
+        }
+        
+        pass.progress.signal();
     }
-    return false;
+    
+    pass.progress.signal();
 }
 
-bool HttpStemProcessor::generateKaraokeTrack()
+bool HttpStemProcessor::separateSegment(HttpClient& via, juce::AudioFormatReader& input, int index)
 {
-    // Use existing karaoke generation logic
-    juce::File vocalsFile = outputDirectory.getChildFile("vocals.mp3");
-    juce::File drumsFile = outputDirectory.getChildFile("drums.mp3");
-    juce::File bassFile = outputDirectory.getChildFile("bass.mp3");
-    juce::File otherFile = outputDirectory.getChildFile("other.mp3");
-    juce::File karaokeFile = outputDirectory.getChildFile("karaoke.mp3");
+    auto segment = segments->getSegment(index);
+    auto directory = segments->getSegmentDirectory(index);
+    directory.deleteRecursively();
+    
+    if (directory.createDirectory().failed())
+        return false;
+    
+    auto audioFile = directory.getChildFile("input.flac");
     
-    if (!drumsFile.exists() || !bassFile.exists() || !otherFile.exists())
     {
+        auto writer = createFlacWriter(audioFile, input.sampleRate, static_cast<int>(input.numChannels));
+        
+        if (writer == nullptr || !writer->writeFromAudioReader(input, segment.startSample, segment.numSamples))
+            return false;
+    }
+    
+    // Hash first here too, so a segment the service has separated before isn't uploaded again
+    auto audioHash = Sha256::hashFile(audioFile);
+    auto zipFile = directory.getChildFile(StemArchive::fileName);
+    auto keepGoing = [this](const HttpClient::Progress&) { return !threadShouldExit(); };
+    auto status = audioHash.isNotEmpty() ? postSeparation(via, audioFile, audioHash, zipFile, false, keepGoing) : 0;
+    
+    if (status != 200 && !threadShouldExit())
+        status = postSeparation(via, audioFile, audioHash, zipFile, true, keepGoing);
+    
+    if (status != 200)
+    {
+        if (!threadShouldExit())
+            juce::Logger::writeToLog("Segment " + juce::String(index) + " failed: "
+                                     + (status > 0 ? "HTTP " + juce::String(status) + ": " + zipFile.loadFileAsString() : via.getLastError()));
         return false;
     }
     
-    // Use FFmpeg to mix non-vocal stems
-    juce::StringArray ffmpegArgs;
-    ffmpegArgs.add("ffmpeg");
-    ffmpegArgs.add("-i"); ffmpegArgs.add(drumsFile.getFullPathName());
-    ffmpegArgs.add("-i"); ffmpegArgs.add(bassFile.getFullPathName());
-    ffmpegArgs.add("-i"); ffmpegArgs.add(otherFile.getFullPathName());
-    ffmpegArgs.add("-filter_complex");
-    ffmpegArgs.add("[0:a][1:a][2:a]amix=inputs=3:duration=longest:dropout_transition=0");
-    ffmpegArgs.add("-y"); // Overwrite output file
-    ffmpegArgs.add(karaokeFile.getFullPathName());
+    audioFile.deleteFile();
     
-    juce::String ffmpegCommand = ffmpegArgs.joinIntoString(" ");
+    // Its stems are read straight out of the archive
+    if (!StemArchive::hasStem(zipFile, "drums"))
+    {
+        juce::Logger::writeToLog("No stems in the archive for segment " + juce::String(index));
+        return false;
+    }
     
-    juce::ChildProcess ffmpegProcess;
-    if (!ffmpegProcess.start(ffmpegCommand))
+    return true;
+}
+
+bool HttpStemProcessor::stitchSegments()
+{
+    updateProgress(0.86, "Joining segments...");
+    
+    // Written out whole, so everything after this sees the same stems a single request would have left
+    for (auto* stemName : { "vocals", "drums", "bass", "other" })
+    {
+        auto reader = StemSegments::createReader(segments, { stemName }, 1.0f);
+        
+        if (reader == nullptr)
+            return false;
+        
+        auto writer = createFlacWriter(outputDirectory.getChildFile(juce::String(stemName) + ".flac"), reader->sampleRate, 2);
+        
+        if (writer == nullptr || !writer->writeFromAudioReader(*reader, 0, reader->lengthInSamples))
+            return false;
+        
+        if (threadShouldExit())
+            return false;
+    }
+    
+    return true;
+}
+
+std::unique_ptr<juce::AudioFormatReader> HttpStemProcessor::createKaraokeReader(const std::shared_ptr<StemSegments>& stemSegments)
+{
+    // The same sum generateKaraokeTrack writes out, each stem at 1/n
+    return StemSegments::createReader(stemSegments, { "drums", "bass", "other" }, 1.0f / 3.0f);
+}
+
+bool HttpStemProcessor::generateKaraokeTrack()
+{
+    juce::File karaokeFile = outputDirectory.getChildFile("karaoke.wav");
+    
+    if (!hasStem(outputDirectory, "drums") || !hasStem(outputDirectory, "bass") || !hasStem(outputDirectory, "other"))
     {
         return false;
     }
     
-    return ffmpegProcess.waitForProcessToFinish(30000);
+    return mixStems({ "drums", "bass", "other" }, karaokeFile);
 }
 
 bool HttpStemProcessor::processVocalWithRVC()
 {
-    // Use existing RVC processing logic if available
-    juce::File vocalsFile = outputDirectory.getChildFile("vocals.mp3");
+    // RVC runs as a process of its own and needs the vocals as a file, so they're the one stem taken out of the archive
+    juce::File vocalsFile = findStem(outputDirectory, "vocals");
     
-    if (!vocalsFile.exists())
+    if (!vocalsFile.existsAsFile())
+        vocalsFile = StemArchive::extractStem(outputDirectory.getChildFile(StemArchive::fileName), "vocals", outputDirectory);
+    
+    if (!vocalsFile.existsAsFile())
         return false;
     
-    juce::File rvcOutputFile = outputDirectory.getChildFile("vocals_rvc.mp3");
+    juce::File rvcOutputFile = outputDirectory.getChildFile("vocals_rvc.wav");
     
     RVCProcessor rvcProcessor(vocalsFile, rvcOutputFile);
-    rvcProcessor.startThread();
     
-    // Wait for completion (simplified for now)
-    while (rvcProcessor.isThreadRunning())
-    {
-        if (threadShouldExit())
-        {
-            rvcProcessor.stopThread(1000);
-            return false;
-        }
-        Thread::sleep(100);
-    }
+    // Stopping this thread stops the processor, whose process runner then kills RVC at once
+    StopForwarder forwarder(*this, rvcProcessor);
     
-    return rvcOutputFile.exists();
+    if (threadShouldExit())
+        return false;
+    
+    rvcProcessor.startThread();
+    rvcProcessor.waitForThreadToExit(-1);
+    
+    return !threadShouldExit() && rvcOutputFile.exists();
 }
 
 bool HttpStemProcessor::generateRVCKaraokeTrack()
 {
     // Generate karaoke with RVC-processed vocals
-    juce::File rvcVocalsFile = outputDirectory.getChildFile("vocals_rvc.mp3");
-    juce::File drumsFile = outputDirectory.getChildFile("drums.mp3");
-    juce::File bassFile = outputDirectory.getChildFile("bass.mp3");
-    juce::File otherFile = outputDirectory.getChildFile("other.mp3");
-    juce::File rvcKaraokeFile = outputDirectory.getChildFile("karaoke_with_rvc.mp3");
+    juce::File rvcKaraokeFile = outputDirectory.getChildFile("karaoke_with_rvc.wav");
     
-    if (!rvcVocalsFile.exists() || !drumsFile.exists() || !bassFile.exists() || !otherFile.exists())
+    if (!hasStem(outputDirectory, "vocals_rvc") || !hasStem(outputDirectory, "drums")
+        || !hasStem(outputDirectory, "bass") || !hasStem(outputDirectory, "other"))
     {
         return false;
     }
     
-    // Use FFmpeg to mix all stems including RVC vocals
-    juce::StringArray ffmpegArgs;
-    ffmpegArgs.add("ffmpeg");
-    ffmpegArgs.add("-i"); ffmpegArgs.add(rvcVocalsFile.getFullPathName());
-    ffmpegArgs.add("-i"); ffmpegArgs.add(drumsFile.getFullPathName());
-    ffmpegArgs.add("-i"); ffmpegArgs.add(bassFile.getFullPathName());
-    ffmpegArgs.add("-i"); ffmpegArgs.add(otherFile.getFullPathName());
-    ffmpegArgs.add("-filter_complex");
-    ffmpegArgs.add("[0:a][1:a][2:a][3:a]amix=inputs=4:duration=longest:dropout_transition=0");
-    ffmpegArgs.add("-y"); // Overwrite output file
-    ffmpegArgs.add(rvcKaraokeFile.getFullPathName());
+    return mixStems({ "vocals_rvc", "drums", "bass", "other" }, rvcKaraokeFile);
+}
+
+bool HttpStemProcessor::mixStems(const juce::StringArray& stemNames, const juce::File& outputFile)
+{
+    // Opened once here for the rate and length - every render worker opens its own as well
+    StemSum probe(outputDirectory, stemNames);
+    
+    if (!probe.isValid())
+        return false;
     
-    juce::String ffmpegCommand = ffmpegArgs.joinIntoString(" ");
+    // The karaoke track's existence means it's ready, so it's written elsewhere and moved into place
+    juce::TemporaryFile tempFile(outputFile);
+    auto writer = IntermediateAudio::createWriter(tempFile.getFile(), probe.getSampleRate(), 2);
     
-    juce::ChildProcess ffmpegProcess;
-    if (!ffmpegProcess.start(ffmpegCommand))
-    {
+    if (writer == nullptr)
         return false;
+    
+    auto chunks = ChunkedRenderer::split(0, probe.getLengthInSamples(),
+                                         static_cast<juce::int64>(mixChunkSeconds * probe.getSampleRate()));
+    
+    auto createProcessor = [this, &stemNames]() -> std::unique_ptr<ChunkedRenderer::Processor>
+    {
+        auto sum = std::make_unique<StemSum>(outputDirectory, stemNames);
+        
+        if (!sum->isValid())
+            return nullptr;
+        
+        return sum;
+    };
+    
+    auto rendered = ChunkedRenderer::render(chunks, 2, 0, createProcessor,
+                                            [&writer](int, const juce::AudioBuffer<float>& audio)
+                                            {
+                                                return writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples());
+                                            },
+                                            [this]() { return threadShouldExit(); });
+    
+    writer.reset();
+    
+    return rendered && tempFile.overwriteTargetFileWithTemporary();
+}
+
+juce::File HttpStemProcessor::findStem(const juce::File& directory, const juce::String& stemName)
+{
+    for (auto* extension : { ".flac", ".wav", ".mp3" })
+    {
+        auto file = directory.getChildFile(stemName + extension);
+        
+        if (file.existsAsFile())
+            return file;
     }
     
-    return ffmpegProcess.waitForProcessToFinish(30000);
+    return directory.getChildFile(stemName + ".flac");
+}
+
+std::unique_ptr<juce::AudioFormatReader> HttpStemProcessor::createStemReader(const juce::File& directory, const juce::String& stemName)
+{
+    // Loose files are ones made here - stitched segments, RVC's vocals - and the service's own are in its archive
+    auto file = findStem(directory, stemName);
+    
+    if (file.existsAsFile())
+        return IntermediateAudio::createReader(file);
+    
+    return StemArchive::createReader(directory.getChildFile(StemArchive::fileName), stemName);
+}
+
+bool HttpStemProcessor::hasStem(const juce::File& directory, const juce::String& stemName)
+{
+    return findStem(directory, stemName).existsAsFile() || StemArchive::hasStem(directory.getChildFile(StemArchive::fileName), stemName);
 }
 
 bool HttpStemProcessor::isTransientError(int exitCode, const juce::String& output)
@@ -371,7 +909,9 @@ void HttpStemProcessor::waitWithBackoff(int attemptNumber)
     if (delay > 0)
     {
         updateProgress(0.05 + (attemptNumber * 0.02), "Waiting " + juce::String(delay / 1000.0, 1) + "s before retry...");
-        Thread::sleep(delay);
+        
+        // stopThread() wakes this straight away
+        wait(delay);
     }
 }
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "HttpClient.h"
+#include "StemSegments.h"
 
 /**
  * HTTP-based stem processor that communicates with a stem separation service
@@ -15,10 +17,40 @@ public:
     
     void run() override;
     
+    // Ask the service for FLAC stems rather than MP3, so nothing is lossy until export. On by default.
+    void setLosslessStems(bool shouldBeLossless) { losslessStems = shouldBeLossless; }
+    
+    // The model the service is asked to separate with
+    static constexpr const char* separationModel = "htdemucs_ft";
+    
+    // Everything the stems depend on besides the song itself, for keying the StemCache
+    static juce::String getCacheVariant(bool lossless = true) { return juce::String(separationModel) + (lossless ? "-flac" : "-mp3"); }
+    
+    // Separate the song in overlapping segments, several at once and the part under the playhead
+    // first, so the karaoke track can be played long before all of it is back. Plain http only. On by default.
+    void setSegmentedSeparation(bool shouldSegment) { segmentedSeparation = shouldSegment; }
+    
+    // Shared with whatever plays the karaoke track while segments are still arriving
+    std::shared_ptr<StemSegments> getSegments() const { return segments; }
+    
+    // The karaoke track as far as it's been separated. Null until the first segment is back.
+    static std::unique_ptr<juce::AudioFormatReader> createKaraokeReader(const std::shared_ptr<StemSegments>& segments);
+    
+    // A separated stem as a file of its own in whichever format it was written, e.g. findStem(dir, "vocals").
+    // The service's stems stay in their archive, so for those this is a file that doesn't exist.
+    static juce::File findStem(const juce::File& directory, const juce::String& stemName);
+    
+    // Reads a stem from a directory of them, whether it's a file of its own or still in the service's archive
+    static std::unique_ptr<juce::AudioFormatReader> createStemReader(const juce::File& directory, const juce::String& stemName);
+    static bool hasStem(const juce::File& directory, const juce::String& stemName);
+    
     // Callbacks - same interface as original StemProcessor
     std::function<void(bool success, const juce::String& message)> onProcessingComplete;
     std::function<void(double progress, const juce::String& statusMessage)> onProgressUpdate;
     
+    // Called on the processing thread once the first segment's stems are back
+    std::function<void()> onFirstSegmentReady;
+    
 private:
     juce::File inputFile;
     juce::File outputDirectory;
@@ -29,11 +61,43 @@ private:
     int baseDelayMs;
     int maxDelayMs;
     
+    bool losslessStems = true;
+    
+    // SHA-256 of the input, so the service can answer from its own cache before anything is uploaded
+    juce::String inputHash;
+    
+    // Kept between requests, so the health check and the upload share a connection
+    HttpClient client;
+    
+    bool segmentedSeparation = true;
+    std::shared_ptr<StemSegments> segments;
+    bool firstSegmentReported = false;
+    
+    // Shared by the segment workers for one pass over the song
+    struct SegmentRun
+    {
+        std::atomic<bool> failed { false };
+        juce::WaitableEvent progress;
+        juce::WaitableEvent stop { true };
+    };
+    
     // HTTP communication
     bool isServiceAvailable();
+    bool isServiceAvailableWithCurl();
     bool sendSeparationRequest();
-    bool extractStems(const juce::File& zipFile);
-    bool downloadAndExtractStems(const juce::MemoryBlock& zipData);
+    bool downloadStems(const juce::File& tempZip);
+    bool downloadStemsWithCurl(const juce::File& tempZip);
+    int postSeparation(HttpClient& via, const juce::File& audioFile, const juce::String& audioHash,
+                       const juce::File& tempZip, bool includeAudio, const HttpClient::ProgressCallback& onProgress);
+    HttpClient::ProgressCallback createTransferReporter(bool includeAudio);
+    bool runCurlSeparation(const juce::File& tempZip, bool includeAudio);
+    void reportTransfer(double uploadFraction, juce::int64 bytesSent, double downloadFraction,
+                        juce::int64 bytesReceived, const juce::String& timeLeft, juce::uint32 startTime);
+    bool keepStemArchive(const juce::File& zipFile);
+    bool separateInSegments();
+    void separateSegments(SegmentRun& pass);
+    bool separateSegment(HttpClient& via, juce::AudioFormatReader& input, int index);
+    bool stitchSegments();
     
     // Retry logic
     bool isServiceAvailableWithRetry();
@@ -49,5 +113,8 @@ private:
     bool processVocalWithRVC();
     bool generateRVCKaraokeTrack();
     
+    // Mixes the stems natively across all cores into a float intermediate
+    bool mixStems(const juce::StringArray& stemNames, const juce::File& outputFile);
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HttpStemProcessor)
 };
\ No newline at end of file
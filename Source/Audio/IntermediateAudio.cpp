@@ -0,0 +1,37 @@
+#include "IntermediateAudio.h"
+
+std::unique_ptr<juce::AudioFormatReader> IntermediateAudio::createReader(const juce::File& file)
+{
+    if (file.hasFileExtension("wav"))
+    {
+        juce::WavAudioFormat wavFormat;
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(wavFormat.createMemoryMappedReader(file));
+
+        if (mapped != nullptr && mapped->mapEntireFile())
+            return mapped;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    return std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(file));
+}
+
+std::unique_ptr<juce::AudioFormatWriter> IntermediateAudio::createWriter(const juce::File& file, double sampleRate, int numChannels)
+{
+    file.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> stream(file.createOutputStream());
+
+    if (stream == nullptr)
+        return nullptr;
+
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), sampleRate,
+                                                                              static_cast<unsigned int>(numChannels),
+                                                                              bitsPerSample, {}, 0));
+
+    // The writer owns the stream from here
+    if (writer != nullptr)
+        stream.release();
+
+    return writer;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Audio handed from one stage of the pipeline to the next - the karaoke track, the vocal
+ * composite, the mix - is kept as 32-bit float WAV, so nothing is lost until the single
+ * encode at export. WAV files are read memory-mapped: samples come straight out of the page
+ * cache without decoding, and every worker reading the same file shares the same pages.
+ */
+class IntermediateAudio
+{
+public:
+    static constexpr int bitsPerSample = 32;
+
+    // Memory-mapped for WAV, otherwise whichever of the basic formats can read it
+    static std::unique_ptr<juce::AudioFormatReader> createReader(const juce::File& file);
+
+    // Replaces the file with an empty float WAV
+    static std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File& file, double sampleRate, int numChannels);
+
+private:
+    IntermediateAudio() = delete;
+};
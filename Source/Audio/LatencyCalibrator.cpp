@@ -0,0 +1,145 @@
+#include "LatencyCalibrator.h"
+#include "CrossCorrelator.h"
+
+namespace
+{
+    constexpr double leadInSeconds = 0.25;
+    constexpr double sweepSeconds = 0.5;
+    constexpr double maxLatencySeconds = 1.0;
+    constexpr double sweepStartHz = 200.0;
+    constexpr double sweepEndHz = 8000.0;
+    constexpr float sweepLevel = 0.25f;
+    constexpr float minimumConfidence = 0.3f;
+}
+
+LatencyCalibrator::LatencyCalibrator()
+{
+}
+
+LatencyCalibrator::~LatencyCalibrator()
+{
+}
+
+void LatencyCalibrator::prepare(double newOutputSampleRate, double newInputSampleRate)
+{
+    jassert(!isRunning());
+
+    outputSampleRate = newOutputSampleRate;
+    inputSampleRate = newInputSampleRate;
+
+    leadInSamples = static_cast<int>(leadInSeconds * outputSampleRate);
+    generateSweep(outputSignal, outputSampleRate, leadInSamples);
+    generateSweep(referenceSignal, inputSampleRate, 0);
+
+    auto captureLength = static_cast<size_t>((leadInSeconds + sweepSeconds + maxLatencySeconds) * inputSampleRate);
+    captureBuffer.assign(captureLength, 0.0f);
+
+    outputPosition = 0;
+    capturedSamples = 0;
+    captureSongStartSample = 0;
+    captureAligned = false;
+
+    state = Running;
+}
+
+void LatencyCalibrator::cancel()
+{
+    state = Idle;
+}
+
+juce::int64 LatencyCalibrator::renderOutput(juce::AudioBuffer<float>& buffer)
+{
+    auto firstSample = outputPosition;
+    auto numSamples = buffer.getNumSamples();
+
+    buffer.clear();
+
+    auto available = static_cast<int>(juce::jlimit<juce::int64>(0, numSamples,
+                                                                static_cast<juce::int64>(outputSignal.size()) - outputPosition));
+
+    if (available > 0)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            buffer.copyFrom(channel, 0, outputSignal.data() + outputPosition, available);
+    }
+
+    outputPosition += numSamples;
+    return firstSample;
+}
+
+void LatencyCalibrator::captureInput(const float* input, int numSamples, juce::int64 blockHostTimeNs, const AudioClock& clock)
+{
+    if (state.load() != Running || input == nullptr)
+        return;
+
+    // Only start capturing once the output is running, so the capture has a known place on its timeline
+    if (!captureAligned)
+    {
+        AudioClock::Anchor anchor;
+
+        if (!clock.read(anchor) || !anchor.isRunning)
+            return;
+
+        captureSongStartSample = static_cast<juce::int64>(std::llround(AudioClock::getPositionAt(anchor, blockHostTimeNs, inputSampleRate)));
+        captureAligned = true;
+    }
+
+    auto toCopy = juce::jmin(numSamples, static_cast<int>(captureBuffer.size()) - capturedSamples);
+    juce::FloatVectorOperations::copy(captureBuffer.data() + capturedSamples, input, toCopy);
+    capturedSamples += toCopy;
+
+    if (capturedSamples >= static_cast<int>(captureBuffer.size()))
+        state = CaptureComplete;
+}
+
+int LatencyCalibrator::analyse(float& confidence)
+{
+    confidence = 0.0f;
+
+    if (!isCaptureComplete())
+        return -1;
+
+    state = Idle;
+
+    // Where the sweep would sit in the capture if there were no latency at all
+    auto sweepStart = static_cast<juce::int64>(std::llround(leadInSamples * inputSampleRate / outputSampleRate));
+    auto expectedIndex = static_cast<int>(sweepStart - captureSongStartSample);
+
+    auto result = CrossCorrelator::findBestLag(captureBuffer.data(), capturedSamples,
+                                               referenceSignal.data(), static_cast<int>(referenceSignal.size()),
+                                               expectedIndex, capturedSamples - static_cast<int>(referenceSignal.size()));
+
+    juce::Logger::writeToLog("Latency calibration: lag " + juce::String(result.lag) + ", expected "
+                             + juce::String(expectedIndex) + ", confidence " + juce::String(result.confidence));
+
+    if (!result.found || result.confidence < minimumConfidence)
+        return -1;
+
+    confidence = result.confidence;
+    return result.lag - expectedIndex;
+}
+
+void LatencyCalibrator::generateSweep(std::vector<float>& destination, double sampleRate, int leadIn)
+{
+    auto sweepLength = static_cast<int>(sweepSeconds * sampleRate);
+    destination.assign(static_cast<size_t>(leadIn + sweepLength), 0.0f);
+
+    // Exponential sine sweep - sharp autocorrelation peak and robust against room noise
+    auto k = std::log(sweepEndHz / sweepStartHz);
+    auto fadeLength = static_cast<int>(0.01 * sampleRate);
+
+    for (int i = 0; i < sweepLength; ++i)
+    {
+        auto t = i / sampleRate;
+        auto phase = juce::MathConstants<double>::twoPi * sweepStartHz * sweepSeconds / k
+                       * (std::exp(t * k / sweepSeconds) - 1.0);
+
+        auto gain = 1.0f;
+        if (i < fadeLength)
+            gain = static_cast<float>(i) / fadeLength;
+        else if (i > sweepLength - fadeLength)
+            gain = static_cast<float>(sweepLength - i) / fadeLength;
+
+        destination[static_cast<size_t>(leadIn + i)] = sweepLevel * gain * static_cast<float>(std::sin(phase));
+    }
+}
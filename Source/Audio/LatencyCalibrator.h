@@ -0,0 +1,62 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioClock.h"
+
+/**
+ * Measures the true round-trip latency between the playback output and the recording input.
+ * A short sine sweep is played through the output, captured on the input and located by
+ * cross-correlation. The result is the delay between a sample leaving processBlock and the
+ * same sample arriving in the recording callback, i.e. output plus input latency.
+ */
+class LatencyCalibrator
+{
+public:
+    LatencyCalibrator();
+    ~LatencyCalibrator();
+
+    // Message thread - allocates everything the real-time side needs
+    void prepare(double outputSampleRate, double inputSampleRate);
+    void cancel();
+
+    bool isRunning() const { return state.load() == Running; }
+    bool isCaptureComplete() const { return state.load() == CaptureComplete; }
+
+    // Output side, called from processBlock. Returns the position of the first sample
+    // rendered, which is published on the clock in place of the transport position
+    juce::int64 renderOutput(juce::AudioBuffer<float>& buffer);
+    juce::int64 getOutputPosition() const { return outputPosition; }
+
+    // Input side, called from the recording callback (or processBlock on a full-duplex device)
+    void captureInput(const float* input, int numSamples, juce::int64 blockHostTimeNs, const AudioClock& clock);
+
+    // Message thread, once the capture is complete. Returns the latency in input samples, or -1
+    int analyse(float& confidence);
+
+private:
+    enum State
+    {
+        Idle,
+        Running,
+        CaptureComplete
+    };
+
+    std::atomic<int> state { Idle };
+
+    double outputSampleRate = 44100.0;
+    double inputSampleRate = 44100.0;
+
+    std::vector<float> outputSignal;
+    std::vector<float> referenceSignal;
+    std::vector<float> captureBuffer;
+
+    int leadInSamples = 0;                       // Output samples of silence before the sweep
+    juce::int64 outputPosition = 0;
+    int capturedSamples = 0;
+    juce::int64 captureSongStartSample = 0;      // Output timeline position of capture sample 0, in input samples
+    bool captureAligned = false;
+
+    static void generateSweep(std::vector<float>& destination, double sampleRate, int leadIn);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LatencyCalibrator)
+};
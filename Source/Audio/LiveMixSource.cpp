@@ -0,0 +1,91 @@
+#include "LiveMixSource.h"
+
+LiveMixSource::LiveMixSource(std::unique_ptr<juce::AudioFormatReader> backingTrack)
+    : backing(std::move(backingTrack))
+{
+}
+
+LiveMixSource::~LiveMixSource()
+{
+}
+
+void LiveMixSource::setTakes(const juce::File& containerFile, const juce::Array<TakeManager::Take>& takes)
+{
+    // Opening the takes can touch the disk, so it happens before taking the lock
+    auto newVocal = std::make_unique<TakeManager::CompositeReader>(containerFile, takes);
+    std::unique_ptr<MixEngine> newEngine;
+
+    const juce::ScopedLock sl(lock);
+
+    if (!newVocal->isEmpty())
+        newEngine = std::make_unique<MixEngine>(*backing, *newVocal,
+                                                static_cast<juce::int64>(std::llround(vocalOffsetSeconds * newVocal->sampleRate)));
+
+    // The old engine still points at the old vocal, so it has to go first
+    engine = std::move(newEngine);
+    vocal = std::move(newVocal);
+}
+
+void LiveMixSource::setVocalOffsetSeconds(double seconds)
+{
+    const juce::ScopedLock sl(lock);
+    vocalOffsetSeconds = seconds;
+
+    if (engine != nullptr)
+        engine->setVocalOffset(getVocalOffsetSamples());
+}
+
+juce::int64 LiveMixSource::getVocalOffsetSamples() const
+{
+    return vocal != nullptr ? static_cast<juce::int64>(std::llround(vocalOffsetSeconds * vocal->sampleRate)) : 0;
+}
+
+void LiveMixSource::prepareToPlay(int, double)
+{
+}
+
+void LiveMixSource::releaseResources()
+{
+}
+
+void LiveMixSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    auto& buffer = *bufferToFill.buffer;
+    auto start = position.load();
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        if (engine != nullptr && buffer.getNumChannels() >= numOutputChannels)
+        {
+            engine->readStems(buffer, bufferToFill.startSample, start, bufferToFill.numSamples);
+        }
+        else
+        {
+            // No takes yet - just the backing track, with a silent vocal channel
+            juce::AudioBuffer<float> stereo(buffer.getArrayOfWritePointers(), juce::jmin(2, buffer.getNumChannels()),
+                                            bufferToFill.startSample, bufferToFill.numSamples);
+            backing->read(&stereo, 0, bufferToFill.numSamples, start, true, true);
+
+            for (int channel = 2; channel < buffer.getNumChannels(); ++channel)
+                buffer.clear(channel, bufferToFill.startSample, bufferToFill.numSamples);
+        }
+    }
+
+    position = start + bufferToFill.numSamples;
+}
+
+void LiveMixSource::setNextReadPosition(juce::int64 newPosition)
+{
+    position = newPosition;
+}
+
+juce::int64 LiveMixSource::getNextReadPosition() const
+{
+    return position;
+}
+
+juce::int64 LiveMixSource::getTotalLength() const
+{
+    return backing->lengthInSamples;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "TakeManager.h"
+#include "MixEngine.h"
+
+/**
+ * Plays the backing track together with the takes recorded over it, so a take can be heard
+ * the moment it's finished rather than after an offline render. It produces three channels -
+ * backing track left and right, then the vocal - and leaves the final mix to the processor,
+ * so level and pan changes are heard immediately even though the audio is read ahead.
+ *
+ * Positions and length are in backing track samples. The vocal is resampled to match.
+ */
+class LiveMixSource : public juce::PositionableAudioSource
+{
+public:
+    static constexpr int numOutputChannels = 3;
+
+    explicit LiveMixSource(std::unique_ptr<juce::AudioFormatReader> backingTrack);
+    ~LiveMixSource() override;
+
+    double getSampleRate() const { return backing->sampleRate; }
+
+    // Swaps in a new set of takes. Safe while playing.
+    void setTakes(const juce::File& containerFile, const juce::Array<TakeManager::Take>& takes);
+
+    // Moves the vocal against the song, on top of where the takes were recorded
+    void setVocalOffsetSeconds(double seconds);
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(juce::int64 newPosition) override;
+    juce::int64 getNextReadPosition() const override;
+    juce::int64 getTotalLength() const override;
+    bool isLooping() const override { return false; }
+
+private:
+    juce::CriticalSection lock;
+    std::unique_ptr<juce::AudioFormatReader> backing;
+    std::unique_ptr<TakeManager::CompositeReader> vocal;
+    std::unique_ptr<MixEngine> engine;
+    double vocalOffsetSeconds = 0.0;
+    std::atomic<juce::int64> position { 0 };
+
+    juce::int64 getVocalOffsetSamples() const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LiveMixSource)
+};
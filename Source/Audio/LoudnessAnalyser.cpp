@@ -0,0 +1,110 @@
+#include "LoudnessAnalyser.h"
+
+namespace
+{
+    // Long enough for the K-weighting high-pass and the true-peak filter to forget their start
+    constexpr double leadInSeconds = 0.5;
+
+    // Below this, splitting costs more in lead-in and thread hand-off than it saves
+    constexpr double minimumChunkSeconds = 20.0;
+
+    constexpr int readBlockSize = 8192;
+}
+
+bool LoudnessAnalyser::analyse(double sampleRate, int numChannels, juce::int64 lengthInSamples,
+                               const std::function<std::unique_ptr<Source>()>& createSource,
+                               Result& result, const std::function<bool()>& shouldExit)
+{
+    result = {};
+
+    if (lengthInSamples <= 0)
+        return true;
+
+    auto subBlockLength = static_cast<juce::int64>(juce::jmax(1, juce::roundToInt(sampleRate * 0.1)));
+    auto numCpus = juce::SystemStats::getNumCpus();
+
+    // Chunks are whole numbers of sub-blocks so their measurements join up seamlessly
+    auto chunkLength = juce::jmax(static_cast<juce::int64>(minimumChunkSeconds * sampleRate),
+                                  (lengthInSamples + numCpus - 1) / numCpus);
+    chunkLength = (chunkLength + subBlockLength - 1) / subBlockLength * subBlockLength;
+
+    auto numChunks = static_cast<int>((lengthInSamples + chunkLength - 1) / chunkLength);
+    auto leadIn = static_cast<juce::int64>(leadInSeconds * sampleRate);
+
+    // Readers aren't thread-safe, so every chunk pulls from its own source
+    std::vector<std::unique_ptr<Source>> sources;
+
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+    {
+        sources.push_back(createSource());
+
+        if (sources.back() == nullptr)
+            return false;
+    }
+
+    std::vector<std::vector<double>> chunkEnergies(static_cast<size_t>(numChunks));
+    std::vector<float> chunkPeaks(static_cast<size_t>(numChunks), 0.0f);
+    std::atomic<bool> cancelled { false };
+
+    juce::ThreadPool pool(juce::ThreadPoolOptions{}
+                              .withThreadName("LoudnessAnalyser")
+                              .withNumberOfThreads(juce::jmin(numChunks, numCpus)));
+
+    std::atomic<int> remaining { numChunks };
+    juce::WaitableEvent allDone;
+
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+    {
+        pool.addJob([&, chunk]()
+        {
+            auto& source = *sources[static_cast<size_t>(chunk)];
+            auto chunkStart = chunk * chunkLength;
+            auto chunkEnd = juce::jmin(lengthInSamples, chunkStart + chunkLength);
+            auto readStart = juce::jmax<juce::int64>(0, chunkStart - leadIn);
+
+            LoudnessMeter meter;
+            meter.prepare(sampleRate, numChannels);
+            juce::AudioBuffer<float> buffer(numChannels, readBlockSize);
+
+            for (auto position = readStart; position < chunkEnd;)
+            {
+                if (cancelled || shouldExit())
+                {
+                    cancelled = true;
+                    break;
+                }
+
+                // Stop exactly at the chunk start the first time, so the lead-in can be dropped
+                auto limit = position < chunkStart ? chunkStart : chunkEnd;
+                auto numSamples = static_cast<int>(juce::jmin<juce::int64>(readBlockSize, limit - position));
+
+                source.read(buffer, position, numSamples);
+                meter.process(buffer.getArrayOfReadPointers(), numChannels, numSamples);
+                position += numSamples;
+
+                if (position == chunkStart)
+                    meter.clearMeasurements();
+            }
+
+            chunkEnergies[static_cast<size_t>(chunk)] = meter.getSubBlockEnergies();
+            chunkPeaks[static_cast<size_t>(chunk)] = meter.getTruePeak();
+
+            if (--remaining == 0)
+                allDone.signal();
+        });
+    }
+
+    allDone.wait();
+
+    if (cancelled)
+        return false;
+
+    std::vector<double> energies;
+
+    for (auto& chunk : chunkEnergies)
+        energies.insert(energies.end(), chunk.begin(), chunk.end());
+
+    result.integratedLoudness = LoudnessMeter::getIntegratedLoudness(energies);
+    result.truePeak = *std::max_element(chunkPeaks.begin(), chunkPeaks.end());
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LoudnessMeter.h"
+
+/**
+ * Measures a whole programme's integrated loudness and true peak by splitting it into
+ * chunks and metering them in parallel. Each chunk starts on a 100 ms sub-block boundary
+ * with some lead-in to settle the filters, so the joined measurement is the same as one
+ * meter run over the whole thing.
+ */
+class LoudnessAnalyser
+{
+public:
+    // Produces the programme from any position. Each worker gets its own instance.
+    class Source
+    {
+    public:
+        virtual ~Source() = default;
+        virtual void read(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples) = 0;
+    };
+
+    struct Result
+    {
+        double integratedLoudness = -std::numeric_limits<double>::infinity();  // LUFS
+        float truePeak = 0.0f;                                                  // Linear
+    };
+
+    // False if cancelled or a source couldn't be created
+    static bool analyse(double sampleRate, int numChannels, juce::int64 lengthInSamples,
+                        const std::function<std::unique_ptr<Source>()>& createSource,
+                        Result& result, const std::function<bool()>& shouldExit);
+
+private:
+    LoudnessAnalyser() = delete;
+};
@@ -0,0 +1,197 @@
+#include "LoudnessMeter.h"
+
+namespace
+{
+    constexpr double absoluteGate = -70.0;
+    constexpr double relativeGate = -10.0;
+
+    double energyToLoudness(double energy)
+    {
+        return -0.691 + 10.0 * std::log10(energy);
+    }
+}
+
+LoudnessMeter::LoudnessMeter()
+{
+}
+
+LoudnessMeter::~LoudnessMeter()
+{
+}
+
+void LoudnessMeter::prepare(double newSampleRate, int numChannels)
+{
+    sampleRate = newSampleRate;
+    subBlockLength = juce::jmax(1, juce::roundToInt(sampleRate * 0.1));
+
+    // The BS.1770 pre-filter (high shelf) and RLB high-pass, derived for any sample rate
+    Biquad shelfFilter;
+    {
+        const double f0 = 1681.974450955533, gain = 3.999843853973347, q = 0.7071752369554196;
+        auto k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        auto vh = std::pow(10.0, gain / 20.0);
+        auto vb = std::pow(vh, 0.4996667741545416);
+        auto a0 = 1.0 + k / q + k * k;
+
+        shelfFilter.b0 = (vh + vb * k / q + k * k) / a0;
+        shelfFilter.b1 = 2.0 * (k * k - vh) / a0;
+        shelfFilter.b2 = (vh - vb * k / q + k * k) / a0;
+        shelfFilter.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelfFilter.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    Biquad highPassFilter;
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        auto k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        auto a0 = 1.0 + k / q + k * k;
+
+        highPassFilter.b0 = 1.0;
+        highPassFilter.b1 = -2.0;
+        highPassFilter.b2 = 1.0;
+        highPassFilter.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPassFilter.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    shelf.assign(static_cast<size_t>(numChannels), shelfFilter);
+    highPass.assign(static_cast<size_t>(numChannels), highPassFilter);
+
+    weighted.setSize(1, blockSize);
+    energy.setSize(1, blockSize);
+    peaks.setSize(1, blockSize);
+    truePeakDetector.prepare(numChannels, blockSize);
+
+    reset();
+}
+
+void LoudnessMeter::reset()
+{
+    for (auto& biquad : shelf)
+        biquad.z1 = biquad.z2 = 0.0;
+    for (auto& biquad : highPass)
+        biquad.z1 = biquad.z2 = 0.0;
+
+    truePeakDetector.reset();
+    clearMeasurements();
+}
+
+void LoudnessMeter::clearMeasurements()
+{
+    subBlockPosition = 0;
+    subBlockEnergy = 0.0;
+    subBlockEnergies.clear();
+    truePeak = 0.0f;
+}
+
+void LoudnessMeter::process(const float* const* data, int numChannels, int numSamples)
+{
+    numChannels = juce::jmin(numChannels, static_cast<int>(shelf.size()));
+
+    const float* offsetData[8] {};
+    numChannels = juce::jmin(numChannels, static_cast<int>(std::size(offsetData)));
+
+    for (int position = 0; position < numSamples; position += blockSize)
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+            offsetData[channel] = data[channel] + position;
+
+        processBlock(offsetData, numChannels, juce::jmin(blockSize, numSamples - position));
+    }
+}
+
+void LoudnessMeter::processBlock(const float* const* data, int numChannels, int numSamples)
+{
+    auto* weightedSamples = weighted.getWritePointer(0);
+    auto* energySamples = energy.getWritePointer(0);
+    juce::FloatVectorOperations::clear(energySamples, numSamples);
+
+    // Left and right (and mono) all carry a channel weight of 1. The filters are recursive so
+    // they run sample by sample, but squaring and summing channels is done a block at a time.
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        juce::FloatVectorOperations::copy(weightedSamples, data[channel], numSamples);
+        filter(shelf[static_cast<size_t>(channel)], weightedSamples, numSamples);
+        filter(highPass[static_cast<size_t>(channel)], weightedSamples, numSamples);
+
+        juce::FloatVectorOperations::multiply(weightedSamples, weightedSamples, numSamples);
+        juce::FloatVectorOperations::add(energySamples, weightedSamples, numSamples);
+    }
+
+    auto* peakSamples = peaks.getWritePointer(0);
+    truePeakDetector.process(data, numChannels, numSamples, peakSamples);
+    truePeak = juce::jmax(truePeak, juce::FloatVectorOperations::findMaximum(peakSamples, numSamples));
+
+    for (int i = 0; i < numSamples;)
+    {
+        auto count = juce::jmin(numSamples - i, subBlockLength - subBlockPosition);
+
+        double sum = 0.0;
+        for (int j = i; j < i + count; ++j)
+            sum += energySamples[j];
+
+        subBlockEnergy += sum;
+        subBlockPosition += count;
+        i += count;
+
+        if (subBlockPosition == subBlockLength)
+        {
+            subBlockEnergies.push_back(subBlockEnergy / subBlockLength);
+            subBlockPosition = 0;
+            subBlockEnergy = 0.0;
+        }
+    }
+}
+
+void LoudnessMeter::filter(Biquad& biquad, float* samples, int numSamples)
+{
+    auto z1 = biquad.z1, z2 = biquad.z2;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        auto x = static_cast<double>(samples[i]);
+        auto y = biquad.b0 * x + z1;
+        z1 = biquad.b1 * x - biquad.a1 * y + z2;
+        z2 = biquad.b2 * x - biquad.a2 * y;
+        samples[i] = static_cast<float>(y);
+    }
+
+    biquad.z1 = z1;
+    biquad.z2 = z2;
+}
+
+double LoudnessMeter::getIntegratedLoudness(const std::vector<double>& subBlockEnergies)
+{
+    // Every 100 ms completes a new 400 ms gating block
+    std::vector<double> blockEnergies;
+
+    for (size_t i = 3; i < subBlockEnergies.size(); ++i)
+        blockEnergies.push_back((subBlockEnergies[i - 3] + subBlockEnergies[i - 2] + subBlockEnergies[i - 1] + subBlockEnergies[i]) * 0.25);
+
+    auto gatedMean = [&blockEnergies](double threshold, int& count)
+    {
+        double sum = 0.0;
+        count = 0;
+
+        for (auto blockEnergy : blockEnergies)
+        {
+            if (blockEnergy > 0.0 && energyToLoudness(blockEnergy) > threshold)
+            {
+                sum += blockEnergy;
+                ++count;
+            }
+        }
+
+        return count > 0 ? sum / count : 0.0;
+    };
+
+    int count = 0;
+    auto absoluteMean = gatedMean(absoluteGate, count);
+
+    if (count == 0)
+        return -std::numeric_limits<double>::infinity();
+
+    auto relativeThreshold = energyToLoudness(absoluteMean) + relativeGate;
+    auto gated = gatedMean(juce::jmax(absoluteGate, relativeThreshold), count);
+
+    return count > 0 ? energyToLoudness(gated) : -std::numeric_limits<double>::infinity();
+}
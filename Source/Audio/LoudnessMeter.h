@@ -0,0 +1,68 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "TruePeakDetector.h"
+
+/**
+ * Integrated loudness as defined by ITU-R BS.1770: K-weighted mean square over 400 ms
+ * blocks with 75% overlap, gated at -70 LUFS absolute and 10 LU below the ungated mean.
+ * Also tracks the true peak. Feed it the programme in order, then ask for the result.
+ *
+ * Measurements are kept as 100 ms sub-block energies, so a programme can be measured in
+ * pieces by several meters and the pieces joined afterwards, provided each piece starts
+ * on a sub-block boundary.
+ */
+class LoudnessMeter
+{
+public:
+    LoudnessMeter();
+    ~LoudnessMeter();
+
+    void prepare(double sampleRate, int numChannels);
+    void reset();
+
+    // Forgets what's been measured but keeps the filters warm, so measuring can start
+    // mid-programme after running some lead-in through
+    void clearMeasurements();
+
+    void process(const float* const* data, int numChannels, int numSamples);
+
+    // LUFS, or -infinity if nothing got past the absolute gate
+    double getIntegratedLoudness() const { return getIntegratedLoudness(subBlockEnergies); }
+    static double getIntegratedLoudness(const std::vector<double>& subBlockEnergies);
+
+    // Linear, so 1.0 is 0 dBTP
+    float getTruePeak() const { return truePeak; }
+
+    int getSubBlockLength() const { return subBlockLength; }
+    const std::vector<double>& getSubBlockEnergies() const { return subBlockEnergies; }
+
+    static constexpr int blockSize = 4096;
+
+private:
+    struct Biquad
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+        double z1 = 0.0, z2 = 0.0;
+    };
+
+    double sampleRate = 44100.0;
+    std::vector<Biquad> shelf, highPass;    // One pair per channel
+
+    juce::AudioBuffer<float> weighted;      // K-weighted block, one channel at a time
+    juce::AudioBuffer<float> energy;        // Summed over channels
+    juce::AudioBuffer<float> peaks;
+
+    int subBlockLength = 4410;              // 100 ms - a gating block is four of these
+    int subBlockPosition = 0;
+    double subBlockEnergy = 0.0;
+    std::vector<double> subBlockEnergies;
+
+    TruePeakDetector truePeakDetector;
+    float truePeak = 0.0f;
+
+    void processBlock(const float* const* data, int numChannels, int numSamples);
+    static void filter(Biquad& biquad, float* samples, int numSamples);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessMeter)
+};
@@ -0,0 +1,119 @@
+#include "MixEngine.h"
+
+MixEngine::MixEngine(juce::AudioFormatReader& backingTrack, juce::AudioFormatReader& vocalTrack, juce::int64 vocalOffsetSamples,
+                     PolyphaseResampler::Quality resamplerQuality)
+    : backing(backingTrack),
+      vocal(vocalTrack),
+      vocalOffset(vocalOffsetSamples),
+      vocalStep(vocalTrack.sampleRate / backingTrack.sampleRate)
+{
+    resampler.prepare(resamplerQuality, vocalStep);
+
+    backingBuffer.setSize(juce::jmax(1, static_cast<int>(backing.numChannels)), blockSize);
+    vocalSource.setSize(juce::jmax(1, static_cast<int>(vocal.numChannels)),
+                        static_cast<int>(std::ceil(blockSize * vocalStep)) + 2 * resampler.getHalfLength() + 2);
+    vocalBuffer.setSize(1, blockSize);
+
+    limiter.prepare(backing.sampleRate, 2, limiterCeiling, true);
+}
+
+MixEngine::~MixEngine()
+{
+}
+
+void MixEngine::read(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples)
+{
+    for (int offset = 0; offset < numSamples; offset += blockSize)
+        renderBlock(buffer, offset, startSample + offset, juce::jmin(blockSize, numSamples - offset), 1.0f);
+}
+
+void MixEngine::readStems(juce::AudioBuffer<float>& buffer, int bufferStart, juce::int64 startSample, int numSamples)
+{
+    for (int offset = 0; offset < numSamples; offset += blockSize)
+    {
+        auto blockLength = juce::jmin(blockSize, numSamples - offset);
+        auto position = startSample + offset;
+
+        backing.read(&backingBuffer, 0, blockLength, position, true, true);
+        readVocal(position, blockLength);
+
+        auto lastBackingChannel = backingBuffer.getNumChannels() - 1;
+        buffer.copyFrom(0, bufferStart + offset, backingBuffer, 0, 0, blockLength);
+        buffer.copyFrom(1, bufferStart + offset, backingBuffer, juce::jmin(1, lastBackingChannel), 0, blockLength);
+        buffer.copyFrom(2, bufferStart + offset, vocalBuffer, 0, 0, blockLength);
+    }
+}
+
+void MixEngine::reset()
+{
+    limiter.reset();
+}
+
+void MixEngine::process(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples)
+{
+    for (int offset = 0; offset < numSamples; offset += blockSize)
+    {
+        auto blockLength = juce::jmin(blockSize, numSamples - offset);
+        renderBlock(buffer, offset, startSample + offset, blockLength, gain);
+        limiter.process(buffer, offset, blockLength);
+    }
+}
+
+void MixEngine::renderBlock(juce::AudioBuffer<float>& output, int outputStart, juce::int64 startSample, int numSamples, float gain)
+{
+    // Reads outside either file come back as silence
+    backing.read(&backingBuffer, 0, numSamples, startSample, true, true);
+    readVocal(startSample, numSamples);
+
+    float* destination[] = { output.getWritePointer(0, outputStart), output.getWritePointer(1, outputStart) };
+    auto* const* backingChannels = backingBuffer.getArrayOfReadPointers();
+    auto* vocalChannel = vocalBuffer.getReadPointer(0);
+
+    if (backingBuffer.getNumChannels() >= 2)
+        mixBlock<2>(destination, backingChannels, vocalChannel, numSamples, gain);
+    else
+        mixBlock<1>(destination, backingChannels, vocalChannel, numSamples, gain);
+}
+
+void MixEngine::readVocal(juce::int64 startSample, int numSamples)
+{
+    auto* destination = vocalBuffer.getWritePointer(0);
+
+    // Same rate: the song position maps straight onto a vocal sample
+    if (vocalStep == 1.0)
+    {
+        vocal.read(&vocalSource, 0, numSamples, startSample - vocalOffset, true, false);
+        juce::FloatVectorOperations::copy(destination, vocalSource.getReadPointer(0), numSamples);
+        return;
+    }
+
+    // Otherwise read the stretch of vocal this block spans, with the filter's reach either side,
+    // and resample. Positions are computed from the block start rather than accumulated, so
+    // consecutive blocks line up exactly.
+    auto halfLength = resampler.getHalfLength();
+    auto firstPosition = static_cast<double>(startSample) * vocalStep - static_cast<double>(vocalOffset);
+    auto sourceStart = static_cast<juce::int64>(std::floor(firstPosition)) - halfLength + 1;
+    auto lastPosition = firstPosition + (numSamples - 1) * vocalStep;
+    auto sourceLength = static_cast<int>(static_cast<juce::int64>(std::floor(lastPosition)) + halfLength + 1 - sourceStart);
+
+    vocal.read(&vocalSource, 0, sourceLength, sourceStart, true, false);
+    resampler.process(vocalSource.getReadPointer(0), firstPosition - static_cast<double>(sourceStart), destination, numSamples);
+}
+
+template <int NumBackingChannels>
+void MixEngine::mixBlock(float* const* output, const float* const* backingChannels, const float* vocalChannel,
+                         int numSamples, float gain)
+{
+    // amix with two inputs scales each of them by a half
+    auto scale = 0.5f * gain;
+
+    for (int channel = 0; channel < NumBackingChannels; ++channel)
+    {
+        juce::FloatVectorOperations::copyWithMultiply(output[channel], backingChannels[channel], scale, numSamples);
+        juce::FloatVectorOperations::addWithMultiply(output[channel], vocalChannel, scale, numSamples);
+    }
+
+    // A mono backing track goes to both sides, like the vocal
+    if constexpr (NumBackingChannels == 1)
+        juce::FloatVectorOperations::copy(output[1], output[0], numSamples);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PeakLimiter.h"
+#include "LoudnessAnalyser.h"
+#include "PolyphaseResampler.h"
+#include "ChunkedRenderer.h"
+
+/**
+ * Mixes a mono vocal take over the backing track in-process. Both files are streamed in
+ * fixed-size blocks through buffers that are allocated once, the vocal is placed on the
+ * song timeline and resampled to the backing track's rate on the fly. As a ChunkedRenderer
+ * processor it produces the finished mix; the level math matches the ffmpeg chain it replaced:
+ * each input at half level (as amix does for two inputs), a fixed gain, then a true-peak
+ * limiter at loudnorm's -1.5 dBTP.
+ */
+class MixEngine : public LoudnessAnalyser::Source,
+                  public ChunkedRenderer::Processor
+{
+public:
+    // vocalOffsetSamples is the song position of the vocal's first sample, in vocal samples
+    MixEngine(juce::AudioFormatReader& backingTrack, juce::AudioFormatReader& vocal, juce::int64 vocalOffsetSamples,
+              PolyphaseResampler::Quality resamplerQuality = PolyphaseResampler::Quality::High);
+    ~MixEngine() override;
+
+    double getSampleRate() const { return backing.sampleRate; }
+    juce::int64 getLengthInSamples() const { return backing.lengthInSamples; }
+
+    // The stereo mix before gain and limiting, for measuring it
+    void read(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples) override;
+
+    // The two inputs kept apart for mixing elsewhere: backing track left and right in channels
+    // 0 and 1, the placed and resampled vocal in channel 2. Unscaled.
+    void readStems(juce::AudioBuffer<float>& buffer, int bufferStart, juce::int64 startSample, int numSamples);
+
+    void setVocalOffset(juce::int64 vocalOffsetSamples) { vocalOffset = vocalOffsetSamples; }
+
+    // Gain applied ahead of the limiter in the finished mix
+    void setGainDb(double gainDb) { gain = juce::Decibels::decibelsToGain(static_cast<float>(gainDb)); }
+
+    // The finished stereo mix, gained and limited
+    void reset() override;
+    void process(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples) override;
+    int getLatencySamples() const override { return limiter.getLatencySamples(); }
+
+    static constexpr int blockSize = 8192;
+    static constexpr float limiterCeiling = 0.84f;  // -1.5 dBFS
+
+private:
+    juce::AudioFormatReader& backing;
+    juce::AudioFormatReader& vocal;
+    juce::int64 vocalOffset;
+    double vocalStep;   // Vocal samples per backing track sample
+    float gain = 1.0f;
+
+    juce::AudioBuffer<float> backingBuffer;
+    juce::AudioBuffer<float> vocalSource;   // Raw vocal samples feeding the resampler
+    juce::AudioBuffer<float> vocalBuffer;   // Vocal at the backing track's rate
+
+    PolyphaseResampler resampler;
+    PeakLimiter limiter;
+
+    // Writes the song from startSample at the given linear gain. At most blockSize samples.
+    void renderBlock(juce::AudioBuffer<float>& output, int outputStart, juce::int64 startSample, int numSamples, float gain);
+    void readVocal(juce::int64 startSample, int numSamples);
+
+    template <int NumBackingChannels>
+    static void mixBlock(float* const* output, const float* const* backingChannels, const float* vocalChannel,
+                         int numSamples, float gain);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MixEngine)
+};
@@ -0,0 +1,149 @@
+#include "MixRenderCache.h"
+
+MixRenderCache::MixRenderCache(const juce::File& cacheDirectory, double rate, double segmentSeconds)
+    : directory(cacheDirectory),
+      sampleRate(rate),
+      segmentSamples(juce::jmax<juce::int64>(1, static_cast<juce::int64>(segmentSeconds * rate)))
+{
+}
+
+MixRenderCache::~MixRenderCache()
+{
+}
+
+void MixRenderCache::load(const juce::String& backingTrackId)
+{
+    backingTrack = backingTrackId;
+    gainMeasured = false;
+    gainDb = 0.0;
+    renderedHashes.clear();
+
+    directory.createDirectory();
+
+    auto manifest = juce::parseXML(getManifestFile());
+
+    if (manifest == nullptr || !manifest->hasTagName("MIXCACHE"))
+        return;
+
+    // A different backing track or segment grid makes every cached segment useless
+    if (manifest->getStringAttribute("backingTrack") != backingTrack
+        || manifest->getDoubleAttribute("sampleRate") != sampleRate
+        || manifest->getStringAttribute("segmentSamples").getLargeIntValue() != segmentSamples)
+        return;
+
+    if (manifest->hasAttribute("gainDb"))
+    {
+        gainDb = manifest->getDoubleAttribute("gainDb");
+        gainMeasured = true;
+    }
+
+    for (auto* segment : manifest->getChildWithTagNameIterator("SEGMENT"))
+        renderedHashes.set(segment->getStringAttribute("index"), segment->getStringAttribute("hash"));
+}
+
+void MixRenderCache::save()
+{
+    juce::XmlElement manifest("MIXCACHE");
+    manifest.setAttribute("backingTrack", backingTrack);
+    manifest.setAttribute("sampleRate", sampleRate);
+    manifest.setAttribute("segmentSamples", juce::String(segmentSamples));
+
+    if (gainMeasured)
+        manifest.setAttribute("gainDb", gainDb);
+
+    for (auto& index : renderedHashes.getAllKeys())
+    {
+        auto* segment = manifest.createNewChildElement("SEGMENT");
+        segment->setAttribute("index", index);
+        segment->setAttribute("hash", renderedHashes[index]);
+    }
+
+    if (!manifest.writeTo(getManifestFile()))
+        juce::Logger::writeToLog("Failed to write mix cache manifest in " + directory.getFullPathName());
+}
+
+void MixRenderCache::setGainDb(double newGainDb)
+{
+    // Every segment was rendered at the old gain
+    if (!gainMeasured || newGainDb != gainDb)
+        renderedHashes.clear();
+
+    gainDb = newGainDb;
+    gainMeasured = true;
+}
+
+juce::Array<MixRenderCache::Segment> MixRenderCache::plan(juce::int64 lengthInSamples,
+                                                          const std::function<juce::String(juce::int64, juce::int64)>& hashSegment) const
+{
+    juce::Array<Segment> segments;
+
+    for (juce::int64 start = 0; start < lengthInSamples; start += segmentSamples)
+    {
+        Segment segment;
+        segment.index = segments.size();
+        segment.startSample = start;
+        segment.numSamples = juce::jmin(segmentSamples, lengthInSamples - start);
+        segment.hash = hashSegment(segment.startSample, segment.numSamples);
+        segment.file = directory.getChildFile("segment_" + juce::String(segment.index).paddedLeft('0', 4) + ".wav");
+        segments.add(segment);
+    }
+
+    return segments;
+}
+
+bool MixRenderCache::isUpToDate(const Segment& segment) const
+{
+    auto key = juce::String(segment.index);
+    return segment.file.existsAsFile() && renderedHashes.containsKey(key) && renderedHashes[key] == segment.hash;
+}
+
+void MixRenderCache::markRendered(const Segment& segment)
+{
+    renderedHashes.set(juce::String(segment.index), segment.hash);
+}
+
+bool MixRenderCache::assemble(const juce::Array<Segment>& segments, const juce::File& outputFile, int bitsPerSample) const
+{
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+
+    const int blockSize = 65536;
+    juce::AudioBuffer<float> buffer;
+
+    for (auto& segment : segments)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(wavFormat.createReaderFor(new juce::FileInputStream(segment.file), true));
+
+        if (reader == nullptr)
+            return false;
+
+        if (writer == nullptr)
+        {
+            outputFile.deleteFile();
+            std::unique_ptr<juce::FileOutputStream> stream(outputFile.createOutputStream());
+
+            if (stream == nullptr)
+                return false;
+
+            writer.reset(wavFormat.createWriterFor(stream.get(), sampleRate, reader->numChannels, bitsPerSample, {}, 0));
+
+            if (writer == nullptr)
+                return false;
+
+            stream.release();
+            buffer.setSize(static_cast<int>(reader->numChannels), blockSize);
+        }
+
+        // Segments are cut to the grid exactly, so the output is just one after another
+        for (juce::int64 position = 0; position < segment.numSamples; position += blockSize)
+        {
+            auto numSamples = static_cast<int>(juce::jmin<juce::int64>(blockSize, segment.numSamples - position));
+            reader->read(&buffer, 0, numSamples, position, true, true);
+
+            if (!writer->writeFromAudioSampleBuffer(buffer, 0, numSamples))
+                return false;
+        }
+    }
+
+    return writer != nullptr;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Keeps the last vocal mix as fixed-length lossless segments on the song timeline, so after
+ * a punch-in only the segments whose inputs changed have to be rendered again. Each segment
+ * is keyed by a hash of everything that goes into it. The loudness gain is measured once per
+ * backing track and then held fixed, so untouched segments stay identical to a full render.
+ */
+class MixRenderCache
+{
+public:
+    struct Segment
+    {
+        int index = 0;
+        juce::int64 startSample = 0;
+        juce::int64 numSamples = 0;
+        juce::String hash;
+        juce::File file;
+    };
+
+    MixRenderCache(const juce::File& cacheDirectory, double sampleRate, double segmentSeconds = 10.0);
+    ~MixRenderCache();
+
+    // Reads the manifest. Everything cached for a different backing track or rate is dropped.
+    void load(const juce::String& backingTrackId);
+    void save();
+
+    bool hasGain() const { return gainMeasured; }
+    double getGainDb() const { return gainDb; }
+    void setGainDb(double newGainDb);
+
+    // Splits the song into segments, asking the caller for the content hash of each
+    juce::Array<Segment> plan(juce::int64 lengthInSamples,
+                              const std::function<juce::String(juce::int64 startSample, juce::int64 numSamples)>& hashSegment) const;
+
+    bool isUpToDate(const Segment& segment) const;
+    void markRendered(const Segment& segment);
+
+    // Concatenates the segments into one file
+    bool assemble(const juce::Array<Segment>& segments, const juce::File& outputFile, int bitsPerSample = 24) const;
+
+private:
+    juce::File directory;
+    double sampleRate;
+    juce::int64 segmentSamples;
+
+    juce::String backingTrack;
+    bool gainMeasured = false;
+    double gainDb = 0.0;
+    juce::StringPairArray renderedHashes;   // Segment index -> hash of what's on disk
+
+    juce::File getManifestFile() const { return directory.getChildFile("cache.xml"); }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MixRenderCache)
+};
@@ -0,0 +1,145 @@
+#include "PeakLimiter.h"
+
+PeakLimiter::PeakLimiter()
+{
+}
+
+PeakLimiter::~PeakLimiter()
+{
+}
+
+void PeakLimiter::prepare(double sampleRate, int numChannels, float newCeiling, bool detectTruePeaks,
+                          double lookaheadMs, double releaseMs)
+{
+    ceiling = newCeiling;
+    lookahead = juce::jmax(1, juce::roundToInt(sampleRate * lookaheadMs / 1000.0));
+    releaseCoefficient = std::exp(-1.0 / (sampleRate * releaseMs / 1000.0));
+
+    // The detector reports each peak a few samples late, so hold the audio back that much more
+    truePeakMode = detectTruePeaks;
+    delayLength = lookahead + (truePeakMode ? TruePeakDetector::latency : 0);
+    truePeakDetector.prepare(numChannels, detectionBlockSize);
+    peaks.setSize(1, detectionBlockSize);
+
+    // The window spans the sample leaving the delay line and the lookahead samples behind it
+    auto windowLength = static_cast<size_t>(lookahead + 1);
+
+    delayLine.setSize(numChannels, delayLength);
+    required.assign(windowLength, 1.0f);
+    minimumQueue.assign(windowLength + 1, 0);
+    minimumHistory.assign(windowLength, 1.0f);
+
+    reset();
+}
+
+void PeakLimiter::reset()
+{
+    delayLine.clear();
+    delayPosition = 0;
+    truePeakDetector.reset();
+
+    std::fill(required.begin(), required.end(), 1.0f);
+    queueHead = queueSize = 0;
+    samplesSeen = 0;
+
+    std::fill(minimumHistory.begin(), minimumHistory.end(), 1.0f);
+    minimumSum = static_cast<double>(minimumHistory.size());
+
+    currentGain = 1.0f;
+}
+
+void PeakLimiter::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    auto numChannels = juce::jmin(buffer.getNumChannels(), delayLine.getNumChannels());
+    auto windowLength = static_cast<int>(required.size());
+    auto queueCapacity = static_cast<int>(minimumQueue.size());
+
+    auto* const* channels = buffer.getArrayOfWritePointers();
+    auto* const* delayed = delayLine.getArrayOfWritePointers();
+    auto* blockPeaks = peaks.getReadPointer(0);
+
+    for (int blockStart = startSample; blockStart < startSample + numSamples; blockStart += detectionBlockSize)
+    {
+        auto blockLength = juce::jmin(detectionBlockSize, startSample + numSamples - blockStart);
+        detectPeaks(buffer, blockStart, blockLength, numChannels);
+
+        for (int i = blockStart; i < blockStart + blockLength; ++i)
+        {
+            auto peak = blockPeaks[i - blockStart];
+            auto needed = peak > ceiling ? ceiling / peak : 1.0f;
+            auto slot = static_cast<int>(samplesSeen % windowLength);
+            required[static_cast<size_t>(slot)] = needed;
+
+            // Running minimum over the window: drop anything the new sample makes irrelevant,
+            // then whatever has slid out of the back of the window
+            while (queueSize > 0)
+            {
+                auto back = minimumQueue[static_cast<size_t>((queueHead + queueSize - 1) % queueCapacity)];
+
+                if (required[static_cast<size_t>(back % windowLength)] < needed)
+                    break;
+
+                --queueSize;
+            }
+
+            minimumQueue[static_cast<size_t>((queueHead + queueSize) % queueCapacity)] = samplesSeen;
+            ++queueSize;
+
+            while (minimumQueue[static_cast<size_t>(queueHead)] <= samplesSeen - windowLength)
+            {
+                queueHead = (queueHead + 1) % queueCapacity;
+                --queueSize;
+            }
+
+            auto windowMinimum = required[static_cast<size_t>(minimumQueue[static_cast<size_t>(queueHead)] % windowLength)];
+
+            // Averaging the last window's worth of minima ramps the gain down in a straight line.
+            // Each of them already covers the sample about to leave the delay line, so the average does too.
+            minimumSum += windowMinimum - minimumHistory[static_cast<size_t>(slot)];
+            minimumHistory[static_cast<size_t>(slot)] = windowMinimum;
+            auto target = static_cast<float>(juce::jmin(1.0, minimumSum / windowLength));
+
+            if (target < currentGain)
+                currentGain = target;
+            else
+                currentGain = target + static_cast<float>(releaseCoefficient) * (currentGain - target);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto input = channels[channel][i];
+                channels[channel][i] = delayed[channel][delayPosition] * currentGain;
+                delayed[channel][delayPosition] = input;
+            }
+
+            delayPosition = (delayPosition + 1) % delayLength;
+            ++samplesSeen;
+        }
+    }
+}
+
+void PeakLimiter::detectPeaks(juce::AudioBuffer<float>& buffer, int startSample, int numSamples, int numChannels)
+{
+    auto* blockPeaks = peaks.getWritePointer(0);
+
+    if (truePeakMode)
+    {
+        const float* channelData[8] {};
+        numChannels = juce::jmin(numChannels, static_cast<int>(std::size(channelData)));
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            channelData[channel] = buffer.getReadPointer(channel, startSample);
+
+        truePeakDetector.process(channelData, numChannels, numSamples, blockPeaks);
+        return;
+    }
+
+    juce::FloatVectorOperations::clear(blockPeaks, numSamples);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* samples = buffer.getReadPointer(channel, startSample);
+
+        for (int i = 0; i < numSamples; ++i)
+            blockPeaks[i] = juce::jmax(blockPeaks[i], std::abs(samples[i]));
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "TruePeakDetector.h"
+
+/**
+ * Lookahead peak limiter. The audio is delayed by the lookahead time so the gain can be
+ * brought down before a peak arrives rather than after it. The gain curve is the minimum
+ * required gain over the lookahead window, box-smoothed over the same length, which keeps
+ * every output sample at or under the ceiling without any hard gain steps.
+ *
+ * With true-peak detection the ceiling applies to the 4x oversampled signal instead, so
+ * the output also stays under it once converted to analogue or lossy-encoded. The audio is
+ * then delayed a little further to give the detector's interpolation filter time.
+ */
+class PeakLimiter
+{
+public:
+    PeakLimiter();
+    ~PeakLimiter();
+
+    static constexpr double defaultReleaseMs = 80.0;
+
+    void prepare(double sampleRate, int numChannels, float ceiling, bool detectTruePeaks = false,
+                 double lookaheadMs = 5.0, double releaseMs = defaultReleaseMs);
+    void reset();
+
+    // Output lags input by this many samples
+    int getLatencySamples() const { return delayLength; }
+
+    // In place, up to the number of channels it was prepared for
+    void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+private:
+    float ceiling = 1.0f;
+    int lookahead = 1;
+    double releaseCoefficient = 0.0;
+
+    bool truePeakMode = false;
+    TruePeakDetector truePeakDetector;
+    juce::AudioBuffer<float> peaks;     // Detected peak per input sample for the current block
+
+    juce::AudioBuffer<float> delayLine;
+    int delayLength = 1;
+    int delayPosition = 0;
+
+    // Required gain for the samples currently in the lookahead window, and a monotonic
+    // queue of sample indices giving its running minimum
+    std::vector<float> required;
+    std::vector<juce::int64> minimumQueue;
+    int queueHead = 0, queueSize = 0;
+    juce::int64 samplesSeen = 0;
+
+    // Running mean of the last lookahead minima
+    std::vector<float> minimumHistory;
+    double minimumSum = 0.0;
+
+    float currentGain = 1.0f;
+
+    static constexpr int detectionBlockSize = 1024;
+
+    void detectPeaks(juce::AudioBuffer<float>& buffer, int startSample, int numSamples, int numChannels);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PeakLimiter)
+};
@@ -0,0 +1,134 @@
+#include "PolyphaseResampler.h"
+
+namespace
+{
+    constexpr int laneWidth = 8;
+
+    struct QualitySettings
+    {
+        int numTaps;
+        double kaiserBeta;
+        double passband;    // Fraction of the lower Nyquist frequency kept flat
+    };
+
+    QualitySettings getSettings(PolyphaseResampler::Quality quality)
+    {
+        switch (quality)
+        {
+            case PolyphaseResampler::Quality::Fast:     return { 16, 5.0, 0.85 };
+            case PolyphaseResampler::Quality::High:     return { 64, 9.0, 0.95 };
+            case PolyphaseResampler::Quality::Standard:
+            default:                                    return { 32, 7.0, 0.91 };
+        }
+    }
+
+    // Zeroth-order modified Bessel function, for the Kaiser window
+    double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int k = 1; k < 50 && term > 1.0e-12 * sum; ++k)
+        {
+            auto half = x / (2.0 * k);
+            term *= half * half;
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    // Two phases against the same input at once, so each input sample is loaded once
+    inline void dotTwo(const float* a, const float* b, const float* x, int numTaps, float& resultA, float& resultB)
+    {
+        float accumulatorA[laneWidth] {}, accumulatorB[laneWidth] {};
+
+        for (int tap = 0; tap < numTaps; tap += laneWidth)
+        {
+            for (int lane = 0; lane < laneWidth; ++lane)
+            {
+                accumulatorA[lane] += a[tap + lane] * x[tap + lane];
+                accumulatorB[lane] += b[tap + lane] * x[tap + lane];
+            }
+        }
+
+        resultA = resultB = 0.0f;
+
+        for (int lane = 0; lane < laneWidth; ++lane)
+        {
+            resultA += accumulatorA[lane];
+            resultB += accumulatorB[lane];
+        }
+    }
+}
+
+PolyphaseResampler::PolyphaseResampler()
+{
+    prepare(quality, step);
+}
+
+PolyphaseResampler::~PolyphaseResampler()
+{
+}
+
+void PolyphaseResampler::prepare(Quality newQuality, double newStep)
+{
+    quality = newQuality;
+    step = newStep;
+
+    auto settings = getSettings(quality);
+    numTaps = settings.numTaps;
+
+    // Cutoff in cycles per input sample: below the output's Nyquist when going down in rate
+    auto cutoff = 0.5 * settings.passband * juce::jmin(1.0, 1.0 / step);
+    auto halfLength = numTaps / 2;
+    auto windowNormaliser = besselI0(settings.kaiserBeta);
+
+    coefficients.assign(static_cast<size_t>((numPhases + 1) * numTaps), 0.0f);
+
+    for (int phase = 0; phase <= numPhases; ++phase)
+    {
+        auto fraction = static_cast<double>(phase) / numPhases;
+        auto* row = coefficients.data() + phase * numTaps;
+        double sum = 0.0;
+
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            // Distance from the read position to the input sample this tap lands on
+            auto t = static_cast<double>(tap - halfLength + 1) - fraction;
+            auto x = 2.0 * cutoff * t;
+            auto sinc = std::abs(x) < 1.0e-9 ? 1.0 : std::sin(juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+            auto r = t / halfLength;
+            auto window = std::abs(r) <= 1.0 ? besselI0(settings.kaiserBeta * std::sqrt(1.0 - r * r)) / windowNormaliser : 0.0;
+
+            auto value = 2.0 * cutoff * sinc * window;
+            row[tap] = static_cast<float>(value);
+            sum += value;
+        }
+
+        // Unity gain at DC for every phase, or the phase table itself becomes a source of ripple
+        if (sum != 0.0)
+            for (int tap = 0; tap < numTaps; ++tap)
+                row[tap] = static_cast<float>(row[tap] / sum);
+    }
+}
+
+void PolyphaseResampler::process(const float* input, double firstPosition, float* output, int numOutputs) const
+{
+    auto halfLength = numTaps / 2;
+
+    for (int i = 0; i < numOutputs; ++i)
+    {
+        // Computed from the start every time rather than accumulated, so long runs don't drift
+        auto position = firstPosition + i * step;
+        auto index = static_cast<juce::int64>(std::floor(position));
+        auto phasePosition = (position - static_cast<double>(index)) * numPhases;
+        auto phase = juce::jmin(numPhases - 1, static_cast<int>(phasePosition));
+        auto blend = static_cast<float>(phasePosition - phase);
+
+        float a, b;
+        dotTwo(coefficients.data() + phase * numTaps, coefficients.data() + (phase + 1) * numTaps,
+               input + index - halfLength + 1, numTaps, a, b);
+
+        output[i] = a + blend * (b - a);
+    }
+}
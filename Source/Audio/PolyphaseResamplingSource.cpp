@@ -0,0 +1,136 @@
+#include "PolyphaseResamplingSource.h"
+
+PolyphaseResamplingSource::PolyphaseResamplingSource(juce::PositionableAudioSource* inputSource, double inputSampleRate,
+                                                     int channels, PolyphaseResampler::Quality resamplerQuality)
+    : input(inputSource),
+      inputRate(inputSampleRate),
+      numChannels(channels),
+      quality(resamplerQuality)
+{
+    jassert(input != nullptr);
+}
+
+PolyphaseResamplingSource::~PolyphaseResamplingSource()
+{
+}
+
+void PolyphaseResamplingSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    step = sampleRate > 0.0 ? inputRate / sampleRate : 1.0;
+    resampler.prepare(quality, step);
+
+    maxOutputBlock = juce::jmax(512, samplesPerBlockExpected);
+    auto maxInputBlock = static_cast<int>(std::ceil(maxOutputBlock * step)) + 1;
+
+    history.setSize(numChannels, maxInputBlock + 2 * resampler.getHalfLength() + 1);
+    input->prepareToPlay(maxInputBlock, inputRate);
+
+    restartPending = true;
+}
+
+void PolyphaseResamplingSource::releaseResources()
+{
+    input->releaseResources();
+    history.setSize(numChannels, 0);
+}
+
+void PolyphaseResamplingSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    // Seeks are picked up here, on the thread that owns the history
+    if (restartPending.exchange(false))
+        restartAt(position);
+
+    // Same rate: nothing to do but pass the input through
+    if (step == 1.0)
+    {
+        input->getNextAudioBlock(bufferToFill);
+        position += bufferToFill.numSamples;
+        return;
+    }
+
+    for (int offset = 0; offset < bufferToFill.numSamples; offset += maxOutputBlock)
+        renderChunk(*bufferToFill.buffer, bufferToFill.startSample + offset,
+                    juce::jmin(maxOutputBlock, bufferToFill.numSamples - offset));
+}
+
+void PolyphaseResamplingSource::renderChunk(juce::AudioBuffer<float>& output, int outputStart, int numSamples)
+{
+    auto halfLength = resampler.getHalfLength();
+    auto firstPosition = static_cast<double>(position.load()) * step;
+    auto lastPosition = firstPosition + (numSamples - 1) * step;
+    auto keepFrom = static_cast<juce::int64>(std::floor(firstPosition)) - halfLength + 1;
+    auto needUntil = static_cast<juce::int64>(std::floor(lastPosition)) + halfLength + 1;
+
+    // Playback only ever moves forwards, so anything else means the input has to be reopened
+    if (keepFrom < historyStart || keepFrom > historyStart + historyLength)
+        restartAt(position);
+
+    // Drop what the filter has moved past
+    if (auto drop = static_cast<int>(keepFrom - historyStart); drop > 0)
+    {
+        historyLength -= drop;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = history.getWritePointer(channel);
+            std::memmove(data, data + drop, static_cast<size_t>(historyLength) * sizeof(float));
+        }
+
+        historyStart = keepFrom;
+    }
+
+    // Then top up with what this chunk reaches
+    if (auto toRead = static_cast<int>(needUntil - (historyStart + historyLength)); toRead > 0)
+    {
+        input->getNextAudioBlock(juce::AudioSourceChannelInfo(&history, historyLength, toRead));
+        historyLength += toRead;
+    }
+
+    auto channelsToWrite = juce::jmin(numChannels, output.getNumChannels());
+
+    for (int channel = 0; channel < channelsToWrite; ++channel)
+        resampler.process(history.getReadPointer(channel), firstPosition - static_cast<double>(historyStart),
+                          output.getWritePointer(channel, outputStart), numSamples);
+
+    for (int channel = channelsToWrite; channel < output.getNumChannels(); ++channel)
+        output.clear(channel, outputStart, numSamples);
+
+    position += numSamples;
+}
+
+void PolyphaseResamplingSource::restartAt(juce::int64 outputPosition)
+{
+    if (step == 1.0)
+    {
+        input->setNextReadPosition(outputPosition);
+        return;
+    }
+
+    historyStart = static_cast<juce::int64>(std::floor(static_cast<double>(outputPosition) * step)) - resampler.getHalfLength() + 1;
+    historyLength = 0;
+
+    // The filter reaches back before the start of the input there - pad that with silence
+    if (historyStart < 0)
+    {
+        historyLength = static_cast<int>(-historyStart);
+        history.clear(0, historyLength);
+    }
+
+    input->setNextReadPosition(historyStart + historyLength);
+}
+
+void PolyphaseResamplingSource::setNextReadPosition(juce::int64 newPosition)
+{
+    position = newPosition;
+    restartPending = true;
+}
+
+juce::int64 PolyphaseResamplingSource::getNextReadPosition() const
+{
+    return position;
+}
+
+juce::int64 PolyphaseResamplingSource::getTotalLength() const
+{
+    return static_cast<juce::int64>(static_cast<double>(input->getTotalLength()) / step);
+}
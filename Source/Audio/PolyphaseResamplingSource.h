@@ -0,0 +1,54 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PolyphaseResampler.h"
+
+/**
+ * Plays a PositionableAudioSource at the device rate through the polyphase resampler, in
+ * place of the transport's own interpolator. Give the transport a source rate of zero so it
+ * doesn't resample a second time; positions and length are then in device samples.
+ *
+ * Nothing is allocated after prepareToPlay, so it can run on the audio thread as well as
+ * behind a BufferingAudioSource. Blocks larger than the prepared size are split up.
+ */
+class PolyphaseResamplingSource : public juce::PositionableAudioSource
+{
+public:
+    PolyphaseResamplingSource(juce::PositionableAudioSource* input, double inputSampleRate, int numChannels,
+                              PolyphaseResampler::Quality quality);
+    ~PolyphaseResamplingSource() override;
+
+    // Takes effect from the next prepareToPlay
+    void setQuality(PolyphaseResampler::Quality newQuality) { quality = newQuality; }
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(juce::int64 newPosition) override;
+    juce::int64 getNextReadPosition() const override;
+    juce::int64 getTotalLength() const override;
+    bool isLooping() const override { return false; }
+
+private:
+    juce::PositionableAudioSource* input;
+    double inputRate;
+    int numChannels;
+    PolyphaseResampler::Quality quality;
+    PolyphaseResampler resampler;
+    double step = 1.0;  // Input samples per output sample
+
+    // Input from historyStart onwards, historyLength samples of it
+    juce::AudioBuffer<float> history;
+    juce::int64 historyStart = 0;
+    int historyLength = 0;
+    int maxOutputBlock = 0;
+
+    std::atomic<juce::int64> position { 0 };
+    std::atomic<bool> restartPending { true };
+
+    void renderChunk(juce::AudioBuffer<float>& output, int outputStart, int numSamples);
+    void restartAt(juce::int64 outputPosition);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PolyphaseResamplingSource)
+};
@@ -0,0 +1,67 @@
+#include "ProcessOutputReader.h"
+
+ProcessOutputReader::ProcessOutputReader(juce::ChildProcess& processToRead)
+    : Thread("ProcessOutputReader"),
+      process(processToRead)
+{
+    startThread();
+}
+
+ProcessOutputReader::~ProcessOutputReader()
+{
+    // The read only returns at end of output, which comes as soon as the process exits or is killed
+    stopThread(5000);
+}
+
+juce::StringArray ProcessOutputReader::takeLines()
+{
+    const juce::ScopedLock sl(lock);
+    juce::StringArray lines;
+    lines.swapWith(pendingLines);
+    return lines;
+}
+
+juce::String ProcessOutputReader::getOutput() const
+{
+    const juce::ScopedLock sl(lock);
+    return output.toString();
+}
+
+void ProcessOutputReader::run()
+{
+    juce::MemoryOutputStream line;
+
+    for (;;)
+    {
+        // One byte at a time: the pipe is buffered underneath, and a bigger read would wait to fill
+        char character = 0;
+
+        if (process.readProcessOutput(&character, 1) <= 0)
+            break;
+
+        const juce::ScopedLock sl(lock);
+        output.writeByte(character);
+
+        if (character == '\n' || character == '\r')
+        {
+            auto text = line.toString().trim();
+
+            if (text.isNotEmpty())
+                pendingLines.add(text);
+
+            line.reset();
+        }
+        else
+        {
+            line.writeByte(character);
+        }
+    }
+
+    const juce::ScopedLock sl(lock);
+    auto text = line.toString().trim();
+
+    if (text.isNotEmpty())
+        pendingLines.add(text);
+
+    finished = true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Drains a child process's output on a thread of its own and splits it into lines as they
+ * arrive, so the stage waiting on the process can follow what it prints without blocking on
+ * the pipe. Carriage returns end a line too, which is how curl redraws its progress meter.
+ * The process has to outlive the reader.
+ */
+class ProcessOutputReader : private juce::Thread
+{
+public:
+    explicit ProcessOutputReader(juce::ChildProcess& process);
+    ~ProcessOutputReader() override;
+
+    // Complete lines printed since the last call, blank ones dropped
+    juce::StringArray takeLines();
+
+    // Everything printed so far, for logs and error messages
+    juce::String getOutput() const;
+
+    // True once the process has closed its end of the pipe
+    bool isFinished() const { return finished.load(); }
+
+    // Waits for the process to close its end of the pipe; false on timeout
+    bool waitForEnd(int timeoutMs) { return waitForThreadToExit(timeoutMs); }
+
+private:
+    juce::ChildProcess& process;
+
+    juce::CriticalSection lock;
+    juce::MemoryOutputStream output;
+    juce::StringArray pendingLines;
+    std::atomic<bool> finished { false };
+
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProcessOutputReader)
+};
@@ -0,0 +1,104 @@
+#include "ProcessProgress.h"
+
+namespace
+{
+    // curl's meter columns: % Total, Total, % Received, Received, % Xferd, Xferd,
+    // Dload speed, Upload speed, Time Total, Time Spent, Time Left, Current speed
+    constexpr int curlMeterColumns = 12;
+
+    bool isWholeNumber(const juce::String& text)
+    {
+        return text.isNotEmpty() && text.containsOnly("0123456789");
+    }
+
+    // Sizes like "512", "4700k", "10.2M" - curl counts in powers of 1024
+    juce::int64 parseCurlSize(const juce::String& text)
+    {
+        static const juce::String suffixes("kMGTP");
+        auto multiplier = 1.0;
+        auto exponent = suffixes.indexOfChar(text.getLastCharacter());
+
+        for (int i = 0; i <= exponent; ++i)
+            multiplier *= 1024.0;
+
+        return static_cast<juce::int64>(text.getDoubleValue() * multiplier);
+    }
+}
+
+bool ProcessProgress::CurlTransfer::parseLine(const juce::String& line)
+{
+    juce::StringArray columns;
+    columns.addTokens(line, " ", "");
+    columns.removeEmptyStrings();
+
+    if (columns.size() != curlMeterColumns
+        || !isWholeNumber(columns[0]) || !isWholeNumber(columns[2]) || !isWholeNumber(columns[4]))
+        return false;
+
+    downloadPercent = columns[2].getDoubleValue();
+    bytesReceived = parseCurlSize(columns[3]);
+    uploadPercent = columns[4].getDoubleValue();
+    bytesSent = parseCurlSize(columns[5]);
+    timeLeft = columns[10].contains("-") ? juce::String() : columns[10];
+    return true;
+}
+
+bool ProcessProgress::FFmpeg::parseLine(const juce::String& line)
+{
+    auto key = line.upToFirstOccurrenceOf("=", false, false).trim();
+    auto value = line.fromFirstOccurrenceOf("=", false, false).trim();
+
+    // out_time_ms is microseconds as well, despite the name; older builds only have that one
+    if ((key == "out_time_us" || key == "out_time_ms") && isWholeNumber(value))
+        encodedSeconds = static_cast<double>(value.getLargeIntValue()) / 1.0e6;
+    else if (key == "speed" && value.endsWithChar('x'))
+        speed = value.dropLastCharacters(1).getDoubleValue();
+    else if (key == "progress")
+    {
+        finished = value == "end";
+        return true;
+    }
+
+    return false;
+}
+
+double ProcessProgress::FFmpeg::getFraction() const
+{
+    if (finished)
+        return 1.0;
+
+    return duration > 0.0 ? juce::jlimit(0.0, 1.0, encodedSeconds / duration) : 0.0;
+}
+
+double ProcessProgress::FFmpeg::getSecondsLeft() const
+{
+    if (speed <= 0.0)
+        return 0.0;
+
+    return juce::jmax(0.0, duration - encodedSeconds) / speed;
+}
+
+bool ProcessProgress::JsonLines::parseLine(const juce::String& line)
+{
+    if (!line.startsWithChar('{'))
+        return false;
+
+    auto parsed = juce::JSON::parse(line);
+    auto* object = parsed.getDynamicObject();
+
+    if (object == nullptr || !object->hasProperty("progress"))
+        return false;
+
+    fraction = juce::jlimit(0.0, 1.0, static_cast<double>(object->getProperty("progress")));
+
+    if (object->hasProperty("stage"))
+        stage = object->getProperty("stage").toString();
+
+    return true;
+}
+
+juce::String ProcessProgress::formatDuration(double seconds)
+{
+    auto total = juce::roundToInt(juce::jmax(0.0, seconds));
+    return juce::String(total / 60) + ":" + juce::String(total % 60).paddedLeft('0', 2);
+}
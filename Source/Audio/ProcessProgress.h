@@ -0,0 +1,76 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Parsers for the progress the pipeline's child processes print, fed one line at a time.
+ * Each turns its tool's own counters - bytes moved, seconds encoded, work done - into a
+ * fraction, so the progress bar follows the work rather than the clock.
+ */
+class ProcessProgress
+{
+public:
+    /** curl's default progress meter, redrawn about once a second on stderr. */
+    class CurlTransfer
+    {
+    public:
+        // False for anything that isn't a meter row, such as the verbose log
+        bool parseLine(const juce::String& line);
+
+        double getUploadFraction() const { return uploadPercent / 100.0; }
+        double getDownloadFraction() const { return downloadPercent / 100.0; }
+        juce::int64 getBytesSent() const { return bytesSent; }
+        juce::int64 getBytesReceived() const { return bytesReceived; }
+
+        // As curl prints it, e.g. "0:00:12", or empty while it doesn't know
+        juce::String getTimeLeft() const { return timeLeft; }
+
+    private:
+        double uploadPercent = 0.0;
+        double downloadPercent = 0.0;
+        juce::int64 bytesSent = 0;
+        juce::int64 bytesReceived = 0;
+        juce::String timeLeft;
+    };
+
+    /** The key=value blocks ffmpeg writes with -progress, measured against the input's duration. */
+    class FFmpeg
+    {
+    public:
+        explicit FFmpeg(double durationSeconds) : duration(durationSeconds) {}
+
+        // True at the end of each block, when the counters are consistent
+        bool parseLine(const juce::String& line);
+
+        double getFraction() const;
+        double getSecondsLeft() const;
+        bool isFinished() const { return finished; }
+
+    private:
+        double duration;
+        double encodedSeconds = 0.0;
+        double speed = 0.0;
+        bool finished = false;
+    };
+
+    /** One JSON object per line from our Python scripts: {"progress": 0.4, "stage": "..."}. */
+    class JsonLines
+    {
+    public:
+        // False for anything else the script printed
+        bool parseLine(const juce::String& line);
+
+        double getFraction() const { return fraction; }
+        juce::String getStage() const { return stage; }
+
+    private:
+        double fraction = 0.0;
+        juce::String stage;
+    };
+
+    // "1:05" or "0:07" for status messages
+    static juce::String formatDuration(double seconds);
+
+private:
+    ProcessProgress() = delete;
+};
@@ -0,0 +1,432 @@
+#include "ProcessRunner.h"
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <cerrno>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <signal.h>
+ #include <sys/wait.h>
+ #include <unistd.h>
+ #if JUCE_LINUX
+  #include <sys/syscall.h>
+ #endif
+ #if JUCE_MAC
+  #include <sys/event.h>
+ #endif
+#endif
+
+namespace
+{
+    // Registered for the length of a wait, so a stop request reaches the runner
+    class ExitSignalRegistration
+    {
+    public:
+        ExitSignalRegistration(juce::Thread* threadToWatch, juce::Thread::Listener& listenerToAdd)
+            : thread(threadToWatch), listener(listenerToAdd)
+        {
+            if (thread != nullptr)
+                thread->addListener(&listener);
+        }
+
+        ~ExitSignalRegistration()
+        {
+            if (thread != nullptr)
+                thread->removeListener(&listener);
+        }
+
+    private:
+        juce::Thread* thread;
+        juce::Thread::Listener& listener;
+    };
+
+    bool shouldThreadExit(juce::Thread* thread)
+    {
+        return thread != nullptr && thread->threadShouldExit();
+    }
+
+   #if JUCE_LINUX || JUCE_MAC
+    constexpr int readChunkSize = 4096;
+
+    void closeFd(int& fd)
+    {
+        if (fd >= 0)
+            ::close(fd);
+
+        fd = -1;
+    }
+
+    void setFlags(int fd)
+    {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    // Without something to tell us the process exited, how often to check for it
+    constexpr int exitPollMs = 10;
+
+    // Readable once the process has exited, even while something it started holds the pipe open.
+    // A pidfd on Linux 5.3 and up, a kqueue watching for the exit on macOS.
+    int openExitFd(int processId)
+    {
+       #if JUCE_LINUX && defined (SYS_pidfd_open)
+        return static_cast<int>(::syscall(SYS_pidfd_open, processId, 0));
+       #elif JUCE_MAC
+        auto queue = ::kqueue();
+
+        if (queue < 0)
+            return -1;
+
+        struct kevent change;
+        EV_SET(&change, processId, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+
+        // Fails if it's already gone, which the first waitpid will find anyway
+        if (::kevent(queue, &change, 1, nullptr, 0, nullptr) < 0)
+        {
+            ::close(queue);
+            return -1;
+        }
+
+        ::fcntl(queue, F_SETFD, FD_CLOEXEC);
+        return queue;
+       #else
+        juce::ignoreUnused(processId);
+        return -1;
+       #endif
+    }
+   #else
+    constexpr int fallbackPollMs = 50;
+   #endif
+}
+
+#if JUCE_LINUX || JUCE_MAC
+
+ProcessRunner::ProcessRunner()
+{
+    if (::pipe(wakeFds) == 0)
+    {
+        setFlags(wakeFds[0]);
+        setFlags(wakeFds[1]);
+    }
+}
+
+ProcessRunner::~ProcessRunner()
+{
+    kill();
+    closeFd(outputFd);
+    closeFd(exitFd);
+    closeFd(wakeFds[0]);
+    closeFd(wakeFds[1]);
+}
+
+bool ProcessRunner::start(const juce::StringArray& arguments, bool includeStdErr)
+{
+    jassert(processId == 0);  // One process per runner
+
+    if (arguments.isEmpty() || processId != 0)
+        return false;
+
+    int pipeFds[2];
+
+    if (::pipe(pipeFds) != 0)
+        return false;
+
+    ::fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(pipeFds[1], F_SETFD, FD_CLOEXEC);
+
+    // Built before the fork - the child shouldn't allocate
+    std::vector<std::string> strings;
+    std::vector<char*> argv;
+
+    for (auto& argument : arguments)
+        strings.push_back(argument.toStdString());
+
+    for (auto& string : strings)
+        argv.push_back(string.data());
+
+    argv.push_back(nullptr);
+
+    auto child = ::fork();
+
+    if (child < 0)
+    {
+        ::close(pipeFds[0]);
+        ::close(pipeFds[1]);
+        return false;
+    }
+
+    if (child == 0)
+    {
+        ::setpgid(0, 0);
+        ::dup2(pipeFds[1], STDOUT_FILENO);
+
+        if (includeStdErr)
+        {
+            ::dup2(pipeFds[1], STDERR_FILENO);
+        }
+        else
+        {
+            auto devNull = ::open("/dev/null", O_WRONLY);
+
+            if (devNull >= 0)
+                ::dup2(devNull, STDERR_FILENO);
+        }
+
+        ::execvp(argv[0], argv.data());
+        ::_exit(127);
+    }
+
+    // Set from both sides, so a kill straight after the fork still finds the group
+    ::setpgid(child, child);
+    ::close(pipeFds[1]);
+
+    processId = child;
+    outputFd = pipeFds[0];
+    ::fcntl(outputFd, F_SETFL, ::fcntl(outputFd, F_GETFL) | O_NONBLOCK);
+    exitFd = openExitFd(child);
+    exitCode = -1;
+    return true;
+}
+
+ProcessRunner::Result ProcessRunner::waitForExit(int timeoutMs, const std::function<void(const juce::String&)>& onLine)
+{
+    auto* thread = juce::Thread::getCurrentThread();
+    ExitSignalRegistration registration(thread, *this);
+
+    auto deadline = juce::Time::getMillisecondCounter() + static_cast<juce::uint32>(juce::jmax(0, timeoutMs));
+    auto result = Result::Finished;
+
+    while (processId != 0)
+    {
+        if (shouldThreadExit(thread))
+        {
+            kill();
+            result = Result::Cancelled;
+            break;
+        }
+
+        if (reap(false))
+            break;
+
+        auto waitMs = -1;
+
+        if (timeoutMs >= 0)
+        {
+            auto now = juce::Time::getMillisecondCounter();
+
+            if (now >= deadline)
+            {
+                kill();
+                result = Result::TimedOut;
+                break;
+            }
+
+            waitMs = static_cast<int>(deadline - now);
+        }
+
+        pollfd fds[3];
+        nfds_t numFds = 0;
+        fds[numFds++] = { wakeFds[0], POLLIN, 0 };
+
+        if (outputFd >= 0)
+            fds[numFds++] = { outputFd, POLLIN, 0 };
+
+        if (exitFd >= 0)
+            fds[numFds++] = { exitFd, POLLIN, 0 };
+
+        // Nothing to tell us it exited, and whatever it started may hold its output open long
+        // after it's gone - so check on it every so often rather than waiting on the pipe alone
+        if (exitFd < 0)
+            waitMs = waitMs < 0 ? exitPollMs : juce::jmin(waitMs, exitPollMs);
+
+        if (::poll(fds, numFds, waitMs) < 0 && errno != EINTR)
+        {
+            kill();
+            result = Result::Cancelled;
+            break;
+        }
+
+        char wakeBytes[16];
+        while (::read(wakeFds[0], wakeBytes, sizeof(wakeBytes)) > 0) {}
+
+        readOutput(onLine);
+    }
+
+    // Whatever it printed before exiting is already in the pipe
+    readOutput(onLine);
+    finishLine(onLine);
+    closeFd(outputFd);
+    return result;
+}
+
+void ProcessRunner::kill()
+{
+    if (processId == 0)
+        return;
+
+    ::kill(-processId, SIGKILL);
+    ::kill(processId, SIGKILL);
+    reap(true);
+}
+
+bool ProcessRunner::reap(bool block)
+{
+    int status = 0;
+    auto reaped = ::waitpid(processId, &status, block ? 0 : WNOHANG);
+
+    while (reaped < 0 && errno == EINTR)
+        reaped = ::waitpid(processId, &status, block ? 0 : WNOHANG);
+
+    if (reaped == 0)
+        return false;
+
+    if (reaped == processId)
+        exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    processId = 0;
+    closeFd(exitFd);
+    return true;
+}
+
+void ProcessRunner::readOutput(const std::function<void(const juce::String&)>& onLine)
+{
+    char buffer[readChunkSize];
+
+    while (outputFd >= 0)
+    {
+        auto numRead = ::read(outputFd, buffer, sizeof(buffer));
+
+        if (numRead > 0)
+        {
+            handleOutput(buffer, static_cast<size_t>(numRead), onLine);
+            continue;
+        }
+
+        if (numRead < 0 && errno == EINTR)
+            continue;
+
+        if (numRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        // End of output
+        closeFd(outputFd);
+    }
+}
+
+void ProcessRunner::exitSignalSent()
+{
+    // Called on whichever thread asked ours to stop
+    juce::ignoreUnused(::write(wakeFds[1], "x", 1));
+}
+
+void ProcessRunner::handleOutput(const char* data, size_t numBytes, const std::function<void(const juce::String&)>& onLine)
+{
+    output.write(data, numBytes);
+
+    for (size_t i = 0; i < numBytes; ++i)
+    {
+        // Carriage returns end a line too - that's how curl redraws its meter
+        if (data[i] == '\n' || data[i] == '\r')
+            finishLine(onLine);
+        else
+            partialLine.writeByte(data[i]);
+    }
+}
+
+void ProcessRunner::finishLine(const std::function<void(const juce::String&)>& onLine)
+{
+    auto line = partialLine.toString().trim();
+    partialLine.reset();
+
+    if (line.isNotEmpty() && onLine != nullptr)
+        onLine(line);
+}
+
+#else
+
+ProcessRunner::ProcessRunner()
+{
+}
+
+ProcessRunner::~ProcessRunner()
+{
+    kill();
+}
+
+bool ProcessRunner::start(const juce::StringArray& arguments, bool includeStdErr)
+{
+    process = std::make_unique<juce::ChildProcess>();
+    auto flags = juce::ChildProcess::wantStdOut | (includeStdErr ? juce::ChildProcess::wantStdErr : 0);
+
+    if (!process->start(arguments, flags))
+    {
+        process.reset();
+        return false;
+    }
+
+    reader = std::make_unique<ProcessOutputReader>(*process);
+    exitCode = -1;
+    return true;
+}
+
+ProcessRunner::Result ProcessRunner::waitForExit(int timeoutMs, const std::function<void(const juce::String&)>& onLine)
+{
+    // No pipe or pidfd to sleep on here, so this one polls
+    auto* thread = juce::Thread::getCurrentThread();
+    auto startTime = juce::Time::getMillisecondCounter();
+    auto result = Result::Finished;
+
+    auto deliverLines = [this, &onLine]()
+    {
+        for (auto& line : reader->takeLines())
+            if (onLine != nullptr)
+                onLine(line);
+    };
+
+    if (process == nullptr)
+        return result;
+
+    while (!process->waitForProcessToFinish(fallbackPollMs))
+    {
+        if (shouldThreadExit(thread))
+        {
+            result = Result::Cancelled;
+            break;
+        }
+
+        if (timeoutMs >= 0 && juce::Time::getMillisecondCounter() - startTime >= static_cast<juce::uint32>(timeoutMs))
+        {
+            result = Result::TimedOut;
+            break;
+        }
+
+        deliverLines();
+    }
+
+    if (result == Result::Finished)
+        exitCode = static_cast<int>(process->getExitCode());
+
+    process->kill();
+    reader->waitForEnd(fallbackPollMs * 10);
+    deliverLines();
+    output << reader->getOutput();
+
+    reader.reset();
+    process.reset();
+    return result;
+}
+
+void ProcessRunner::kill()
+{
+    if (process == nullptr)
+        return;
+
+    process->kill();
+    reader.reset();
+    process.reset();
+}
+
+void ProcessRunner::exitSignalSent()
+{
+}
+
+#endif
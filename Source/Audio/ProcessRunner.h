@@ -0,0 +1,67 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ProcessOutputReader.h"
+
+/**
+ * Runs one child process for a pipeline stage and waits for it without polling where it can.
+ * The waiting thread sleeps in poll() on the process's output pipe, a pidfd (Linux) or kqueue
+ * (macOS) that becomes readable when the process exits, and a wake-up pipe that's written
+ * when the thread is asked to stop - so it returns the moment any of those happens. Where
+ * neither a pidfd nor a kqueue can be had, it also checks every few milliseconds whether the
+ * process has exited. Output comes back a line at a time as it's printed. The child gets a
+ * process group of its own, and killing it also kills anything it started.
+ */
+class ProcessRunner : private juce::Thread::Listener
+{
+public:
+    enum class Result
+    {
+        Finished,
+        TimedOut,
+        Cancelled
+    };
+
+    ProcessRunner();
+    ~ProcessRunner() override;
+
+    // stderr is merged into the output unless includeStdErr is false
+    bool start(const juce::StringArray& arguments, bool includeStdErr = true);
+
+    // Blocks until the process exits, calling onLine on this thread for each line it prints.
+    // The process is killed on timeout (-1 for none) or when the calling thread is told to exit.
+    Result waitForExit(int timeoutMs, const std::function<void(const juce::String& line)>& onLine = nullptr);
+
+    void kill();
+
+    // -1 until the process has exited normally
+    int getExitCode() const { return exitCode; }
+
+    // Everything the process printed
+    juce::String getOutput() const { return output.toString(); }
+
+private:
+   #if JUCE_LINUX || JUCE_MAC
+    int processId = 0;
+    int outputFd = -1;
+    int exitFd = -1;
+    int wakeFds[2] = { -1, -1 };
+
+    juce::MemoryOutputStream partialLine;
+
+    bool reap(bool block);
+    void readOutput(const std::function<void(const juce::String&)>& onLine);
+    void handleOutput(const char* data, size_t numBytes, const std::function<void(const juce::String&)>& onLine);
+    void finishLine(const std::function<void(const juce::String&)>& onLine);
+   #else
+    std::unique_ptr<juce::ChildProcess> process;
+    std::unique_ptr<ProcessOutputReader> reader;
+   #endif
+
+    juce::MemoryOutputStream output;
+    int exitCode = -1;
+
+    void exitSignalSent() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProcessRunner)
+};
@@ -1,4 +1,6 @@
 #include "RVCProcessor.h"
+#include "ProcessRunner.h"
+#include "ProcessProgress.h"
 
 RVCProcessor::RVCProcessor(const juce::File& initialInputVocalFile, const juce::File& initialOutputFile, const juce::String& initialModelPath)
     : Thread("RVCProcessor"),
@@ -68,7 +70,7 @@ void RVCProcessor::run()
     
     updateProgress(0.4, "Building RVC command...");
     
-    juce::String command = buildRVCCommand();
+    auto command = buildRVCCommand();
     
     if (threadShouldExit())
         return;
@@ -89,8 +91,6 @@ void RVCProcessor::run()
 
 bool RVCProcessor::checkRVCAvailability()
 {
-    juce::ChildProcess process;
-    
     // Test the virtual environment's Python with basic imports
     juce::File currentDir = juce::File::getSpecialLocation(juce::File::currentExecutableFile).getParentDirectory();
     juce::File venvPython = currentDir.getChildFile("../demucs_env/bin/python3");
@@ -106,18 +106,20 @@ bool RVCProcessor::checkRVCAvailability()
         return false;
     }
     
-    juce::String testCommand = venvPython.getFullPathName() + " -c \"import torch; import librosa; import soundfile; print('RVC dependencies available')\"";;
+    juce::StringArray testArgs;
+    testArgs.add(venvPython.getFullPathName());
+    testArgs.add("-c");
+    testArgs.add("import torch; import librosa; import soundfile; print('RVC dependencies available')");
     
-    if (process.start(testCommand))
-    {
-        process.waitForProcessToFinish(10000);
-        return process.getExitCode() == 0;
-    }
+    ProcessRunner process;
+    
+    if (process.start(testArgs))
+        return process.waitForExit(10000) == ProcessRunner::Result::Finished && process.getExitCode() == 0;
     
     return false;
 }
 
-juce::String RVCProcessor::buildRVCCommand()
+juce::StringArray RVCProcessor::buildRVCCommand()
 {
     // Find the virtual environment relative to the executable or working directory
     juce::File currentDir = juce::File::getSpecialLocation(juce::File::currentExecutableFile).getParentDirectory();
@@ -153,18 +155,18 @@ juce::String RVCProcessor::buildRVCCommand()
     args.add("--quality");
     args.add(juce::String(quality));
     
-    return args.joinIntoString(" ");
+    return args;
 }
 
-bool RVCProcessor::executeRVCCommand(const juce::String& command)
+bool RVCProcessor::executeRVCCommand(const juce::StringArray& command)
 {
-    juce::ChildProcess process;
+    ProcessRunner process;
     
     updateProgress(0.6, "Starting RVC inference...");
     
     // Write the command to a debug file
-    juce::File debugFile("/tmp/rvc_command.txt");
-    debugFile.replaceWithText(command);
+    juce::File debugFile(juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("rvc_command.txt"));
+    debugFile.replaceWithText(command.joinIntoString(" "));
     
     if (!process.start(command))
     {
@@ -174,53 +176,26 @@ bool RVCProcessor::executeRVCCommand(const juce::String& command)
         return false;
     }
     
-    juce::String processOutput;
-    
-    // Monitor the process with progress updates
-    int timeoutMs = 180000; // 3 minutes timeout for voice conversion
-    int elapsedMs = 0;
-    int checkIntervalMs = 2000;
+    // The script prints a JSON line as it reaches each stage
+    ProcessProgress::JsonLines progress;
+    juce::File outputDebugFile(juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("rvc_process_output.txt"));
     
-    while (process.isRunning() && elapsedMs < timeoutMs)
+    auto onLine = [&](const juce::String& line)
     {
-        if (threadShouldExit())
-        {
-            process.kill();
-            return false;
-        }
-        
-        // Try to read any available output
-        auto currentOutput = process.readAllProcessOutput();
-        if (currentOutput.isNotEmpty())
-        {
-            processOutput += currentOutput;
-            juce::File outputDebugFile("/tmp/rvc_process_output.txt");
-            outputDebugFile.replaceWithText(processOutput);
-            
-            // Look for progress indicators
-            if (currentOutput.contains("Processing") || currentOutput.contains("%"))
-            {
-                updateProgress(0.6 + (0.3 * static_cast<double>(elapsedMs) / timeoutMs), 
-                             "RVC: " + currentOutput.substring(0, 80) + "...");
-            }
-        }
+        outputDebugFile.appendText(line + "\n");
         
-        // Update progress based on elapsed time
-        double progress = 0.6 + (0.3 * static_cast<double>(elapsedMs) / timeoutMs);
-        
-        if (elapsedMs % 10000 == 0) // Every 10 seconds
-        {
-            updateProgress(juce::jmin(progress, 0.9), 
-                         "Converting voice... (" + juce::String(elapsedMs / 1000) + "s elapsed)");
-        }
-        
-        juce::Thread::sleep(checkIntervalMs);
-        elapsedMs += checkIntervalMs;
-    }
+        if (progress.parseLine(line))
+            updateProgress(0.6 + 0.3 * progress.getFraction(), "RVC: " + progress.getStage());
+    };
+    
+    outputDebugFile.deleteFile();
+    auto result = process.waitForExit(180000, onLine); // 3 minutes timeout for voice conversion
     
-    if (process.isRunning())
+    if (result == ProcessRunner::Result::Cancelled)
+        return false;
+    
+    if (result == ProcessRunner::Result::TimedOut)
     {
-        process.kill();
         updateProgress(0.9, "RVC process timed out");
         if (onProcessingComplete)
             onProcessingComplete(false, "Voice conversion process timed out");
@@ -228,19 +203,12 @@ bool RVCProcessor::executeRVCCommand(const juce::String& command)
     }
     
     int exitCode = process.getExitCode();
-    
-    // Read any remaining output
-    auto remainingOutput = process.readAllProcessOutput();
-    if (remainingOutput.isNotEmpty())
-    {
-        processOutput += remainingOutput;
-    }
+    juce::String processOutput = process.getOutput();
     
     updateProgress(0.95, "RVC finished with exit code: " + juce::String(exitCode));
     
     if (processOutput.isNotEmpty())
     {
-        juce::File outputDebugFile("/tmp/rvc_process_output.txt");
         outputDebugFile.replaceWithText(processOutput);
         
         if (onProcessingComplete)
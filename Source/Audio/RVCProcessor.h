@@ -27,8 +27,8 @@ private:
     int quality = 128;
     
     bool checkRVCAvailability();
-    juce::String buildRVCCommand();
-    bool executeRVCCommand(const juce::String& command);
+    juce::StringArray buildRVCCommand();
+    bool executeRVCCommand(const juce::StringArray& command);
     
     void updateProgress(double progress, const juce::String& message);
     
@@ -0,0 +1,223 @@
+#include "RecordingFifo.h"
+
+namespace
+{
+    // Input the interpolator is never allowed to consume, so it can't read past what we have
+    constexpr int resamplerMargin = 8;
+
+    // How far the interpolator's output trails its input
+    const int resamplerLatency = juce::roundToInt(juce::WindowedSincInterpolator::getBaseLatency());
+}
+
+RecordingFifo::RecordingFifo(int numChannels, int capacityInSamples)
+    : fifo(capacityInSamples),
+      buffer(numChannels, capacityInSamples),
+      resamplerInput(numChannels, capacityInSamples + resamplerMargin * 2),
+      resamplerOutput(numChannels, (capacityInSamples + resamplerMargin * 2) * 2),
+      resamplerOutputToSkip(resamplerLatency)
+{
+    buffer.clear();
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        interpolators.add(new juce::WindowedSincInterpolator());
+}
+
+RecordingFifo::~RecordingFifo()
+{
+}
+
+void RecordingFifo::setWriter(std::unique_ptr<juce::AudioFormatWriter> newWriter)
+{
+    writer = std::move(newWriter);
+}
+
+std::unique_ptr<juce::AudioFormatWriter> RecordingFifo::releaseWriter()
+{
+    return std::move(writer);
+}
+
+void RecordingFifo::reset()
+{
+    fifo.reset();
+    resamplerInputCount = 0;
+    resamplerOutputToSkip = resamplerLatency;
+    resamplingRatio = 1.0;
+
+    for (auto* interpolator : interpolators)
+        interpolator->reset();
+
+    numOverruns = 0;
+    numDroppedSamples = 0;
+    numSamplesWritten = 0;
+}
+
+void RecordingFifo::setResamplingEnabled(bool shouldResample)
+{
+    resamplingEnabled = shouldResample;
+}
+
+bool RecordingFifo::push(const float* const* data, int numChannels, int numSamples)
+{
+    if (numSamples <= 0)
+        return true;
+
+    // Drop the whole block rather than a partial one so the take stays contiguous
+    // up to the overrun, and record it so the caller can see that it happened
+    if (fifo.getFreeSpace() < numSamples)
+    {
+        numOverruns.fetch_add(1);
+        numDroppedSamples.fetch_add(numSamples);
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        // Duplicate the last available input channel if the device gives us fewer than we record
+        auto* source = data[juce::jmin(channel, numChannels - 1)];
+
+        if (source == nullptr)
+        {
+            buffer.clear(channel, start1, size1);
+            if (size2 > 0)
+                buffer.clear(channel, start2, size2);
+            continue;
+        }
+
+        buffer.copyFrom(channel, start1, source, size1);
+        if (size2 > 0)
+            buffer.copyFrom(channel, start2, source + size1, size2);
+    }
+
+    fifo.finishedWrite(size1 + size2);
+    return true;
+}
+
+int RecordingFifo::useTimeSlice()
+{
+    // Sleep a little longer when idle so the thread doesn't spin between blocks
+    return writeAvailable() > 0 ? 0 : 10;
+}
+
+void RecordingFifo::drain()
+{
+    while (writeAvailable() > 0)
+    {
+    }
+
+    if (resamplingEnabled)
+        flushResampler();
+}
+
+int RecordingFifo::writeAvailable()
+{
+    auto numReady = fifo.getNumReady();
+
+    // Leave room in the resampler's staging buffer for what it is still holding on to
+    if (resamplingEnabled)
+        numReady = juce::jmin(numReady, resamplerInput.getNumSamples() - resamplerInputCount);
+
+    if (numReady <= 0)
+        return 0;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+    if (resamplingEnabled)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            resamplerInput.copyFrom(channel, resamplerInputCount, buffer, channel, start1, size1);
+            if (size2 > 0)
+                resamplerInput.copyFrom(channel, resamplerInputCount + size1, buffer, channel, start2, size2);
+        }
+
+        resamplerInputCount += size1 + size2;
+        resample(std::numeric_limits<int>::max());
+    }
+    else
+    {
+        if (size1 > 0)
+            writeBlock(buffer.getArrayOfReadPointers(), start1, size1);
+        if (size2 > 0)
+            writeBlock(buffer.getArrayOfReadPointers(), start2, size2);
+    }
+
+    fifo.finishedRead(size1 + size2);
+
+    return size1 + size2;
+}
+
+void RecordingFifo::writeBlock(const float* const* channels, int startSample, int numSamples)
+{
+    if (writer == nullptr)
+        return;
+
+    const float* offsetChannels[8] {};
+    auto numChannels = juce::jmin(buffer.getNumChannels(), 8);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        offsetChannels[channel] = channels[channel] + startSample;
+
+    writer->writeFromFloatArrays(offsetChannels, numChannels, numSamples);
+    numSamplesWritten.fetch_add(numSamples);
+}
+
+int RecordingFifo::resample(int maxOutput)
+{
+    auto ratio = resamplingRatio.load();
+    auto numOutput = static_cast<int>(std::floor((resamplerInputCount - resamplerMargin) / ratio));
+    numOutput = juce::jmin(numOutput, resamplerOutput.getNumSamples(), maxOutput);
+
+    if (numOutput <= 0)
+        return 0;
+
+    int numUsed = 0;
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        numUsed = interpolators[channel]->process(ratio, resamplerInput.getReadPointer(channel),
+                                                  resamplerOutput.getWritePointer(channel), numOutput);
+
+    // The interpolator's first output comes from before the take began, so the take would land late
+    auto numSkipped = juce::jmin(resamplerOutputToSkip, numOutput);
+    resamplerOutputToSkip -= numSkipped;
+    writeBlock(resamplerOutput.getArrayOfReadPointers(), numSkipped, numOutput - numSkipped);
+
+    // Keep the unconsumed tail for the next round
+    auto remaining = resamplerInputCount - numUsed;
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        auto* data = resamplerInput.getWritePointer(channel);
+        std::memmove(data, data + numUsed, static_cast<size_t>(remaining) * sizeof(float));
+    }
+
+    resamplerInputCount = remaining;
+    return numOutput;
+}
+
+void RecordingFifo::flushResampler()
+{
+    // Still to come out: what's staged, and what the interpolator is holding back
+    auto numRemaining = juce::roundToInt((resamplerInputCount + resamplerLatency) / resamplingRatio.load());
+
+    while (numRemaining > 0)
+    {
+        // Silence after the end pushes the last of the take through
+        for (int channel = 0; channel < resamplerInput.getNumChannels(); ++channel)
+            resamplerInput.clear(channel, resamplerInputCount, resamplerInput.getNumSamples() - resamplerInputCount);
+
+        resamplerInputCount = resamplerInput.getNumSamples();
+
+        auto numProduced = resample(numRemaining);
+
+        if (numProduced <= 0)
+            break;
+
+        numRemaining -= numProduced;
+    }
+
+    resamplerInputCount = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Wait-free single-producer/single-consumer FIFO between the input callback and disk.
+ * The audio thread pushes blocks, a TimeSliceThread drains them into an AudioFormatWriter.
+ * If the consumer falls behind, the block is dropped and counted instead of blocking.
+ */
+class RecordingFifo : public juce::TimeSliceClient
+{
+public:
+    RecordingFifo(int numChannels, int capacityInSamples);
+    ~RecordingFifo() override;
+
+    // Consumer setup - call from the message thread while the FIFO is not being drained
+    void setWriter(std::unique_ptr<juce::AudioFormatWriter> newWriter);
+    std::unique_ptr<juce::AudioFormatWriter> releaseWriter();
+    void reset();
+
+    // Optional drift correction between the FIFO and the writer. The ratio is input samples
+    // consumed per sample written and may be updated from the producer at any time.
+    void setResamplingEnabled(bool shouldResample);
+    void setResamplingRatio(double newRatio) { resamplingRatio.store(newRatio); }
+
+    // Producer side - audio thread only, never blocks or allocates
+    bool push(const float* const* data, int numChannels, int numSamples);
+
+    // Consumer side - background thread, or the message thread once the producer has stopped
+    int useTimeSlice() override;
+    void drain();
+
+    // Overrun statistics, readable from any thread
+    juce::int64 getNumOverruns() const { return numOverruns.load(); }
+    juce::int64 getNumDroppedSamples() const { return numDroppedSamples.load(); }
+    // Frames written to the take, which differs from frames pushed once drift is corrected
+    juce::int64 getNumSamplesWritten() const { return numSamplesWritten.load(); }
+
+private:
+    juce::AbstractFifo fifo;
+    juce::AudioBuffer<float> buffer;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+
+    bool resamplingEnabled = false;
+    std::atomic<double> resamplingRatio { 1.0 };
+    juce::OwnedArray<juce::WindowedSincInterpolator> interpolators;
+    juce::AudioBuffer<float> resamplerInput;
+    juce::AudioBuffer<float> resamplerOutput;
+    int resamplerInputCount = 0;
+    int resamplerOutputToSkip = 0;
+
+    std::atomic<juce::int64> numOverruns { 0 };
+    std::atomic<juce::int64> numDroppedSamples { 0 };
+    std::atomic<juce::int64> numSamplesWritten { 0 };
+
+    int writeAvailable();
+    void writeBlock(const float* const* channels, int startSample, int numSamples);
+    // Resamples what's staged, writing at most maxOutput samples. Returns how many it produced,
+    // counting any skipped for the interpolator's latency.
+    int resample(int maxOutput);
+    void flushResampler();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordingFifo)
+};
@@ -0,0 +1,150 @@
+#include "Sha256.h"
+
+namespace
+{
+    constexpr int fileReadSize = 1 << 20;
+
+    constexpr juce::uint32 roundConstants[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    inline juce::uint32 rotateRight(juce::uint32 x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+}
+
+Sha256::Sha256()
+    : state { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+{
+}
+
+void Sha256::update(const void* data, size_t numBytes)
+{
+    auto* bytes = static_cast<const juce::uint8*>(data);
+    totalBytes += numBytes;
+
+    // Top up a partly filled block first, then hash whole blocks straight from the input
+    if (blockUsed > 0)
+    {
+        auto toCopy = juce::jmin(numBytes, sizeof(block) - blockUsed);
+        std::memcpy(block + blockUsed, bytes, toCopy);
+        blockUsed += toCopy;
+        bytes += toCopy;
+        numBytes -= toCopy;
+
+        if (blockUsed < sizeof(block))
+            return;
+
+        processBlock(block);
+        blockUsed = 0;
+    }
+
+    for (; numBytes >= sizeof(block); bytes += sizeof(block), numBytes -= sizeof(block))
+        processBlock(bytes);
+
+    std::memcpy(block, bytes, numBytes);
+    blockUsed = numBytes;
+}
+
+juce::String Sha256::finish()
+{
+    auto bitLength = totalBytes * 8;
+
+    // A one bit, zeros up to 8 bytes short of a block boundary, then the length big-endian
+    const juce::uint8 one = 0x80;
+    const juce::uint8 zero = 0;
+    update(&one, 1);
+
+    while (blockUsed != sizeof(block) - 8)
+        update(&zero, 1);
+
+    juce::uint8 length[8];
+
+    for (int i = 0; i < 8; ++i)
+        length[i] = static_cast<juce::uint8>(bitLength >> (56 - 8 * i));
+
+    update(length, sizeof(length));
+
+    juce::uint8 digest[32];
+
+    for (int i = 0; i < 8; ++i)
+        for (int j = 0; j < 4; ++j)
+            digest[i * 4 + j] = static_cast<juce::uint8>(state[i] >> (24 - 8 * j));
+
+    return juce::String::toHexString(digest, sizeof(digest), 0);
+}
+
+void Sha256::processBlock(const juce::uint8* data)
+{
+    juce::uint32 w[64];
+
+    for (int i = 0; i < 16; ++i)
+        w[i] = (juce::uint32(data[i * 4]) << 24) | (juce::uint32(data[i * 4 + 1]) << 16)
+               | (juce::uint32(data[i * 4 + 2]) << 8) | juce::uint32(data[i * 4 + 3]);
+
+    for (int i = 16; i < 64; ++i)
+    {
+        auto s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        auto s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    auto a = state[0], b = state[1], c = state[2], d = state[3];
+    auto e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; ++i)
+    {
+        auto s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        auto choice = (e & f) ^ (~e & g);
+        auto temp1 = h + s1 + choice + roundConstants[i] + w[i];
+        auto s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        auto majority = (a & b) ^ (a & c) ^ (b & c);
+        auto temp2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+juce::String Sha256::hashFile(const juce::File& file, const std::function<bool()>& shouldExit)
+{
+    juce::FileInputStream input(file);
+
+    if (!input.openedOk())
+        return {};
+
+    Sha256 hasher;
+    juce::HeapBlock<char> buffer(fileReadSize);
+
+    for (;;)
+    {
+        if (shouldExit != nullptr && shouldExit())
+            return {};
+
+        auto numRead = input.read(buffer, fileReadSize);
+
+        if (numRead <= 0)
+            break;
+
+        hasher.update(buffer, static_cast<size_t>(numRead));
+    }
+
+    return hasher.finish();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * SHA-256, for naming a file to the separation service by its contents. The service hashes
+ * uploads the same way, so both ends agree on the key without the bytes having to move.
+ * We don't link juce_cryptography, and this is all of it we'd need.
+ */
+class Sha256
+{
+public:
+    Sha256();
+
+    void update(const void* data, size_t numBytes);
+
+    // The digest as 64 lowercase hex digits. Call once, after the last update.
+    juce::String finish();
+
+    // Empty if the file can't be read or shouldExit fires
+    static juce::String hashFile(const juce::File& file, const std::function<bool()>& shouldExit = nullptr);
+
+private:
+    juce::uint32 state[8];
+    juce::uint8 block[64];
+    size_t blockUsed = 0;
+    juce::uint64 totalBytes = 0;
+
+    void processBlock(const juce::uint8* data);
+};
@@ -0,0 +1,233 @@
+#include "StemArchive.h"
+
+namespace
+{
+    // Zip layout: entries, each a local header then its data, then the central directory,
+    // then the end record. Zip64 isn't needed for a song's stems.
+    constexpr juce::uint32 localHeaderSignature = 0x04034b50;
+    constexpr juce::uint32 directoryHeaderSignature = 0x02014b50;
+    constexpr juce::uint32 endRecordSignature = 0x06054b50;
+    constexpr int localHeaderSize = 30;
+    constexpr int directoryHeaderSize = 46;
+    constexpr int endRecordSize = 22;
+    constexpr int maxCommentSize = 0xffff;
+
+    constexpr int storedMethod = 0;
+    constexpr int deflatedMethod = 8;
+
+    // The order findStem looks for them in
+    const char* const stemExtensions[] = { ".flac", ".wav", ".mp3" };
+
+    // Holds the mapping, so it's there before the stream reading it is built and outlives it
+    struct MappedRegion
+    {
+        explicit MappedRegion(std::unique_ptr<juce::MemoryMappedFile> file)
+            : mapping(std::move(file))
+        {
+        }
+
+        std::unique_ptr<juce::MemoryMappedFile> mapping;
+    };
+
+    // A stored entry read in place. The mapping starts on a page boundary, which may be before the entry.
+    class MappedEntryStream : private MappedRegion, public juce::MemoryInputStream
+    {
+    public:
+        MappedEntryStream(std::unique_ptr<juce::MemoryMappedFile> file, juce::int64 dataStart, juce::int64 dataSize)
+            : MappedRegion(std::move(file)),
+              juce::MemoryInputStream(static_cast<const char*>(mapping->getData()) + (dataStart - mapping->getRange().getStart()),
+                                      static_cast<size_t>(dataSize), false)
+        {
+        }
+    };
+}
+
+std::unique_ptr<juce::AudioFormatReader> StemArchive::createReader(const juce::File& archive, const juce::String& stemName)
+{
+    Entry entry;
+
+    if (!findStem(archive, stemName, entry))
+        return nullptr;
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    auto* format = formatManager.findFormatForFileExtension(entry.name.fromLastOccurrenceOf(".", true, false));
+    auto stream = createStream(archive, entry);
+
+    if (format == nullptr || stream == nullptr)
+        return nullptr;
+
+    return std::unique_ptr<juce::AudioFormatReader>(format->createReaderFor(stream.release(), true));
+}
+
+bool StemArchive::hasStem(const juce::File& archive, const juce::String& stemName)
+{
+    Entry entry;
+    return findStem(archive, stemName, entry);
+}
+
+juce::File StemArchive::extractStem(const juce::File& archive, const juce::String& stemName, const juce::File& directory)
+{
+    Entry entry;
+
+    if (!findStem(archive, stemName, entry))
+        return {};
+
+    auto stream = createStream(archive, entry);
+
+    if (stream == nullptr)
+        return {};
+
+    auto destination = directory.getChildFile(entry.name.fromLastOccurrenceOf("/", false, false));
+    juce::TemporaryFile tempFile(destination);
+
+    {
+        juce::FileOutputStream output(tempFile.getFile());
+
+        if (!output.openedOk() || output.writeFromInputStream(*stream, -1) != entry.uncompressedSize)
+            return {};
+
+        output.flush();
+
+        if (output.getStatus().failed())
+            return {};
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary() ? destination : juce::File();
+}
+
+juce::Array<StemArchive::Entry> StemArchive::readEntries(const juce::File& archive)
+{
+    juce::FileInputStream input(archive);
+
+    if (!input.openedOk())
+        return {};
+
+    auto fileSize = input.getTotalLength();
+
+    // The end record is last, followed only by a comment, so it's somewhere in the tail
+    auto tailSize = static_cast<int>(juce::jmin<juce::int64>(fileSize, endRecordSize + maxCommentSize));
+    juce::HeapBlock<char> tail(tailSize);
+    input.setPosition(fileSize - tailSize);
+
+    if (input.read(tail, tailSize) != tailSize)
+        return {};
+
+    int endRecord = tailSize - endRecordSize;
+
+    while (endRecord >= 0 && juce::ByteOrder::littleEndianInt(tail + endRecord) != endRecordSignature)
+        --endRecord;
+
+    if (endRecord < 0)
+        return {};
+
+    auto numEntries = static_cast<int>(juce::ByteOrder::littleEndianShort(tail + endRecord + 10));
+    auto directorySize = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt(tail + endRecord + 12));
+    auto directoryStart = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt(tail + endRecord + 16));
+
+    if (directoryStart + directorySize > fileSize)
+        return {};
+
+    juce::MemoryBlock directory;
+    input.setPosition(directoryStart);
+
+    if (input.readIntoMemoryBlock(directory, static_cast<juce::ssize_t>(directorySize)) != static_cast<size_t>(directorySize))
+        return {};
+
+    juce::Array<Entry> entries;
+    auto* header = static_cast<const char*>(directory.getData());
+    auto* directoryEnd = header + directory.getSize();
+
+    for (int i = 0; i < numEntries; ++i)
+    {
+        if (directoryEnd - header < directoryHeaderSize || juce::ByteOrder::littleEndianInt(header) != directoryHeaderSignature)
+            return {};
+
+        auto method = static_cast<int>(juce::ByteOrder::littleEndianShort(header + 10));
+        auto nameLength = static_cast<int>(juce::ByteOrder::littleEndianShort(header + 28));
+        auto extraLength = static_cast<int>(juce::ByteOrder::littleEndianShort(header + 30));
+        auto commentLength = static_cast<int>(juce::ByteOrder::littleEndianShort(header + 32));
+        auto headerLength = directoryHeaderSize + nameLength + extraLength + commentLength;
+
+        if (directoryEnd - header < headerLength)
+            return {};
+
+        Entry entry;
+        entry.name = juce::String::fromUTF8(header + directoryHeaderSize, nameLength);
+        entry.stored = method == storedMethod;
+        entry.compressedSize = juce::ByteOrder::littleEndianInt(header + 20);
+        entry.uncompressedSize = juce::ByteOrder::littleEndianInt(header + 24);
+        auto localHeaderStart = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt(header + 42));
+        header += headerLength;
+
+        // Anything else is a compression JUCE can't undo, and no stem we'd ask for
+        if (method != storedMethod && method != deflatedMethod)
+            continue;
+
+        // The local header's name and extra field needn't match the directory's, so its own lengths say where the data starts
+        char localHeader[localHeaderSize];
+        input.setPosition(localHeaderStart);
+
+        if (input.read(localHeader, localHeaderSize) != localHeaderSize
+            || juce::ByteOrder::littleEndianInt(localHeader) != localHeaderSignature)
+            return {};
+
+        entry.dataStart = localHeaderStart + localHeaderSize
+                          + juce::ByteOrder::littleEndianShort(localHeader + 26)
+                          + juce::ByteOrder::littleEndianShort(localHeader + 28);
+
+        if (entry.dataStart + entry.compressedSize > fileSize || (entry.stored && entry.compressedSize != entry.uncompressedSize))
+            return {};
+
+        entries.add(entry);
+    }
+
+    return entries;
+}
+
+bool StemArchive::findStem(const juce::File& archive, const juce::String& stemName, Entry& entry)
+{
+    auto entries = readEntries(archive);
+
+    for (auto* extension : stemExtensions)
+    {
+        for (auto& candidate : entries)
+        {
+            if (candidate.name.fromLastOccurrenceOf("/", false, false) == stemName + extension)
+            {
+                entry = candidate;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+std::unique_ptr<juce::InputStream> StemArchive::createStream(const juce::File& archive, const Entry& entry)
+{
+    if (entry.stored && entry.compressedSize > 0)
+    {
+        juce::Range<juce::int64> range(entry.dataStart, entry.dataStart + entry.compressedSize);
+        auto mapping = std::make_unique<juce::MemoryMappedFile>(archive, range, juce::MemoryMappedFile::readOnly);
+
+        if (mapping->getData() != nullptr && mapping->getRange().contains(range))
+            return std::make_unique<MappedEntryStream>(std::move(mapping), entry.dataStart, entry.compressedSize);
+    }
+
+    // Read through the file instead where it can't be mapped
+    auto input = std::make_unique<juce::FileInputStream>(archive);
+
+    if (!input->openedOk())
+        return nullptr;
+
+    auto region = std::make_unique<juce::SubregionStream>(input.release(), entry.dataStart, entry.compressedSize, true);
+
+    if (entry.stored)
+        return region;
+
+    // Seeking back means inflating again from the top, which is why the service stores its entries
+    return std::make_unique<juce::GZIPDecompressorInputStream>(region.release(), true,
+                                                               juce::GZIPDecompressorInputStream::deflateFormat,
+                                                               entry.uncompressedSize);
+}
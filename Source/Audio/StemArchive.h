@@ -0,0 +1,46 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * The separation service's archive of stems, kept just as it was downloaded and read in place
+ * rather than extracted. The service stores its entries uncompressed, so each stem is a plain
+ * run of bytes in the archive and is read memory-mapped straight out of it - nothing is copied
+ * to disk a second time, and every reader shares the same pages. An archive with deflated
+ * entries, from a service that still compresses them, is inflated as it's read.
+ */
+class StemArchive
+{
+public:
+    // What the archive is called in a directory of stems
+    static constexpr const char* fileName = "stems.zip";
+
+    // A stem by name in whichever format it was separated to, e.g. createReader(zip, "vocals").
+    // Null if the archive doesn't have it.
+    static std::unique_ptr<juce::AudioFormatReader> createReader(const juce::File& archive, const juce::String& stemName);
+
+    static bool hasStem(const juce::File& archive, const juce::String& stemName);
+
+    // Writes one stem out into the directory, for tools that can only take a file. Returns the
+    // file written, or a nonexistent one on failure.
+    static juce::File extractStem(const juce::File& archive, const juce::String& stemName, const juce::File& directory);
+
+private:
+    StemArchive() = delete;
+
+    struct Entry
+    {
+        juce::String name;
+        bool stored = true;
+        juce::int64 dataStart = 0;
+        juce::int64 compressedSize = 0;
+        juce::int64 uncompressedSize = 0;
+    };
+
+    // From the central directory, with each entry's data located past its local header.
+    // Empty if the file isn't an archive we can read in place.
+    static juce::Array<Entry> readEntries(const juce::File& archive);
+
+    static bool findStem(const juce::File& archive, const juce::String& stemName, Entry& entry);
+    static std::unique_ptr<juce::InputStream> createStream(const juce::File& archive, const Entry& entry);
+};
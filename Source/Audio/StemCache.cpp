@@ -0,0 +1,155 @@
+#include "StemCache.h"
+
+namespace
+{
+    constexpr int hashBlockSize = 65536;
+
+    // 64-bit FNV-1a - quick, and plenty to tell a few thousand songs apart
+    constexpr juce::uint64 fnvOffsetBasis = 14695981039346656037ull;
+    constexpr juce::uint64 fnvPrime = 1099511628211ull;
+
+    void addToHash(juce::uint64& hash, const void* data, size_t numBytes)
+    {
+        auto* bytes = static_cast<const juce::uint8*>(data);
+
+        for (size_t i = 0; i < numBytes; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= fnvPrime;
+        }
+    }
+
+    // The file that says an entry is usable
+    const char* const completeMarker = "karaoke.wav";
+}
+
+StemCache::StemCache(const juce::File& directory)
+    : rootDirectory(directory)
+{
+}
+
+juce::File StemCache::getDefaultDirectory()
+{
+    auto appData = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory);
+
+   #if JUCE_MAC
+    appData = appData.getChildFile("Application Support");
+   #endif
+
+    return appData.getChildFile("LucidKaraoke").getChildFile("StemCache");
+}
+
+juce::String StemCache::computeKey(const juce::File& audioFile, const juce::String& variant, const std::function<bool()>& shouldExit)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
+
+    if (reader == nullptr)
+        return {};
+
+    auto hash = fnvOffsetBasis;
+    auto sampleRate = juce::roundToInt(reader->sampleRate);
+    auto numChannels = static_cast<int>(reader->numChannels);
+    auto length = reader->lengthInSamples;
+
+    addToHash(hash, &sampleRate, sizeof(sampleRate));
+    addToHash(hash, &numChannels, sizeof(numChannels));
+    addToHash(hash, &length, sizeof(length));
+
+    juce::AudioBuffer<float> buffer(numChannels, hashBlockSize);
+    std::vector<juce::int16> pcm(hashBlockSize);
+
+    for (juce::int64 position = 0; position < length; position += hashBlockSize)
+    {
+        if (shouldExit != nullptr && shouldExit())
+            return {};
+
+        auto numSamples = static_cast<int>(juce::jmin<juce::int64>(hashBlockSize, length - position));
+        reader->read(&buffer, 0, numSamples, position, true, true);
+
+        // Quantised, so a 16-bit WAV and a FLAC of it come out the same
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* samples = buffer.getReadPointer(channel);
+
+            for (int i = 0; i < numSamples; ++i)
+                pcm[static_cast<size_t>(i)] = static_cast<juce::int16>(juce::roundToInt(juce::jlimit(-1.0f, 1.0f, samples[i]) * 32767.0f));
+
+            addToHash(hash, pcm.data(), static_cast<size_t>(numSamples) * sizeof(juce::int16));
+        }
+    }
+
+    return juce::String::toHexString(static_cast<juce::int64>(hash)).paddedLeft('0', 16)
+           + "_" + juce::File::createLegalFileName(variant);
+}
+
+juce::File StemCache::findEntry(const juce::String& key) const
+{
+    if (key.isEmpty())
+        return {};
+
+    auto entry = getEntryDirectory(key);
+
+    if (!entry.getChildFile(completeMarker).existsAsFile())
+        return {};
+
+    entry.setLastAccessTime(juce::Time::getCurrentTime());
+    return entry;
+}
+
+juce::File StemCache::beginEntry(const juce::String& key) const
+{
+    auto staging = getStagingDirectory(key);
+    staging.deleteRecursively();
+
+    if (staging.createDirectory().failed())
+        return {};
+
+    return staging;
+}
+
+juce::File StemCache::commitEntry(const juce::String& key) const
+{
+    auto staging = getStagingDirectory(key);
+    auto entry = getEntryDirectory(key);
+
+    if (!staging.getChildFile(completeMarker).existsAsFile())
+        return {};
+
+    // Someone else got there first - theirs is just as good
+    if (entry.getChildFile(completeMarker).existsAsFile())
+    {
+        staging.deleteRecursively();
+        return entry;
+    }
+
+    entry.deleteRecursively();
+    return staging.moveFileTo(entry) ? entry : juce::File();
+}
+
+void StemCache::abandonEntry(const juce::String& key) const
+{
+    getStagingDirectory(key).deleteRecursively();
+}
+
+StemCache::Lookup::Lookup(const StemCache& stemCache, const juce::File& fileToLookUp, const juce::String& cacheVariant)
+    : Thread("StemCacheLookup"),
+      cache(stemCache),
+      audioFile(fileToLookUp),
+      variant(cacheVariant)
+{
+}
+
+void StemCache::Lookup::run()
+{
+    auto key = computeKey(audioFile, variant, [this]() { return threadShouldExit(); });
+
+    if (threadShouldExit())
+        return;
+
+    auto entry = cache.findEntry(key);
+
+    if (onLookupComplete)
+        onLookupComplete(key, entry);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Separated stems kept between sessions, so a song that's been separated before is ready the
+ * moment it's loaded again. Entries are keyed by a hash of the decoded samples - the same song
+ * in another folder or another container still hits - plus whatever it was separated with.
+ * Stems are separated straight into a staging directory and renamed into place once they're
+ * complete, so an entry that exists is always whole.
+ */
+class StemCache
+{
+public:
+    explicit StemCache(const juce::File& rootDirectory = getDefaultDirectory());
+
+    static juce::File getDefaultDirectory();
+
+    // Decodes the song and hashes it as 16-bit PCM. Empty if it can't be read or shouldExit fires.
+    static juce::String computeKey(const juce::File& audioFile, const juce::String& variant,
+                                   const std::function<bool()>& shouldExit = nullptr);
+
+    // The entry's directory, marked as just used, or File() on a miss
+    juce::File findEntry(const juce::String& key) const;
+
+    // An empty directory to separate into
+    juce::File beginEntry(const juce::String& key) const;
+
+    // Moves the staging directory into place and returns the entry, or File() on failure
+    juce::File commitEntry(const juce::String& key) const;
+
+    void abandonEntry(const juce::String& key) const;
+
+    juce::File getRootDirectory() const { return rootDirectory; }
+
+    /** Works out a song's key and looks it up, off the message thread. */
+    class Lookup : public juce::Thread
+    {
+    public:
+        Lookup(const StemCache& cache, const juce::File& audioFile, const juce::String& variant);
+        void run() override;
+
+        // Called on the lookup thread. The key is empty if the song couldn't be read; entry is File() on a miss.
+        std::function<void(const juce::String& key, const juce::File& entry)> onLookupComplete;
+
+    private:
+        StemCache cache;
+        juce::File audioFile;
+        juce::String variant;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Lookup)
+    };
+
+private:
+    juce::File rootDirectory;
+
+    juce::File getEntryDirectory(const juce::String& key) const { return rootDirectory.getChildFile(key); }
+    juce::File getStagingDirectory(const juce::String& key) const { return rootDirectory.getChildFile(key + ".partial"); }
+};
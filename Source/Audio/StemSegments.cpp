@@ -0,0 +1,327 @@
+#include "StemSegments.h"
+#include "HttpStemProcessor.h"
+
+namespace
+{
+    constexpr int readBlockSize = 8192;
+
+    class StitchedStemReader : public juce::AudioFormatReader
+    {
+    public:
+        StitchedStemReader(std::shared_ptr<StemSegments> stemSegments, const juce::StringArray& names, float stemGain, double rate)
+            : AudioFormatReader(nullptr, "Stitched stems"),
+              segments(std::move(stemSegments)),
+              stemNames(names),
+              gain(stemGain)
+        {
+            sampleRate = rate;
+            numChannels = 2;
+            bitsPerSample = 32;
+            usesFloatingPointData = true;
+
+            // Where each segment falls at the stems' rate
+            auto ratio = rate / segments->getInputSampleRate();
+
+            for (int i = 0; i < segments->getNumSegments(); ++i)
+            {
+                auto segment = segments->getSegment(i);
+                bounds.add({ static_cast<juce::int64>(std::llround(static_cast<double>(segment.startSample) * ratio)),
+                             static_cast<juce::int64>(std::llround(static_cast<double>(segment.startSample + segment.numSamples) * ratio)) });
+            }
+
+            lengthInSamples = bounds.isEmpty() ? 0 : bounds.getLast().end;
+            openSegments.resize(static_cast<size_t>(bounds.size()));
+            stemAudio.setSize(2, readBlockSize);
+            segmentAudio.setSize(2, readBlockSize);
+        }
+
+        bool readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                         juce::int64 startSampleInFile, int numSamples) override
+        {
+            for (int channel = 0; channel < numDestChannels; ++channel)
+                if (destChannels[channel] != nullptr)
+                    juce::FloatVectorOperations::clear(reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer, numSamples);
+
+            // Taken once, so a segment landing halfway through doesn't upset the crossfades
+            auto ready = segments->getReadyFlags();
+            auto endSample = startSampleInFile + numSamples;
+
+            for (int i = 0; i < ready.size(); ++i)
+            {
+                if (!ready[i])
+                    continue;
+
+                auto segmentStart = bounds[i].start;
+                auto segmentEnd = bounds[i].end;
+                auto from = juce::jmax(startSampleInFile, segmentStart);
+                auto to = juce::jmin(endSample, segmentEnd);
+
+                if (from >= to)
+                    continue;
+
+                auto* stems = openSegment(i);
+
+                if (stems == nullptr)
+                    continue;
+
+                // Fades only where the neighbour is there to take over
+                auto fadeInEnd = i > 0 && ready[i - 1] ? bounds[i - 1].end : segmentStart;
+                auto fadeOutStart = i + 1 < ready.size() && ready[i + 1] ? bounds[i + 1].start : segmentEnd;
+
+                for (auto position = from; position < to; position += readBlockSize)
+                {
+                    auto blockLength = static_cast<int>(juce::jmin<juce::int64>(readBlockSize, to - position));
+                    readSegment(*stems, position - segmentStart, blockLength);
+
+                    for (int channel = 0; channel < juce::jmin(numDestChannels, 2); ++channel)
+                    {
+                        if (destChannels[channel] == nullptr)
+                            continue;
+
+                        auto* dest = reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer + (position - startSampleInFile);
+                        auto* source = segmentAudio.getReadPointer(channel);
+
+                        for (int k = 0; k < blockLength; ++k)
+                        {
+                            auto t = position + k;
+                            auto weight = gain;
+
+                            // Linear both ways: the stems either side are the same audio, so the gains sum to one
+                            if (t < fadeInEnd)
+                                weight *= static_cast<float>((static_cast<double>(t - segmentStart) + 0.5) / static_cast<double>(fadeInEnd - segmentStart));
+
+                            if (t >= fadeOutStart)
+                                weight *= static_cast<float>((static_cast<double>(segmentEnd - t) - 0.5) / static_cast<double>(segmentEnd - fadeOutStart));
+
+                            dest[k] += source[k] * weight;
+                        }
+                    }
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        struct Bounds
+        {
+            juce::int64 start = 0;
+            juce::int64 end = 0;
+        };
+
+        struct OpenSegment
+        {
+            bool attempted = false;
+            std::vector<std::unique_ptr<juce::AudioFormatReader>> stems;
+        };
+
+        std::shared_ptr<StemSegments> segments;
+        juce::StringArray stemNames;
+        float gain = 1.0f;
+
+        juce::Array<Bounds> bounds;
+        std::vector<OpenSegment> openSegments;
+        juce::AudioBuffer<float> stemAudio;
+        juce::AudioBuffer<float> segmentAudio;
+
+        // Opened the first time they're needed and kept. Null if any stem is missing or at another rate.
+        OpenSegment* openSegment(int index)
+        {
+            auto& segment = openSegments[static_cast<size_t>(index)];
+
+            if (!segment.attempted)
+            {
+                segment.attempted = true;
+
+                for (auto& name : stemNames)
+                {
+                    auto reader = HttpStemProcessor::createStemReader(segments->getSegmentDirectory(index), name);
+
+                    if (reader == nullptr || reader->sampleRate != sampleRate)
+                    {
+                        juce::Logger::writeToLog("Segment " + juce::String(index) + " has no usable " + name + " stem");
+                        segment.stems.clear();
+                        break;
+                    }
+
+                    segment.stems.push_back(std::move(reader));
+                }
+            }
+
+            return segment.stems.empty() ? nullptr : &segment;
+        }
+
+        // Mono stems come back on both sides
+        void readSegment(OpenSegment& segment, juce::int64 startSample, int numSamples)
+        {
+            segmentAudio.clear(0, numSamples);
+
+            for (auto& stem : segment.stems)
+            {
+                stem->read(&stemAudio, 0, numSamples, startSample, true, true);
+
+                for (int channel = 0; channel < 2; ++channel)
+                    segmentAudio.addFrom(channel, 0, stemAudio, channel, 0, numSamples);
+            }
+        }
+    };
+}
+
+StemSegments::StemSegments(const juce::File& segmentsDirectory)
+    : directory(segmentsDirectory)
+{
+}
+
+void StemSegments::plan(juce::int64 lengthInSamples, double sampleRate, juce::int64 segmentSamples, juce::int64 overlapSamples)
+{
+    const juce::ScopedLock sl(lock);
+
+    segments.clear();
+    states.clear();
+    inputSampleRate = sampleRate;
+
+    // Every segment but the last is full length, and the last is always longer than the overlap
+    auto hop = segmentSamples - overlapSamples;
+    auto numSegments = juce::jmax<juce::int64>(1, (lengthInSamples - overlapSamples + hop - 1) / hop);
+
+    for (juce::int64 i = 0; i < numSegments; ++i)
+    {
+        Segment segment;
+        segment.startSample = i * hop;
+        segment.numSamples = i == numSegments - 1 ? lengthInSamples - segment.startSample : segmentSamples;
+        segments.add(segment);
+        states.add(State::Pending);
+    }
+}
+
+bool StemSegments::isPlanned() const
+{
+    const juce::ScopedLock sl(lock);
+    return !segments.isEmpty();
+}
+
+int StemSegments::getNumSegments() const
+{
+    const juce::ScopedLock sl(lock);
+    return segments.size();
+}
+
+StemSegments::Segment StemSegments::getSegment(int index) const
+{
+    const juce::ScopedLock sl(lock);
+    return segments[index];
+}
+
+double StemSegments::getInputSampleRate() const
+{
+    const juce::ScopedLock sl(lock);
+    return inputSampleRate;
+}
+
+int StemSegments::takeNext()
+{
+    const juce::ScopedLock sl(lock);
+
+    if (segments.isEmpty())
+        return -1;
+
+    auto lastSegment = segments.getLast();
+    auto playhead = static_cast<juce::int64>(playheadProportion.load() * static_cast<double>(lastSegment.startSample + lastSegment.numSamples));
+    int best = -1;
+
+    for (int i = 0; i < segments.size(); ++i)
+    {
+        if (states[i] != State::Pending)
+            continue;
+
+        if (best < 0)
+        {
+            best = i;
+            continue;
+        }
+
+        // Segments still to be played come before ones already passed. Going in order, the
+        // first still to be played is the one under the playhead or just after it.
+        auto ahead = segments[i].startSample + segments[i].numSamples > playhead;
+        auto bestAhead = segments[best].startSample + segments[best].numSamples > playhead;
+
+        if (ahead != bestAhead)
+        {
+            if (ahead)
+                best = i;
+        }
+        else if (!ahead)
+        {
+            // Of those already passed, the nearest
+            best = i;
+        }
+    }
+
+    if (best >= 0)
+        states.set(best, State::Separating);
+
+    return best;
+}
+
+void StemSegments::giveBack(int index)
+{
+    const juce::ScopedLock sl(lock);
+
+    if (states[index] == State::Separating)
+        states.set(index, State::Pending);
+}
+
+void StemSegments::markReady(int index)
+{
+    const juce::ScopedLock sl(lock);
+    states.set(index, State::Ready);
+}
+
+int StemSegments::getNumReady() const
+{
+    const juce::ScopedLock sl(lock);
+    return static_cast<int>(std::count(states.begin(), states.end(), State::Ready));
+}
+
+bool StemSegments::isComplete() const
+{
+    const juce::ScopedLock sl(lock);
+    return !states.isEmpty() && std::all_of(states.begin(), states.end(), [](State state) { return state == State::Ready; });
+}
+
+juce::Array<bool> StemSegments::getReadyFlags() const
+{
+    const juce::ScopedLock sl(lock);
+    juce::Array<bool> ready;
+
+    for (auto state : states)
+        ready.add(state == State::Ready);
+
+    return ready;
+}
+
+void StemSegments::setPlayheadProportion(double proportion)
+{
+    playheadProportion = juce::jlimit(0.0, 1.0, proportion);
+}
+
+std::unique_ptr<juce::AudioFormatReader> StemSegments::createReader(std::shared_ptr<StemSegments> segments,
+                                                                    const juce::StringArray& stemNames, float gain)
+{
+    if (segments == nullptr || stemNames.isEmpty())
+        return nullptr;
+
+    // The stems' rate comes from the first segment that's back
+    auto ready = segments->getReadyFlags();
+    auto first = ready.indexOf(true);
+
+    if (first < 0)
+        return nullptr;
+
+    auto probe = HttpStemProcessor::createStemReader(segments->getSegmentDirectory(first), stemNames[0]);
+
+    if (probe == nullptr)
+        return nullptr;
+
+    return std::make_unique<StitchedStemReader>(std::move(segments), stemNames, gain, probe->sampleRate);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * A song split into overlapping segments that are separated independently and in any order,
+ * each segment's stems landing in a directory of its own. Hands segments out to whoever is
+ * separating them, nearest the playhead first, and reads the stems back stitched into one
+ * continuous track while the rest are still on their way - neighbours crossfade across the
+ * overlap, and anything not separated yet is silent.
+ *
+ * Segments are planned in input samples; the stitched reader is at whatever rate the
+ * separated stems come back at.
+ */
+class StemSegments
+{
+public:
+    explicit StemSegments(const juce::File& directory);
+
+    struct Segment
+    {
+        juce::int64 startSample = 0;
+        juce::int64 numSamples = 0;
+    };
+
+    // Segments of segmentSamples, each overlapping the next by overlapSamples. The last one runs to the end.
+    void plan(juce::int64 lengthInSamples, double sampleRate, juce::int64 segmentSamples, juce::int64 overlapSamples);
+    bool isPlanned() const;
+
+    int getNumSegments() const;
+    Segment getSegment(int index) const;
+    double getInputSampleRate() const;
+
+    juce::File getDirectory() const { return directory; }
+    juce::File getSegmentDirectory(int index) const { return directory.getChildFile(juce::String(index)); }
+
+    // The next segment to separate - the one under the playhead, then those after it in order,
+    // then those before it, nearest first. -1 once everything is handed out.
+    int takeNext();
+
+    // A segment that couldn't be separated, to be handed out again
+    void giveBack(int index);
+
+    // Its stems are in its directory
+    void markReady(int index);
+
+    int getNumReady() const;
+    bool isComplete() const;
+
+    // Which segments are ready, as of now
+    juce::Array<bool> getReadyFlags() const;
+
+    // Where playback has got to, as a proportion of the song. Safe from any thread.
+    void setPlayheadProportion(double proportion);
+
+    // The named stems summed at gain and stitched together. Null until a segment is ready.
+    static std::unique_ptr<juce::AudioFormatReader> createReader(std::shared_ptr<StemSegments> segments,
+                                                                 const juce::StringArray& stemNames, float gain);
+
+private:
+    enum class State
+    {
+        Pending,
+        Separating,
+        Ready
+    };
+
+    juce::File directory;
+
+    juce::CriticalSection lock;
+    juce::Array<Segment> segments;
+    juce::Array<State> states;
+    double inputSampleRate = 44100.0;
+    std::atomic<double> playheadProportion { 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StemSegments)
+};
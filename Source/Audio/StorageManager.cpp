@@ -0,0 +1,211 @@
+#include "StorageManager.h"
+#include "StemCache.h"
+
+#if JUCE_LINUX
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <sys/resource.h>
+#endif
+
+namespace
+{
+    constexpr int sweepIntervalMs = 10 * 60 * 1000;
+
+    // Between deletions, so a big sweep comes out as a trickle of I/O rather than a burst
+    constexpr int deletionGapMs = 50;
+
+    // Anything touched this recently is left alone - it's probably still being written
+    const juce::RelativeTime minimumAge = juce::RelativeTime::minutes(10);
+
+    // A staging directory this old was abandoned by a crash and goes whatever the budget
+    const juce::RelativeTime stagingLifetime = juce::RelativeTime::days(1);
+
+    // What we write to the temp folder, now and in earlier builds
+    const char* const tempPatterns[] = {
+        "lucidkaraoke_stems_*",
+        "LucidKaraoke_Takes_*.takes",
+        "LucidKaraoke_Takes_*.alignment",
+        "LucidKaraoke_Recording_*.wav",
+        "*_trim100ms*",
+        "rvc_*.txt"
+    };
+
+    void lowerDiskPriority()
+    {
+       #if JUCE_LINUX
+        // Idle class for this thread only: it only gets the disk when nothing else wants it
+        constexpr int ioprioWhoProcess = 1;
+        constexpr int ioprioClassIdle = 3;
+        constexpr int ioprioClassShift = 13;
+        ::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << ioprioClassShift);
+       #elif JUCE_MAC
+        ::setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+       #endif
+    }
+}
+
+StorageManager::StorageManager(juce::int64 budgetBytes)
+    : Thread("StorageManager"),
+      budget(budgetBytes)
+{
+    startThread(juce::Thread::Priority::background);
+}
+
+StorageManager::~StorageManager()
+{
+    stopThread(5000);
+}
+
+void StorageManager::setBudget(juce::int64 budgetBytes)
+{
+    budget = budgetBytes;
+    notify();
+}
+
+void StorageManager::keep(const juce::File& file)
+{
+    if (file == juce::File())
+        return;
+
+    const juce::ScopedLock sl(keptLock);
+    keptFiles.add(file);
+}
+
+void StorageManager::release(const juce::File& file)
+{
+    const juce::ScopedLock sl(keptLock);
+    keptFiles.removeFirstMatchingValue(file);
+}
+
+void StorageManager::setPaused(bool shouldBePaused)
+{
+    paused = shouldBePaused;
+
+    if (!shouldBePaused)
+        notify();
+}
+
+bool StorageManager::isKept(const juce::File& file) const
+{
+    const juce::ScopedLock sl(keptLock);
+
+    for (auto& kept : keptFiles)
+        if (file == kept || kept.isAChildOf(file) || file.isAChildOf(kept))
+            return true;
+
+    return false;
+}
+
+void StorageManager::run()
+{
+    lowerDiskPriority();
+
+    // Give startup a moment before the first sweep
+    wait(5000);
+
+    while (!threadShouldExit())
+    {
+        if (!paused.load())
+            sweep();
+
+        wait(sweepIntervalMs);
+    }
+}
+
+void StorageManager::sweep()
+{
+    auto artifacts = findArtifacts();
+    auto now = juce::Time::getCurrentTime();
+    juce::int64 total = 0;
+
+    for (auto& artifact : artifacts)
+        total += artifact.bytes;
+
+    // Least recently used first
+    std::sort(artifacts.begin(), artifacts.end(), [](const Artifact& a, const Artifact& b) {
+        return a.lastUsed < b.lastUsed;
+    });
+
+    auto limit = budget.load();
+
+    for (auto& artifact : artifacts)
+    {
+        if (threadShouldExit() || paused.load())
+            break;
+
+        auto age = now - artifact.lastUsed;
+        auto abandoned = isStaging(artifact.file) && age > stagingLifetime;
+        auto overBudget = limit > 0 && total > limit;
+
+        if (!abandoned && !overBudget)
+            continue;
+
+        if (age < minimumAge || isKept(artifact.file))
+            continue;
+
+        auto deleted = artifact.file.isDirectory() ? artifact.file.deleteRecursively() : artifact.file.deleteFile();
+
+        if (deleted)
+        {
+            total -= artifact.bytes;
+            juce::Logger::writeToLog("Storage: removed " + artifact.file.getFullPathName()
+                                     + " (" + juce::File::descriptionOfSizeInBytes(artifact.bytes) + ")");
+        }
+
+        wait(deletionGapMs);
+    }
+
+    totalBytes = total;
+
+    if (limit > 0 && total > limit)
+        juce::Logger::writeToLog("Storage: still " + juce::File::descriptionOfSizeInBytes(total)
+                                 + " after sweeping, over the " + juce::File::descriptionOfSizeInBytes(limit) + " budget");
+}
+
+juce::Array<StorageManager::Artifact> StorageManager::findArtifacts()
+{
+    juce::Array<Artifact> artifacts;
+
+    // Every cache entry and staging directory
+    auto cacheRoot = StemCache::getDefaultDirectory();
+
+    if (cacheRoot.isDirectory())
+        for (const auto& entry : juce::RangedDirectoryIterator(cacheRoot, false, "*", juce::File::findDirectories))
+            artifacts.add(measure(entry.getFile()));
+
+    auto tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory);
+
+    for (auto* pattern : tempPatterns)
+        for (const auto& entry : juce::RangedDirectoryIterator(tempDir, false, pattern, juce::File::findFilesAndDirectories))
+            artifacts.add(measure(entry.getFile()));
+
+    return artifacts;
+}
+
+StorageManager::Artifact StorageManager::measure(const juce::File& file)
+{
+    Artifact artifact;
+    artifact.file = file;
+    artifact.lastUsed = juce::jmax(file.getLastAccessTime(), file.getLastModificationTime());
+
+    if (!file.isDirectory())
+    {
+        artifact.bytes = file.getSize();
+        return artifact;
+    }
+
+    // A directory counts as used whenever anything in it was
+    for (const auto& entry : juce::RangedDirectoryIterator(file, true, "*", juce::File::findFiles))
+    {
+        artifact.bytes += entry.getFileSize();
+        artifact.lastUsed = juce::jmax(artifact.lastUsed, entry.getModificationTime());
+    }
+
+    return artifact;
+}
+
+bool StorageManager::isStaging(const juce::File& file)
+{
+    return file.hasFileExtension("partial");
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Keeps everything the pipeline leaves on disk - cached and temporary stems, take containers,
+ * RVC logs and whatever older builds left behind - under a byte budget, deleting the least
+ * recently used first. Sweeps run on a background-priority thread with idle disk priority
+ * where the platform has one, and wait while a take is being recorded.
+ */
+class StorageManager : private juce::Thread
+{
+public:
+    explicit StorageManager(juce::int64 budgetBytes);
+    ~StorageManager() override;
+
+    // 0 means no limit
+    void setBudget(juce::int64 budgetBytes);
+    juce::int64 getBudget() const { return budget.load(); }
+
+    // Never deleted, whatever the budget - the song that's loaded, a separation in flight.
+    // Anything inside a kept directory is kept with it.
+    void keep(const juce::File& file);
+    void release(const juce::File& file);
+
+    // Sweeps wait while this is set
+    void setPaused(bool shouldBePaused);
+
+    // Sweeps soon rather than at the next interval, e.g. after something big was written
+    void requestSweep() { notify(); }
+
+    // What the last sweep left on disk
+    juce::int64 getTotalBytes() const { return totalBytes.load(); }
+
+private:
+    struct Artifact
+    {
+        juce::File file;
+        juce::int64 bytes = 0;
+        juce::Time lastUsed;
+    };
+
+    std::atomic<juce::int64> budget;
+    std::atomic<juce::int64> totalBytes { 0 };
+    std::atomic<bool> paused { false };
+
+    juce::CriticalSection keptLock;
+    juce::Array<juce::File> keptFiles;
+
+    void run() override;
+    void sweep();
+    bool isKept(const juce::File& file) const;
+
+    static juce::Array<Artifact> findArtifacts();
+    static Artifact measure(const juce::File& file);
+    static bool isStaging(const juce::File& file);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StorageManager)
+};
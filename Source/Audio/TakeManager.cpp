@@ -0,0 +1,378 @@
+#include "TakeManager.h"
+
+namespace
+{
+    // Chunk layout: "TAKE", int32 version, int64 audio bytes, int64 take info bytes, audio, take info
+    const char chunkMagic[] = { 'T', 'A', 'K', 'E' };
+    constexpr int chunkVersion = 1;
+    constexpr juce::int64 chunkHeaderSize = 4 + 4 + 8 + 8;
+    constexpr juce::int64 chunkSizesOffset = 8;
+
+    // Lets an audio writer treat its part of the container as a file of its own. Doesn't own
+    // the container stream, which stays open so the chunk can be closed off afterwards.
+    class ChunkAudioStream : public juce::OutputStream
+    {
+    public:
+        ChunkAudioStream(juce::FileOutputStream& container, juce::int64 audioStart)
+            : destination(container), start(audioStart)
+        {
+        }
+
+        void flush() override                               { destination.flush(); }
+        bool setPosition(juce::int64 newPosition) override  { return destination.setPosition(start + newPosition); }
+        juce::int64 getPosition() override                  { return destination.getPosition() - start; }
+        bool write(const void* data, size_t numBytes) override { return destination.write(data, numBytes); }
+
+    private:
+        juce::FileOutputStream& destination;
+        const juce::int64 start;
+
+        JUCE_DECLARE_NON_COPYABLE(ChunkAudioStream)
+    };
+}
+
+TakeManager::TakeManager(const juce::File& containerFile)
+    : file(containerFile)
+{
+    scan();
+}
+
+TakeManager::~TakeManager()
+{
+    if (output != nullptr)
+        abandonTake();
+}
+
+void TakeManager::scan()
+{
+    takes.clear();
+    validLength = 0;
+
+    juce::FileInputStream input(file);
+
+    if (!input.openedOk())
+        return;
+
+    auto totalLength = input.getTotalLength();
+
+    while (validLength + chunkHeaderSize <= totalLength)
+    {
+        input.setPosition(validLength);
+
+        char magic[4] {};
+        input.read(magic, 4);
+        auto version = input.readInt();
+        auto audioBytes = input.readInt64();
+        auto infoBytes = input.readInt64();
+        auto chunkEnd = validLength + chunkHeaderSize + audioBytes + infoBytes;
+
+        // An unfinished chunk from a crash - everything before it is still good
+        if (std::memcmp(magic, chunkMagic, 4) != 0 || version != chunkVersion
+            || audioBytes <= 0 || infoBytes <= 0 || chunkEnd > totalLength)
+            break;
+
+        input.setPosition(validLength + chunkHeaderSize + audioBytes);
+
+        juce::MemoryBlock infoData;
+        input.readIntoMemoryBlock(infoData, static_cast<juce::ssize_t>(infoBytes));
+
+        if (auto info = juce::parseXML(infoData.toString()); info != nullptr && info->hasTagName("TAKE"))
+        {
+            Take take;
+            take.index = takes.size();
+            take.audioOffset = validLength + chunkHeaderSize;
+            take.audioBytes = audioBytes;
+            take.sampleRate = info->getDoubleAttribute("sampleRate");
+            take.songStartSample = info->getStringAttribute("songStartSample").getLargeIntValue();
+            take.numSamples = info->getStringAttribute("numSamples").getLargeIntValue();
+            takes.add(take);
+        }
+
+        validLength = chunkEnd;
+    }
+
+    if (validLength < totalLength)
+        juce::Logger::writeToLog("Ignoring an incomplete take at the end of " + file.getFileName());
+}
+
+std::unique_ptr<juce::OutputStream> TakeManager::beginTake()
+{
+    if (output != nullptr)
+        abandonTake();
+
+    output = std::make_unique<juce::FileOutputStream>(file);
+
+    if (!output->openedOk())
+    {
+        output.reset();
+        return {};
+    }
+
+    // Drop whatever an interrupted take left behind before appending
+    if (output->getPosition() != validLength)
+    {
+        output->setPosition(validLength);
+        output->truncate();
+    }
+
+    chunkStart = validLength;
+
+    // The sizes stay zero until the take is finished, which is how a crashed take is recognised
+    output->write(chunkMagic, 4);
+    output->writeInt(chunkVersion);
+    output->writeInt64(0);
+    output->writeInt64(0);
+    output->flush();
+
+    return std::make_unique<ChunkAudioStream>(*output, chunkStart + chunkHeaderSize);
+}
+
+bool TakeManager::finishTake(const juce::XmlElement& takeInfo)
+{
+    if (output == nullptr)
+        return false;
+
+    // The writer may have left the stream anywhere after patching its header. Reserved space
+    // doesn't count towards the size, so the file's length is where the audio ends.
+    output->flush();
+    auto audioStart = chunkStart + chunkHeaderSize;
+    auto audioEnd = juce::jmax(audioStart, file.getSize());
+    auto audioBytes = audioEnd - audioStart;
+
+    if (audioBytes <= 0)
+    {
+        abandonTake();
+        return false;
+    }
+
+    auto info = takeInfo.toString(juce::XmlElement::TextFormat().singleLine().withoutHeader());
+    auto infoBytes = static_cast<juce::int64>(info.getNumBytesAsUTF8());
+
+    output->setPosition(audioEnd);
+    output->write(info.toRawUTF8(), static_cast<size_t>(infoBytes));
+
+    // Closing the chunk off is the only write that ever goes back into the file
+    output->setPosition(chunkStart + chunkSizesOffset);
+    output->writeInt64(audioBytes);
+    output->writeInt64(infoBytes);
+    output->flush();
+
+    auto ok = output->getStatus().wasOk();
+    output.reset();
+
+    Take take;
+    take.index = takes.size();
+    take.audioOffset = audioStart;
+    take.audioBytes = audioBytes;
+    take.sampleRate = takeInfo.getDoubleAttribute("sampleRate");
+    take.songStartSample = takeInfo.getStringAttribute("songStartSample").getLargeIntValue();
+    take.numSamples = takeInfo.getStringAttribute("numSamples").getLargeIntValue();
+    takes.add(take);
+
+    validLength = audioEnd + infoBytes;
+    chunkStart = -1;
+
+    return ok;
+}
+
+void TakeManager::abandonTake()
+{
+    if (output == nullptr)
+        return;
+
+    output->setPosition(chunkStart);
+    output->truncate();
+    output.reset();
+    chunkStart = -1;
+}
+
+std::unique_ptr<juce::AudioFormatReader> TakeManager::createReaderFor(const juce::File& containerFile, const Take& take,
+                                                                      juce::AudioFormatManager& formatManager)
+{
+    auto input = std::make_unique<juce::FileInputStream>(containerFile);
+
+    if (!input->openedOk())
+        return {};
+
+    auto region = std::make_unique<juce::SubregionStream>(input.release(), take.audioOffset, take.audioBytes, true);
+    return std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(std::move(region)));
+}
+
+bool TakeManager::renderComposite(const juce::File& containerFile, const juce::Array<Take>& takes,
+                                  const juce::File& outputFile, double crossfadeSeconds)
+{
+    CompositeReader composite(containerFile, takes, crossfadeSeconds);
+
+    if (composite.isEmpty())
+        return false;
+
+    outputFile.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> stream(outputFile.createOutputStream());
+
+    if (stream == nullptr)
+        return false;
+
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), composite.sampleRate, 1, 32, {}, 0));
+
+    if (writer == nullptr)
+        return false;
+
+    stream.release();
+
+    if (!writer->writeFromAudioReader(composite, 0, composite.lengthInSamples))
+        return false;
+
+    writer.reset();
+
+    // The composite is itself a take that starts right at the beginning of the song
+    juce::XmlElement takeInfo("TAKE");
+    takeInfo.setAttribute("sampleRate", composite.sampleRate);
+    takeInfo.setAttribute("songStartSample", "0");
+    takeInfo.setAttribute("numSamples", juce::String(composite.lengthInSamples));
+    takeInfo.setAttribute("composite", true);
+    takeInfo.setAttribute("numTakes", takes.size());
+
+    return takeInfo.writeTo(outputFile.withFileExtension("xml"));
+}
+
+//==============================================================================
+TakeManager::CompositeReader::CompositeReader(const juce::File& containerFile, const juce::Array<Take>& takesToUse,
+                                              double crossfadeSeconds)
+    : juce::AudioFormatReader(nullptr, "Take composite"),
+      takes(takesToUse)
+{
+    numChannels = 1;
+    bitsPerSample = 32;
+    usesFloatingPointData = true;
+
+    if (takes.isEmpty())
+        return;
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    // Everything is laid out at the newest take's rate - a take recorded on another device
+    // at a different rate can't be placed sample-accurately, so it's left out
+    sampleRate = takes.getLast().sampleRate;
+    readers.resize(static_cast<size_t>(takes.size()));
+
+    for (int i = 0; i < takes.size(); ++i)
+    {
+        if (takes[i].sampleRate != sampleRate)
+        {
+            juce::Logger::writeToLog("Skipping take " + juce::String(i + 1) + " recorded at a different sample rate");
+            continue;
+        }
+
+        readers[static_cast<size_t>(i)] = createReaderFor(containerFile, takes[i], formatManager);
+    }
+
+    // Paint the takes onto the timeline oldest first, so each newer one covers what it overlaps.
+    // Anything before the song starts (pre-roll) is dropped.
+    for (int i = 0; i < takes.size(); ++i)
+    {
+        if (readers[static_cast<size_t>(i)] == nullptr)
+            continue;
+
+        auto start = juce::jmax<juce::int64>(0, takes[i].songStartSample);
+        auto end = takes[i].getSongEndSample();
+
+        if (end <= start)
+            continue;
+
+        std::vector<Segment> painted;
+
+        for (auto& segment : segments)
+        {
+            if (segment.start < start)
+                painted.push_back({ segment.start, juce::jmin(segment.end, start), segment.take });
+            if (segment.end > end)
+                painted.push_back({ juce::jmax(segment.start, end), segment.end, segment.take });
+        }
+
+        painted.push_back({ start, end, i });
+        std::sort(painted.begin(), painted.end(), [](const Segment& a, const Segment& b) { return a.start < b.start; });
+        segments = std::move(painted);
+    }
+
+    if (segments.empty())
+        return;
+
+    // Crossfade across each hand-over, as long as both takes actually have audio on both sides of it
+    auto crossfade = static_cast<juce::int64>(crossfadeSeconds * sampleRate);
+
+    for (size_t i = 1; i < segments.size(); ++i)
+    {
+        auto& previous = segments[i - 1];
+        auto& next = segments[i];
+
+        if (previous.end != next.start || previous.take == next.take)
+            continue;
+
+        auto length = juce::jmin(crossfade, (previous.end - previous.start) / 2, (next.end - next.start) / 2);
+        auto& outgoing = takes.getReference(previous.take);
+        auto& incoming = takes.getReference(next.take);
+
+        if (length > 0
+            && outgoing.songStartSample <= next.start - length && outgoing.getSongEndSample() >= next.start + length
+            && incoming.songStartSample <= next.start - length && incoming.getSongEndSample() >= next.start + length)
+        {
+            previous.fadeOut = length;
+            next.fadeIn = length;
+        }
+    }
+
+    lengthInSamples = segments.back().end;
+}
+
+TakeManager::CompositeReader::~CompositeReader()
+{
+}
+
+bool TakeManager::CompositeReader::readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                                               juce::int64 startSampleInFile, int numSamples)
+{
+    auto* mix = reinterpret_cast<float*>(destChannels[0]) + startOffsetInDestBuffer;
+    juce::FloatVectorOperations::clear(mix, numSamples);
+
+    if (source.getNumSamples() < numSamples)
+        source.setSize(1, numSamples, false, false, true);
+
+    auto blockStart = startSampleInFile;
+    auto blockEnd = blockStart + numSamples;
+
+    for (auto& segment : segments)
+    {
+        // Each side of a crossfade plays on for the fade length past the hand-over
+        auto renderStart = juce::jmax(blockStart, segment.start - segment.fadeIn);
+        auto renderEnd = juce::jmin(blockEnd, segment.end + segment.fadeOut);
+
+        if (renderEnd <= renderStart)
+            continue;
+
+        auto& take = takes.getReference(segment.take);
+        auto numToRead = static_cast<int>(renderEnd - renderStart);
+        readers[static_cast<size_t>(segment.take)]->read(&source, 0, numToRead, renderStart - take.songStartSample, true, false);
+
+        auto* data = source.getWritePointer(0);
+
+        for (int i = 0; i < numToRead; ++i)
+        {
+            auto position = renderStart + i;
+
+            if (position < segment.start + segment.fadeIn)
+                data[i] *= static_cast<float>(position - (segment.start - segment.fadeIn)) / static_cast<float>(2 * segment.fadeIn);
+            else if (position >= segment.end - segment.fadeOut)
+                data[i] *= 1.0f - static_cast<float>(position - (segment.end - segment.fadeOut)) / static_cast<float>(2 * segment.fadeOut);
+        }
+
+        juce::FloatVectorOperations::add(mix + (renderStart - blockStart), data, numToRead);
+    }
+
+    for (int channel = 1; channel < numDestChannels; ++channel)
+        if (destChannels[channel] != nullptr)
+            juce::FloatVectorOperations::copy(reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer, mix, numSamples);
+
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Keeps every take recorded against a song in one append-only container file, and builds
+ * the composite vocal from them. Each take is a chunk holding a complete encoded audio file
+ * (WAV or FLAC) followed by its XML take info. Nothing already written is ever rewritten,
+ * so a crash mid-take loses at most that take.
+ *
+ * Takes are lanes on the song timeline: wherever they overlap the newest one wins, which
+ * is what makes punching in over a single chorus work.
+ */
+class TakeManager
+{
+public:
+    struct Take
+    {
+        int index = 0;
+        juce::int64 audioOffset = 0;        // Where the encoded audio starts inside the container
+        juce::int64 audioBytes = 0;
+        double sampleRate = 0.0;
+        juce::int64 songStartSample = 0;    // Song position of the first sample, in take samples
+        juce::int64 numSamples = 0;
+
+        juce::int64 getSongEndSample() const { return songStartSample + numSamples; }
+    };
+
+    explicit TakeManager(const juce::File& containerFile);
+    ~TakeManager();
+
+    const juce::File& getFile() const { return file; }
+    const juce::Array<Take>& getTakes() const { return takes; }
+    int getNumTakes() const { return takes.size(); }
+
+    // Opens a new chunk at the end of the container and returns the stream the take's audio
+    // writer should own. It reports positions relative to the start of the audio, so the
+    // writer can seek back to patch its header as if it had a file to itself.
+    std::unique_ptr<juce::OutputStream> beginTake();
+
+    // Call once the writer (and the stream it owned) has been destroyed
+    bool finishTake(const juce::XmlElement& takeInfo);
+    void abandonTake();
+
+    // Safe from any thread - only reads the container
+    static std::unique_ptr<juce::AudioFormatReader> createReaderFor(const juce::File& containerFile, const Take& take,
+                                                                    juce::AudioFormatManager& formatManager);
+
+    // The newest-take-wins composite as a mono float stream on the song timeline, starting at
+    // song position 0 and crossfading wherever one take hands over to another. Takes recorded
+    // at a different rate from the newest one are left out.
+    class CompositeReader : public juce::AudioFormatReader
+    {
+    public:
+        CompositeReader(const juce::File& containerFile, const juce::Array<Take>& takes, double crossfadeSeconds = 0.01);
+        ~CompositeReader() override;
+
+        bool isEmpty() const { return segments.empty(); }
+
+        bool readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                         juce::int64 startSampleInFile, int numSamples) override;
+
+    private:
+        // Where the composite switches from one take to another
+        struct Segment
+        {
+            juce::int64 start = 0, end = 0;
+            int take = 0;
+            juce::int64 fadeIn = 0, fadeOut = 0;
+        };
+
+        juce::Array<Take> takes;
+        std::vector<std::unique_ptr<juce::AudioFormatReader>> readers;
+        std::vector<Segment> segments;
+        juce::AudioBuffer<float> source;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompositeReader)
+    };
+
+    // Renders the composite as a float WAV. A TAKE sidecar is written next to it so the result
+    // can be mixed like any single take.
+    static bool renderComposite(const juce::File& containerFile, const juce::Array<Take>& takes,
+                                const juce::File& outputFile, double crossfadeSeconds = 0.01);
+
+private:
+    juce::File file;
+    juce::Array<Take> takes;
+
+    std::unique_ptr<juce::FileOutputStream> output;
+    juce::int64 chunkStart = -1;
+    juce::int64 validLength = 0;            // End of the last complete chunk
+
+    void scan();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TakeManager)
+};
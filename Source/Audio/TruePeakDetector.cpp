@@ -0,0 +1,71 @@
+#include "TruePeakDetector.h"
+
+namespace
+{
+    // BS.1770-4 Annex 2, one row per phase
+    constexpr float coefficients[TruePeakDetector::oversampling][TruePeakDetector::numTaps] =
+    {
+        {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+           0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+        { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+           0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+        { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+           0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+        { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+           0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+    };
+
+    constexpr int historyLength = TruePeakDetector::numTaps - 1;
+}
+
+TruePeakDetector::TruePeakDetector()
+{
+}
+
+TruePeakDetector::~TruePeakDetector()
+{
+}
+
+void TruePeakDetector::prepare(int numChannels, int newMaxBlockSize)
+{
+    maxBlockSize = newMaxBlockSize;
+    history.setSize(numChannels, historyLength + maxBlockSize);
+    phaseOutput.setSize(1, maxBlockSize);
+    reset();
+}
+
+void TruePeakDetector::reset()
+{
+    history.clear();
+}
+
+void TruePeakDetector::process(const float* const* data, int numChannels, int numSamples, float* peaks)
+{
+    jassert(numSamples <= maxBlockSize);
+
+    numChannels = juce::jmin(numChannels, history.getNumChannels());
+    juce::FloatVectorOperations::clear(peaks, numSamples);
+
+    auto* output = phaseOutput.getWritePointer(0);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* samples = history.getWritePointer(channel);
+        juce::FloatVectorOperations::copy(samples + historyLength, data[channel], numSamples);
+
+        // Output i of tap t reads the input t samples before the newest one, i.e. samples[i + historyLength - t]
+        for (int phase = 0; phase < oversampling; ++phase)
+        {
+            juce::FloatVectorOperations::copyWithMultiply(output, samples + historyLength, coefficients[phase][0], numSamples);
+
+            for (int tap = 1; tap < numTaps; ++tap)
+                juce::FloatVectorOperations::addWithMultiply(output, samples + historyLength - tap, coefficients[phase][tap], numSamples);
+
+            juce::FloatVectorOperations::abs(output, output, numSamples);
+            juce::FloatVectorOperations::max(peaks, peaks, output, numSamples);
+        }
+
+        // Keep the tail as history for the next block
+        std::memmove(samples, samples + numSamples, static_cast<size_t>(historyLength) * sizeof(float));
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Inter-sample peak estimate from 4x oversampling with the interpolation filter given in
+ * ITU-R BS.1770 Annex 2. Each oversampling phase is computed across a whole block at a time
+ * as a sum of scaled, shifted copies of the input, so the work is all vector operations.
+ */
+class TruePeakDetector
+{
+public:
+    static constexpr int oversampling = 4;
+    static constexpr int numTaps = 12;
+
+    // The interpolated points reported for input sample n lie between samples n - latency and
+    // n - latency + 1
+    static constexpr int latency = numTaps / 2;
+
+    TruePeakDetector();
+    ~TruePeakDetector();
+
+    void prepare(int numChannels, int maxBlockSize);
+    void reset();
+
+    // Writes the largest absolute interpolated value across channels for each input sample.
+    // numSamples must not exceed the prepared block size.
+    void process(const float* const* data, int numChannels, int numSamples, float* peaks);
+
+private:
+    int maxBlockSize = 0;
+    juce::AudioBuffer<float> history;   // Last numTaps - 1 samples per channel, then the block
+    juce::AudioBuffer<float> phaseOutput;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TruePeakDetector)
+};
@@ -0,0 +1,207 @@
+#include "VocalAligner.h"
+#include "CrossCorrelator.h"
+
+namespace
+{
+    // Segments whose onset envelope carries less energy than this are treated as silence
+    constexpr float minimumSegmentEnergy = 1.0e-3f;
+
+    void removeMean(std::vector<float>& data)
+    {
+        if (data.empty())
+            return;
+
+        double sum = 0.0;
+        for (auto value : data)
+            sum += value;
+
+        juce::FloatVectorOperations::add(data.data(), static_cast<float>(-sum / static_cast<double>(data.size())),
+                                         static_cast<int>(data.size()));
+    }
+
+    float getEnergy(const std::vector<float>& data)
+    {
+        float energy = 0.0f;
+        for (auto value : data)
+            energy += value * value;
+
+        return energy;
+    }
+}
+
+VocalAligner::VocalAligner(double maxLag, double segmentLength)
+    : maxLagSeconds(maxLag),
+      segmentSeconds(segmentLength)
+{
+}
+
+VocalAligner::~VocalAligner()
+{
+}
+
+VocalAligner::Result VocalAligner::align(juce::AudioFormatReader& recording, double recordingOffsetSeconds,
+                                         juce::AudioFormatReader& guide, const std::function<bool()>& shouldExit)
+{
+    Result result;
+
+    if (guide.sampleRate <= 0.0 || recording.sampleRate <= 0.0)
+        return result;
+
+    auto numFrames = static_cast<int>(guide.lengthInSamples / guide.sampleRate * frameRate);
+    auto maxLagFrames = static_cast<int>(maxLagSeconds * frameRate);
+    auto segmentFrames = juce::jmax(maxLagFrames * 4, static_cast<int>(segmentSeconds * frameRate));
+
+    if (numFrames <= maxLagFrames * 2)
+        return result;
+
+    // Both envelopes live on the song timeline, the recording shifted by its believed offset
+    auto guideEnvelope = computeOnsetEnvelope(guide, 0.0, numFrames);
+    auto recordingEnvelope = computeOnsetEnvelope(recording, recordingOffsetSeconds, numFrames);
+
+    if (shouldExit != nullptr && shouldExit())
+        return result;
+
+    auto numSegments = (numFrames + segmentFrames - 1) / segmentFrames;
+    auto curveLength = static_cast<size_t>(maxLagFrames * 2 + 1);
+    std::vector<std::vector<float>> curves(static_cast<size_t>(numSegments));
+
+    juce::ThreadPool pool(juce::ThreadPoolOptions{}
+                              .withThreadName("VocalAligner")
+                              .withNumberOfThreads(juce::jmin(numSegments, juce::SystemStats::getNumCpus())));
+
+    std::atomic<int> remaining { numSegments };
+    juce::WaitableEvent allDone;
+
+    for (int segment = 0; segment < numSegments; ++segment)
+    {
+        pool.addJob([&, segment]()
+        {
+            auto start = segment * segmentFrames;
+            auto end = juce::jmin(numFrames, start + segmentFrames);
+
+            std::vector<float> reference(guideEnvelope.begin() + start, guideEnvelope.begin() + end);
+            std::vector<float> signal(static_cast<size_t>(end - start + maxLagFrames * 2), 0.0f);
+
+            for (int i = 0; i < static_cast<int>(signal.size()); ++i)
+            {
+                auto frame = start - maxLagFrames + i;
+                if (frame >= 0 && frame < numFrames)
+                    signal[static_cast<size_t>(i)] = recordingEnvelope[static_cast<size_t>(frame)];
+            }
+
+            removeMean(reference);
+            removeMean(signal);
+
+            auto referenceEnergy = getEnergy(reference);
+            auto signalEnergy = getEnergy(signal);
+
+            // Instrumental passages or bars the user didn't sing carry no information
+            if (referenceEnergy > minimumSegmentEnergy && signalEnergy > minimumSegmentEnergy)
+            {
+                auto& curve = curves[static_cast<size_t>(segment)];
+                CrossCorrelator::computeCorrelation(signal.data(), static_cast<int>(signal.size()),
+                                                    reference.data(), static_cast<int>(reference.size()),
+                                                    0, maxLagFrames * 2, curve);
+
+                // JUCE's inverse FFT is normalised, so this puts every segment on a -1..1 scale
+                juce::FloatVectorOperations::multiply(curve.data(), 1.0f / std::sqrt(referenceEnergy * signalEnergy),
+                                                      static_cast<int>(curve.size()));
+            }
+
+            if (--remaining == 0)
+                allDone.signal();
+        });
+    }
+
+    allDone.wait();
+
+    std::vector<float> combined(curveLength, 0.0f);
+
+    for (auto& curve : curves)
+    {
+        if (curve.size() != curveLength)
+            continue;
+
+        juce::FloatVectorOperations::add(combined.data(), curve.data(), static_cast<int>(curveLength));
+        ++result.segmentsUsed;
+    }
+
+    if (result.segmentsUsed == 0)
+        return result;
+
+    auto best = static_cast<int>(std::max_element(combined.begin(), combined.end()) - combined.begin());
+
+    // Parabolic interpolation around the peak for sub-frame (i.e. sample level) precision
+    auto offset = 0.0;
+    if (best > 0 && best < static_cast<int>(curveLength) - 1)
+    {
+        auto left = combined[static_cast<size_t>(best - 1)];
+        auto centre = combined[static_cast<size_t>(best)];
+        auto right = combined[static_cast<size_t>(best + 1)];
+        auto denominator = left - 2.0f * centre + right;
+
+        if (denominator < 0.0f)
+            offset = 0.5 * (left - right) / denominator;
+    }
+
+    result.lagSeconds = (best + offset - maxLagFrames) / frameRate;
+    result.confidence = juce::jlimit(0.0f, 1.0f, combined[static_cast<size_t>(best)] / result.segmentsUsed);
+    result.found = true;
+
+    return result;
+}
+
+std::vector<float> VocalAligner::computeOnsetEnvelope(juce::AudioFormatReader& reader, double offsetSeconds, int numFrames)
+{
+    std::vector<float> energy(static_cast<size_t>(numFrames), 0.0f);
+
+    const int blockSize = 65536;
+    juce::AudioBuffer<float> block(static_cast<int>(juce::jmax(1u, reader.numChannels)), blockSize);
+
+    // Accumulate the energy of every sample into the 1 ms song frame it lands in
+    for (juce::int64 position = 0; position < reader.lengthInSamples; position += blockSize)
+    {
+        auto numSamples = static_cast<int>(juce::jmin<juce::int64>(blockSize, reader.lengthInSamples - position));
+        reader.read(&block, 0, numSamples, position, true, true);
+
+        auto* mono = block.getWritePointer(0);
+        for (int channel = 1; channel < block.getNumChannels(); ++channel)
+            juce::FloatVectorOperations::add(mono, block.getReadPointer(channel), numSamples);
+
+        juce::FloatVectorOperations::multiply(mono, mono, numSamples);
+
+        auto firstFrameTime = (static_cast<double>(position) / reader.sampleRate + offsetSeconds) * frameRate;
+        auto framesPerSample = frameRate / reader.sampleRate;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto frame = static_cast<int>(std::floor(firstFrameTime + i * framesPerSample));
+            if (frame >= 0 && frame < numFrames)
+                energy[static_cast<size_t>(frame)] += mono[i];
+        }
+    }
+
+    // Log energy (floored around -60 dB so digital silence doesn't create huge onsets),
+    // smoothed over 10 ms, then the half-wave rectified rise over 5 ms
+    const int smoothing = 10;
+    const int riseFrames = 5;
+    std::vector<float> smoothed(energy.size(), 0.0f);
+    double runningSum = 0.0;
+
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        runningSum += std::log10(energy[static_cast<size_t>(frame)] + 1.0e-6f);
+        if (frame >= smoothing)
+            runningSum -= std::log10(energy[static_cast<size_t>(frame - smoothing)] + 1.0e-6f);
+
+        smoothed[static_cast<size_t>(frame)] = static_cast<float>(runningSum / smoothing);
+    }
+
+    std::vector<float> onsets(energy.size(), 0.0f);
+
+    for (int frame = riseFrames; frame < numFrames; ++frame)
+        onsets[static_cast<size_t>(frame)] = juce::jmax(0.0f, smoothed[static_cast<size_t>(frame)]
+                                                              - smoothed[static_cast<size_t>(frame - riseFrames)]);
+
+    return onsets;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Finds how far a recorded vocal sits from the original singer by cross-correlating
+ * the two against each other. The user doesn't sound like the guide vocal, so rather
+ * than raw waveforms it compares onset envelopes (1 ms frames), segment by segment on
+ * a thread pool, and sums the per-segment correlation curves into one estimate.
+ */
+class VocalAligner
+{
+public:
+    struct Result
+    {
+        double lagSeconds = 0.0;    // How late the recording is against the guide
+        float confidence = 0.0f;    // Mean normalised correlation at the lag, 0..1
+        int segmentsUsed = 0;
+        bool found = false;
+    };
+
+    VocalAligner(double maxLagSeconds = 0.5, double segmentSeconds = 20.0);
+    ~VocalAligner();
+
+    // recordingOffsetSeconds is where the recording is believed to start on the song timeline
+    Result align(juce::AudioFormatReader& recording, double recordingOffsetSeconds,
+                 juce::AudioFormatReader& guide, const std::function<bool()>& shouldExit = nullptr);
+
+private:
+    double maxLagSeconds;
+    double segmentSeconds;
+
+    static constexpr double frameRate = 1000.0;
+
+    static std::vector<float> computeOnsetEnvelope(juce::AudioFormatReader& reader, double offsetSeconds, int numFrames);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VocalAligner)
+};
@@ -1,11 +1,86 @@
 #include "VocalMixer.h"
+#include "VocalAligner.h"
+#include "MixRenderCache.h"
+#include "IntermediateAudio.h"
 
-VocalMixer::VocalMixer(const juce::File& recordingFile, const juce::File& karaokeFile, const juce::File& outputFile, int bufferSize)
+namespace
+{
+    // Extra audio rendered either side of a segment and then cut away, so the limiter has
+    // settled by the time the part we keep begins. Its release is the only state that outlasts
+    // the audio that caused it, and however far a fresh start is from a single pass, the gap
+    // shrinks by a factor of e every release time - fourteen of them leave it under -120 dB.
+    constexpr double segmentMarginSeconds = 14.0 * PeakLimiter::defaultReleaseMs / 1000.0;
+
+    // Same target as the old single-pass loudnorm chain
+    constexpr double targetLoudness = -13.0;
+    
+    // A weak match usually means the user sang something else entirely - trust the clock instead
+    constexpr float minimumAlignmentConfidence = 0.2f;
+    
+    // Changes whenever the file is replaced
+    juce::String getFileId(const juce::File& file)
+    {
+        return file.getFullPathName() + ":" + juce::String(file.getSize()) + ":"
+               + juce::String(file.getLastModificationTime().toMilliseconds());
+    }
+    
+    // Identifies a take within its container, which is only ever appended to
+    juce::String getTakeId(const TakeManager::Take& take)
+    {
+        return juce::String(take.audioOffset) + ":" + juce::String(take.audioBytes) + ":"
+               + juce::String(take.songStartSample) + ":" + juce::String(take.numSamples);
+    }
+
+    // Gives a loudness or render worker its own readers, since a reader can only be used
+    // from one thread
+    struct MixWorker : public LoudnessAnalyser::Source,
+                       public ChunkedRenderer::Processor
+    {
+        MixWorker(std::unique_ptr<juce::AudioFormatReader> karaokeReader, std::unique_ptr<juce::AudioFormatReader> vocalReader,
+                  juce::int64 vocalOffsetSamples)
+            : karaoke(std::move(karaokeReader)),
+              vocals(std::move(vocalReader)),
+              engine(*karaoke, *vocals, vocalOffsetSamples)
+        {
+        }
+
+        void read(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples) override
+        {
+            engine.read(buffer, startSample, numSamples);
+        }
+
+        void reset() override { engine.reset(); }
+
+        void process(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples) override
+        {
+            engine.process(buffer, startSample, numSamples);
+        }
+
+        int getLatencySamples() const override { return engine.getLatencySamples(); }
+
+        std::unique_ptr<juce::AudioFormatReader> karaoke, vocals;
+        MixEngine engine;
+    };
+
+    // Both inputs are float intermediates, so the workers share one mapping of each
+    std::unique_ptr<MixWorker> createMixWorker(const juce::File& karaokeFile, const juce::File& recordingFile,
+                                               juce::int64 vocalOffsetSamples)
+    {
+        auto karaoke = IntermediateAudio::createReader(karaokeFile);
+        auto vocals = IntermediateAudio::createReader(recordingFile);
+        
+        if (karaoke == nullptr || vocals == nullptr)
+            return nullptr;
+        
+        return std::make_unique<MixWorker>(std::move(karaoke), std::move(vocals), vocalOffsetSamples);
+    }
+}
+
+VocalMixer::VocalMixer(const juce::File& recordingFile, const juce::File& karaokeFile, const juce::File& outputFile)
     : Thread("VocalMixer"),
       recordingFile(recordingFile),
       karaokeFile(karaokeFile),
-      outputFile(outputFile),
-      bufferSizeForLatencyComp(bufferSize)
+      outputFile(outputFile)
 {
     updateProgress(0.0, "Initializing vocal mixer...");
 }
@@ -16,15 +91,23 @@ VocalMixer::~VocalMixer()
 
 void VocalMixer::run()
 {
-    updateProgress(0.1, "Checking FFmpeg availability...");
-    
-    if (!checkFFmpegAvailability())
+    if (!takes.isEmpty())
     {
-        if (onMixingComplete)
-            onMixingComplete(false, "FFmpeg is not available. Please install FFmpeg:\n\n"
-                                  "brew install ffmpeg\n\n"
-                                  "FFmpeg is required to mix your vocals with the karaoke track.");
-        return;
+        // Each take is moved into line on its own before they're painted together, so the
+        // composite - and every cached section of the mix - only changes where a take did
+        alignTakesToGuideVocal();
+        
+        if (threadShouldExit())
+            return;
+        
+        updateProgress(0.15, "Assembling " + juce::String(takes.size()) + (takes.size() == 1 ? " take..." : " takes..."));
+        
+        if (!TakeManager::renderComposite(takesFile, takes, recordingFile))
+        {
+            if (onMixingComplete)
+                onMixingComplete(false, "Failed to assemble the recorded takes from " + takesFile.getFullPathName());
+            return;
+        }
     }
     
     updateProgress(0.2, "Verifying input files...");
@@ -46,12 +129,19 @@ void VocalMixer::run()
     
     updateProgress(0.3, "Preparing audio mixing...");
     
-    // Trim audio files for latency compensation
-    if (!trimAudioFilesForLatency())
+    // Place the take against the song using the offset stored with it
+    if (!loadTakeAlignment())
     {
-        return; // Error already reported in trimAudioFilesForLatency
+        return; // Error already reported in loadTakeAlignment
     }
     
+    // Fine-tune the placement against the original singer. Takes were lined up one by one already.
+    if (takes.isEmpty())
+        alignToGuideVocal();
+    
+    if (threadShouldExit())
+        return;
+    
     // Create output directory if it doesn't exist
     auto outputDir = outputFile.getParentDirectory();
     if (!outputDir.exists())
@@ -64,15 +154,8 @@ void VocalMixer::run()
         }
     }
     
-    updateProgress(0.4, "Building mixing command...");
-    
-    juce::String command = buildMixingCommand();
-    
-    if (threadShouldExit())
-        return;
-    
-    updateProgress(0.5, "Mixing vocals with karaoke track...");
-    bool success = executeMixingCommand(command);
+    updateProgress(0.4, "Mixing vocals with karaoke track...");
+    bool success = renderMix();
     
     if (threadShouldExit())
         return;
@@ -85,130 +168,207 @@ void VocalMixer::run()
     }
 }
 
-bool VocalMixer::checkFFmpegAvailability()
+bool VocalMixer::renderMix()
 {
-    juce::ChildProcess process;
+    auto vocals = IntermediateAudio::createReader(recordingFile);
+    auto karaoke = IntermediateAudio::createReader(karaokeFile);
     
-    if (process.start("ffmpeg -version"))
+    if (!vocals || !karaoke)
     {
-        process.waitForProcessToFinish(5000); // Wait up to 5 seconds
-        return process.getExitCode() == 0;
+        if (onMixingComplete)
+            onMixingComplete(false, "Failed to read the vocal or karaoke track");
+        return false;
     }
     
-    return false;
-}
-
-juce::String VocalMixer::buildMixingCommand()
-{
-    juce::StringArray args;
-    args.add("ffmpeg");
+    // The previous render lives next to the output, one set of segments per song
+    auto backingTrackId = getFileId(karaokeFile);
+    
+    MixRenderCache cache(outputFile.getParentDirectory().getChildFile("mix_cache"), karaoke->sampleRate);
+    cache.load(backingTrackId);
+    
+    // Loudness is measured over the whole song once per backing track. After that the gain
+    // stays put, so a punch-in doesn't shift the level of everything around it.
+    if (!cache.hasGain())
+    {
+        updateProgress(0.45, "Measuring loudness...");
+        
+        double measuredGainDb = 0.0;
+        if (!measureLoudness(karaoke->sampleRate, karaoke->lengthInSamples, measuredGainDb))
+            return false;
+        
+        cache.setGainDb(measuredGainDb);
+    }
+    
+    // A segment's content is the exact stretch of vocal that ends up in it (margins included),
+    // plus where it sits and how loud the mix is. The alignment is already in the composite,
+    // so its offset only moves when the takes themselves are placed differently.
+    auto vocalOffsetSeconds = static_cast<double>(vocalOffsetSamples) / vocals->sampleRate;
+    auto marginSeconds = segmentMarginSeconds;
     
-    // Input files
-    args.add("-i"); args.add(recordingFile.getFullPathName());   // User vocals
-    args.add("-i"); args.add(karaokeFile.getFullPathName());     // Karaoke track
+    auto hashSegment = [&](juce::int64 startSample, juce::int64 numSamples) -> juce::String
+    {
+        auto startSeconds = static_cast<double>(startSample) / karaoke->sampleRate - marginSeconds - vocalOffsetSeconds;
+        auto lengthSeconds = static_cast<double>(numSamples) / karaoke->sampleRate + 2.0 * marginSeconds;
+        auto vocalStart = static_cast<juce::int64>(std::floor(startSeconds * vocals->sampleRate));
+        auto vocalLength = static_cast<int>(std::ceil(lengthSeconds * vocals->sampleRate));
+        
+        juce::AudioBuffer<float> vocalData(static_cast<int>(vocals->numChannels), vocalLength);
+        vocals->read(&vocalData, 0, vocalLength, vocalStart, true, true);
+        
+        juce::MemoryOutputStream key;
+        key << juce::String(vocalOffsetSamples) << ":" << juce::String(cache.getGainDb(), 6) << ":"
+            << juce::String(startSample) << ":" << juce::String(numSamples) << ":";
+        
+        for (int channel = 0; channel < vocalData.getNumChannels(); ++channel)
+            key.write(vocalData.getReadPointer(channel), static_cast<size_t>(vocalLength) * sizeof(float));
+        
+        return juce::MD5(key.getData(), key.getDataSize()).toHexString();
+    };
     
-    // Audio filter to mix the two inputs with volume adjustment
-    // Convert mono vocals to stereo, maintain karaoke at full volume, vocals at full level
-    args.add("-filter_complex");
-    args.add("[0:a]volume=1.0,pan=stereo|c0=c0|c1=c0[vocals_stereo];[1:a]volume=1.0[karaoke];[vocals_stereo][karaoke]amix=inputs=2:duration=longest:dropout_transition=3,loudnorm=I=-13:LRA=11:TP=-1.5");
+    auto segments = cache.plan(karaoke->lengthInSamples, hashSegment);
     
-    // Output settings
-    args.add("-c:a"); args.add("mp3");
-    args.add("-b:a"); args.add("320k");
-    args.add("-ac"); args.add("2"); // Force stereo output
-    args.add("-y"); // Overwrite output file if it exists
+    juce::Array<MixRenderCache::Segment> dirty;
+    for (auto& segment : segments)
+        if (!cache.isUpToDate(segment))
+            dirty.add(segment);
     
-    // Output file
-    args.add(outputFile.getFullPathName());
+    juce::Logger::writeToLog("Mix render: " + juce::String(dirty.size()) + " of " + juce::String(segments.size())
+                             + " segments need rendering");
     
-    return args.joinIntoString(" ");
-}
-
-bool VocalMixer::executeMixingCommand(const juce::String& command)
-{
-    juce::ChildProcess process;
+    // The changed segments are rendered side by side, each on a worker with its own readers,
+    // and written out in order as they finish
+    juce::Array<ChunkedRenderer::Chunk> chunks;
+    for (auto& segment : dirty)
+        chunks.add({ segment.startSample, segment.numSamples });
     
-    updateProgress(0.6, "Starting FFmpeg mixing process...");
+    auto gainDb = cache.getGainDb();
+    auto sampleRate = karaoke->sampleRate;
     
-    if (!process.start(command))
+    auto createProcessor = [this, gainDb]() -> std::unique_ptr<ChunkedRenderer::Processor>
     {
-        updateProgress(0.6, "Failed to start FFmpeg");
-        if (onMixingComplete)
-            onMixingComplete(false, "Failed to start FFmpeg mixing process");
-        return false;
-    }
+        auto worker = createMixWorker(karaokeFile, recordingFile, vocalOffsetSamples);
+        
+        if (worker != nullptr)
+            worker->engine.setGainDb(gainDb);
+        
+        return worker;
+    };
     
-    // Monitor the process with progress updates
-    int timeoutMs = 60000; // 1 minute timeout
-    int elapsedMs = 0;
-    int checkIntervalMs = 1000; // Check every 1 second
+    juce::File failedSegment;
     
-    while (process.isRunning() && elapsedMs < timeoutMs)
+    auto storeSegment = [&](int index, const juce::AudioBuffer<float>& audio)
     {
-        if (threadShouldExit())
+        if (!writeSegment(dirty.getReference(index), audio, sampleRate))
         {
-            process.kill();
+            failedSegment = dirty[index].file;
             return false;
         }
         
-        // Update progress based on elapsed time (rough estimation)
-        double progress = 0.6 + (0.3 * static_cast<double>(elapsedMs) / timeoutMs);
-        updateProgress(juce::jmin(progress, 0.9), "Mixing audio... (" + juce::String(elapsedMs / 1000) + "s)");
-        
-        juce::Thread::sleep(checkIntervalMs);
-        elapsedMs += checkIntervalMs;
-    }
-    
-    if (process.isRunning())
+        cache.markRendered(dirty[index]);
+        return true;
+    };
+    
+    // The limiter runs over the margin before each segment and has all but caught up with a
+    // single pass by the part we keep
+    auto warmupSamples = static_cast<juce::int64>(segmentMarginSeconds * sampleRate);
+    auto numDirty = dirty.size();
+    
+    updateProgress(0.5, "Mixing " + juce::String(numDirty) + (numDirty == 1 ? " section..." : " sections..."));
+    
+    if (!ChunkedRenderer::render(chunks, 2, warmupSamples, createProcessor, storeSegment,
+                                 [this]() { return threadShouldExit(); },
+                                 [this, numDirty](double progress)
+                                 {
+                                     updateProgress(0.5 + 0.4 * progress,
+                                                    "Mixed " + juce::String(juce::roundToInt(progress * numDirty)) + " of "
+                                                    + juce::String(numDirty) + " sections...");
+                                 }))
     {
-        process.kill();
-        updateProgress(0.9, "Mixing process timed out");
+        if (threadShouldExit())
+            return false;
+        
         if (onMixingComplete)
-            onMixingComplete(false, "Audio mixing process timed out");
+            onMixingComplete(false, failedSegment != juce::File() ? "Failed to write mix section " + failedSegment.getFullPathName()
+                                                                   : juce::String("Failed to render the mix"));
         return false;
     }
     
-    int exitCode = process.getExitCode();
+    cache.save();
     
-    updateProgress(0.95, "FFmpeg finished with exit code: " + juce::String(exitCode));
+    updateProgress(0.95, "Assembling mix...");
     
-    if (exitCode != 0)
+    // The mix stays float - it's only encoded when it's exported
+    if (!cache.assemble(segments, outputFile, IntermediateAudio::bitsPerSample))
     {
-        juce::String errorOutput = process.readAllProcessOutput();
         if (onMixingComplete)
-        {
-            juce::String errorMsg = "FFmpeg failed to mix audio (exit code " + juce::String(exitCode) + "):\n\n";
-            errorMsg += errorOutput;
-            onMixingComplete(false, errorMsg);
-        }
+            onMixingComplete(false, "Output file was not created successfully");
         return false;
     }
     
-    // Verify the output file was created
-    if (!outputFile.exists())
+    return true;
+}
+
+bool VocalMixer::measureLoudness(double sampleRate, juce::int64 lengthInSamples, double& gainDb)
+{
+    // One analysis pass over the unnormalised mix, the same one the segments render, split
+    // across cores
+    auto createSource = [this]() -> std::unique_ptr<LoudnessAnalyser::Source>
+    {
+        return createMixWorker(karaokeFile, recordingFile, vocalOffsetSamples);
+    };
+    
+    LoudnessAnalyser::Result loudness;
+    if (!LoudnessAnalyser::analyse(sampleRate, 2, lengthInSamples, createSource, loudness,
+                                   [this]() { return threadShouldExit(); }))
     {
-        if (onMixingComplete)
-            onMixingComplete(false, "Output file was not created successfully");
+        if (!threadShouldExit() && onMixingComplete)
+            onMixingComplete(false, "Failed to measure the loudness of the mix");
         return false;
     }
     
-    updateProgress(1.0, "Vocal mixing successful");
+    if (!std::isfinite(loudness.integratedLoudness))
+    {
+        // Silence measures as -inf - leave the level alone rather than boosting noise
+        gainDb = 0.0;
+        return true;
+    }
+    
+    gainDb = targetLoudness - loudness.integratedLoudness;
+    juce::Logger::writeToLog("Mix loudness " + juce::String(loudness.integratedLoudness, 2) + " LUFS, true peak "
+                             + juce::String(juce::Decibels::gainToDecibels(loudness.truePeak), 2) + " dBTP, applying "
+                             + juce::String(gainDb, 2) + " dB");
     return true;
 }
 
+bool VocalMixer::writeSegment(const MixRenderCache::Segment& segment, const juce::AudioBuffer<float>& audio, double sampleRate)
+{
+    auto writer = IntermediateAudio::createWriter(segment.file, sampleRate, 2);
+    
+    if (writer == nullptr)
+        return false;
+    
+    auto written = writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples());
+    writer.reset();
+    
+    if (!written)
+        segment.file.deleteFile();
+    
+    return written;
+}
+
 void VocalMixer::updateProgress(double progress, const juce::String& message)
 {
     if (onProgressUpdate)
     {
-        juce::MessageManager::callAsync([this, progress, message]() {
-            onProgressUpdate(progress, message);
+        // The callback goes by copy, as the mixer may be gone by the time it runs
+        juce::MessageManager::callAsync([callback = onProgressUpdate, progress, message]() {
+            callback(progress, message);
         });
     }
 }
 
-bool VocalMixer::trimAudioFilesForLatency()
+bool VocalMixer::loadTakeAlignment()
 {
-    // Get sample rate from the recording file using JUCE
     juce::AudioFormatManager formatManager;
     formatManager.registerBasicFormats();
     
@@ -220,53 +380,141 @@ bool VocalMixer::trimAudioFilesForLatency()
         return false;
     }
     
-    double sampleRate = reader->sampleRate;
-    
-    // Create trimmed recording file (remove first 100ms)
-    juce::File trimmedRecording = trimAudioFile(recordingFile, sampleRate);
-    if (!trimmedRecording.exists())
+    // The recorder stores the take's position on the song timeline next to the audio
+    auto takeInfo = juce::parseXML(recordingFile.withFileExtension("xml"));
+    if (takeInfo == nullptr || !takeInfo->hasTagName("TAKE"))
     {
-        if (onMixingComplete)
-            onMixingComplete(false, "Failed to trim recording file for latency compensation");
-        return false;
+        juce::Logger::writeToLog("No take info for " + recordingFile.getFileName() + ", mixing without offset");
+        vocalOffsetSamples = 0;
+        return true;
     }
     
-    // Update file reference for mixing
-    recordingFile = trimmedRecording;
+    vocalOffsetSamples = takeInfo->getStringAttribute("songStartSample").getLargeIntValue();
+    
+    // Offsets are stored in recording samples - rescale if the file was converted since
+    auto takeSampleRate = takeInfo->getDoubleAttribute("sampleRate", reader->sampleRate);
+    if (takeSampleRate > 0.0 && takeSampleRate != reader->sampleRate)
+        vocalOffsetSamples = static_cast<juce::int64>(std::llround(vocalOffsetSamples * reader->sampleRate / takeSampleRate));
     
     return true;
 }
 
-juce::File VocalMixer::trimAudioFile(const juce::File& inputFile, double sampleRate)
+void VocalMixer::alignToGuideVocal()
 {
-    juce::String suffix = "_trim100ms";
+    if (guideVocal == nullptr)
+        return;
+    
+    updateProgress(0.35, "Aligning vocals with the original singer...");
     
-    juce::File outputFile = inputFile.getParentDirectory()
-                              .getChildFile(inputFile.getFileNameWithoutExtension() + suffix + 
-                                          "." + inputFile.getFileExtension());
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
     
-    juce::StringArray args;
-    args.add("ffmpeg");
-    args.add("-i"); args.add(inputFile.getFullPathName());
-    args.add("-af"); args.add("atrim=start=0.1"); // Trim first 100ms
+    std::unique_ptr<juce::AudioFormatReader> recording(formatManager.createReaderFor(recordingFile));
+    
+    if (!recording)
+        return;
+    
+    auto lag = measureGuideLag(*recording, vocalOffsetSamples);
+    reportGuideLag(lag);
+    vocalOffsetSamples -= lag.samples;
+}
+
+void VocalMixer::alignTakesToGuideVocal()
+{
+    if (guideVocal == nullptr)
+        return;
     
-    // Output settings - maintain same format as input
-    args.add("-c:a"); args.add("pcm_s16le"); // Use PCM for precision
-    args.add("-y"); // Overwrite
-    args.add(outputFile.getFullPathName());
+    // Each take is measured once against a given guide and its lag kept next to the container,
+    // so a punch-in only costs aligning the new take. The guide comes with the karaoke track,
+    // so new stems start the list again.
+    auto alignmentFile = takesFile.withFileExtension("alignment");
+    auto guideId = getFileId(karaokeFile);
+    auto alignment = juce::parseXML(alignmentFile);
     
-    juce::ChildProcess process;
-    if (!process.start(args.joinIntoString(" ")))
+    if (alignment == nullptr || !alignment->hasTagName("ALIGNMENT") || alignment->getStringAttribute("guide") != guideId)
     {
-        return juce::File();
+        alignment = std::make_unique<juce::XmlElement>("ALIGNMENT");
+        alignment->setAttribute("guide", guideId);
     }
     
-    process.waitForProcessToFinish(30000); // 30 second timeout
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
     
-    if (process.getExitCode() != 0 || !outputFile.exists())
+    auto numMeasured = 0;
+    
+    for (int i = 0; i < takes.size(); ++i)
     {
-        return juce::File();
+        auto& take = takes.getReference(i);
+        auto* entry = alignment->getChildByAttribute("take", getTakeId(take));
+        
+        if (entry == nullptr)
+        {
+            auto reader = TakeManager::createReaderFor(takesFile, take, formatManager);
+            
+            if (reader == nullptr)
+                continue;
+            
+            updateProgress(0.1, "Aligning takes with the original singer...");
+            auto lag = measureGuideLag(*reader, take.songStartSample);
+            
+            // A measurement cut short isn't one to keep
+            if (threadShouldExit())
+                return;
+            
+            entry = alignment->createNewChildElement("TAKE");
+            entry->setAttribute("take", getTakeId(take));
+            entry->setAttribute("lagSamples", juce::String(lag.samples));
+            entry->setAttribute("lagSeconds", lag.seconds);
+            entry->setAttribute("confidence", lag.confidence);
+            entry->setAttribute("applied", lag.applied);
+            ++numMeasured;
+        }
+        
+        take.songStartSample -= entry->getStringAttribute("lagSamples").getLargeIntValue();
+        
+        // Only the newest take is reported, whether it was measured just now or earlier
+        if (i == takes.size() - 1)
+        {
+            GuideLag newest;
+            newest.seconds = entry->getDoubleAttribute("lagSeconds");
+            newest.confidence = static_cast<float>(entry->getDoubleAttribute("confidence"));
+            newest.applied = entry->getBoolAttribute("applied");
+            reportGuideLag(newest);
+        }
     }
     
-    return outputFile;
-}
\ No newline at end of file
+    if (numMeasured > 0 && !alignment->writeTo(alignmentFile))
+        juce::Logger::writeToLog("Could not store take alignment in " + alignmentFile.getFullPathName());
+}
+
+VocalMixer::GuideLag VocalMixer::measureGuideLag(juce::AudioFormatReader& vocal, juce::int64 songStartSample)
+{
+    VocalAligner aligner;
+    auto result = aligner.align(vocal, static_cast<double>(songStartSample) / vocal.sampleRate, *guideVocal,
+                                [this]() { return threadShouldExit(); });
+    
+    GuideLag lag;
+    lag.seconds = result.lagSeconds;
+    lag.confidence = result.confidence;
+    lag.applied = result.found && result.confidence >= minimumAlignmentConfidence;
+    
+    if (lag.applied)
+        lag.samples = static_cast<juce::int64>(std::llround(result.lagSeconds * vocal.sampleRate));
+    
+    juce::Logger::writeToLog("Vocal alignment: lag " + juce::String(result.lagSeconds * 1000.0, 2) + " ms, confidence "
+                             + juce::String(result.confidence, 2) + " over " + juce::String(result.segmentsUsed)
+                             + " segments" + (lag.applied ? "" : " (not applied)"));
+    
+    return lag;
+}
+
+void VocalMixer::reportGuideLag(const GuideLag& lag)
+{
+    if (onAlignmentDetected)
+    {
+        // The callback goes by copy, as the mixer may be gone by the time it runs
+        juce::MessageManager::callAsync([callback = onAlignmentDetected, lag]() {
+            callback(lag.seconds, lag.confidence, lag.applied);
+        });
+    }
+}
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "TakeManager.h"
+#include "MixRenderCache.h"
+#include "MixEngine.h"
+#include "ChunkedRenderer.h"
 
 class VocalMixer : public juce::Thread
 {
 public:
-    VocalMixer(const juce::File& recordingFile, const juce::File& karaokeFile, const juce::File& outputFile, int bufferSize);
+    VocalMixer(const juce::File& recordingFile, const juce::File& karaokeFile, const juce::File& outputFile);
     ~VocalMixer() override;
     
     void run() override;
@@ -13,17 +17,50 @@ public:
     std::function<void(bool success, const juce::String& message)> onMixingComplete;
     std::function<void(double progress, const juce::String& statusMessage)> onProgressUpdate;
     
+    // Detected timing of the take against the original singer. Called on the message thread
+    std::function<void(double lagSeconds, float confidence, bool applied)> onAlignmentDetected;
+    
+    // Separated vocal stem of the original song, used to auto-align the take
+    void setGuideVocal(std::unique_ptr<juce::AudioFormatReader> reader) { guideVocal = std::move(reader); }
+    
+    // Renders these takes into the recording file before mixing, instead of using it as-is
+    void setTakes(const juce::File& containerFile, const juce::Array<TakeManager::Take>& takesToMix)
+    {
+        takesFile = containerFile;
+        takes = takesToMix;
+    }
+    
 private:
     juce::File recordingFile;
     juce::File karaokeFile;
     juce::File outputFile;
-    int bufferSizeForLatencyComp;
+    std::unique_ptr<juce::AudioFormatReader> guideVocal;
+    juce::File takesFile;
+    juce::Array<TakeManager::Take> takes;
+    
+    // Song position of the first recorded sample, in recording samples (negative = recorded early)
+    juce::int64 vocalOffsetSamples = 0;
+    
+    bool loadTakeAlignment();
+    void alignToGuideVocal();
+    void alignTakesToGuideVocal();
+    
+    // How late a vocal is against the original singer
+    struct GuideLag
+    {
+        juce::int64 samples = 0;    // In the vocal's own samples. 0 without a confident match.
+        double seconds = 0.0;
+        float confidence = 0.0f;
+        bool applied = false;
+    };
+    
+    GuideLag measureGuideLag(juce::AudioFormatReader& vocal, juce::int64 songStartSample);
+    void reportGuideLag(const GuideLag& lag);
     
-    bool checkFFmpegAvailability();
-    juce::String buildMixingCommand();
-    bool executeMixingCommand(const juce::String& command);
-    bool trimAudioFilesForLatency();
-    juce::File trimAudioFile(const juce::File& inputFile, double sampleRate);
+    // Re-renders only the parts of the mix whose vocal changed since last time
+    bool renderMix();
+    bool measureLoudness(double sampleRate, juce::int64 lengthInSamples, double& gainDb);
+    bool writeSegment(const MixRenderCache::Segment& segment, const juce::AudioBuffer<float>& audio, double sampleRate);
     
     void updateProgress(double progress, const juce::String& message);
     
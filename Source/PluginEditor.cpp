@@ -53,6 +53,49 @@ LucidkaraokeAudioProcessorEditor::LucidkaraokeAudioProcessorEditor (Lucidkaraoke
     };
     addAndMakeVisible(sourceToggleButton.get());
 
+    calibrateButton = std::make_unique<juce::TextButton>("CALIBRATE");
+    calibrateButton->setTooltip("Measure the round-trip latency of your audio interface");
+    calibrateButton->onClick = [this]() {
+        if (audioProcessor.startLatencyCalibration())
+        {
+            calibrationPending = true;
+            progressBar->reset();
+            progressBar->setWaitingState(true);
+            progressBar->setStatusText("Measuring latency - keep the microphone near the speakers...");
+        }
+    };
+    addAndMakeVisible(calibrateButton.get());
+
+    // Only the standalone app owns a device it could share with the recorder
+    duplexButton = std::make_unique<juce::TextButton>("DUPLEX");
+    duplexButton->setTooltip("Record from the playback device when it supports input and output together");
+    duplexButton->setClickingTogglesState(true);
+    duplexButton->setToggleState(audioProcessor.getRecordingSource() == LucidkaraokeAudioProcessor::RecordingSource::SharedDevice,
+                                 juce::dontSendNotification);
+    duplexButton->onClick = [this]() {
+        audioProcessor.setRecordingSource(duplexButton->getToggleState()
+                                              ? LucidkaraokeAudioProcessor::RecordingSource::SharedDevice
+                                              : LucidkaraokeAudioProcessor::RecordingSource::SeparateDevice);
+    };
+    addChildComponent(duplexButton.get());
+    duplexButton->setVisible(audioProcessor.wrapperType == juce::AudioProcessor::wrapperType_Standalone);
+
+    // The mix is kept lossless - it's only encoded when it's exported
+    exportButton = std::make_unique<juce::TextButton>("EXPORT");
+    exportButton->setTooltip("Save the mix as WAV, FLAC, Ogg Vorbis or MP3");
+    exportButton->onClick = [this]() {
+        chooseExportCodec();
+    };
+    addAndMakeVisible(exportButton.get());
+
+    // Preferences that don't need a control of their own
+    settingsButton = std::make_unique<juce::TextButton>("SETTINGS");
+    settingsButton->setTooltip("How takes are recorded and played back");
+    settingsButton->onClick = [this]() {
+        showSettingsMenu();
+    };
+    addAndMakeVisible(settingsButton.get());
+
     startTimer(50);
 
     setSize (600, 600);
@@ -101,7 +144,12 @@ void LucidkaraokeAudioProcessorEditor::promptForServiceUrl()
 LucidkaraokeAudioProcessorEditor::~LucidkaraokeAudioProcessorEditor()
 {
     audioProcessor.removeChangeListener(this);
+    audioProcessor.getStorageManager().release(currentStemOutputDir);
     stopTimer();
+    
+    // Stops ffmpeg too, if it's encoding
+    if (exportJob != nullptr)
+        exportJob->stopThread(5000);
     setLookAndFeel(nullptr);
 }
 
@@ -148,6 +196,10 @@ void LucidkaraokeAudioProcessorEditor::resized()
     // Progress bar below load button, above waveform (increased height for status text)
     auto progressHeight = 32;
     auto progressBounds = bounds.removeFromTop(progressHeight);
+    exportButton->setBounds(progressBounds.removeFromRight(90));
+    progressBounds.removeFromRight(margin / 2);
+    settingsButton->setBounds(progressBounds.removeFromRight(90));
+    progressBounds.removeFromRight(margin / 2);
     progressBar->setBounds(progressBounds);
     
     bounds.removeFromTop(margin);
@@ -168,12 +220,23 @@ void LucidkaraokeAudioProcessorEditor::resized()
     auto toggleX = getWidth() - toggleWidth - rightMargin;
     auto toggleY = transportBounds.getCentreY() - toggleHeight / 2;
     sourceToggleButton->setBounds(toggleX, toggleY, toggleWidth, toggleHeight);
+    
+    // Calibration button mirrors the toggle on the left of the transport area
+    auto calibrateWidth = 90;
+    auto calibrateHeight = 30;
+    auto calibrateY = transportBounds.getCentreY() - (duplexButton->isVisible() ? calibrateHeight + 2 : calibrateHeight / 2);
+    calibrateButton->setBounds(margin, calibrateY, calibrateWidth, calibrateHeight);
+    duplexButton->setBounds(margin, calibrateY + calibrateHeight + 4, calibrateWidth, calibrateHeight);
 }
 
 void LucidkaraokeAudioProcessorEditor::timerCallback()
 {
     updateWaveformPosition();
     
+    // Segments under the playhead are separated first
+    if (stemProcessingInProgress && progressiveStems != nullptr)
+        progressiveStems->setPlayheadProportion(audioProcessor.getPosition());
+    
     bool hasFile = audioProcessor.isLoaded();
     bool isPlaying = audioProcessor.isPlaying();
     bool isPaused = audioProcessor.isPaused();
@@ -185,6 +248,10 @@ void LucidkaraokeAudioProcessorEditor::timerCallback()
     // Update source toggle button state
     sourceToggleButton->setEnabled(canToggleBetweenSources);
     
+    calibrateButton->setEnabled(!isPlaying && !isPaused && !audioProcessor.isCalibratingLatency());
+    duplexButton->setEnabled(!isPlaying && !isPaused && !audioProcessor.isCalibratingLatency());
+    exportButton->setEnabled(!exportInProgress && currentMixedFile.existsAsFile());
+    
 }
 
 void LucidkaraokeAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadcaster* source)
@@ -194,14 +261,38 @@ void LucidkaraokeAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadc
         // Update the recording button state to reflect the current recording state
         transportControls->setRecordingState(audioProcessor.isRecording());
         
-        // Check if we have a complete recording that needs vocal mixing
-        if (!audioProcessor.isRecording() && audioProcessor.isCompleteRecording())
+        updateCalibrationStatus();
+        
+        // Re-mix whenever the transport has stopped with takes we haven't heard yet
+        if (hasUnmixedTakes())
         {
             handleCompleteRecording();
         }
     }
 }
 
+void LucidkaraokeAudioProcessorEditor::updateCalibrationStatus()
+{
+    // Report the result once, when a calibration we started has finished
+    if (!calibrationPending || audioProcessor.isCalibratingLatency())
+        return;
+    
+    calibrationPending = false;
+    
+    if (audioProcessor.didLastCalibrationSucceed())
+    {
+        progressBar->setWaitingState(false);
+        progressBar->setComplete(true);
+        progressBar->setStatusText("Round-trip latency: "
+                                   + juce::String(audioProcessor.getCalibratedLatencySeconds() * 1000.0, 1) + " ms");
+    }
+    else
+    {
+        progressBar->reset();
+        progressBar->setStatusText("Latency calibration failed - check your input and output levels");
+    }
+}
+
 void LucidkaraokeAudioProcessorEditor::loadFile(const juce::File& file)
 {
     audioProcessor.loadFile(file);
@@ -215,6 +306,9 @@ void LucidkaraokeAudioProcessorEditor::loadFile(const juce::File& file)
     // Track current input file for vocal mixing later
     currentInputFile = file;
     
+    // Takes already stored for this song get mixed in along with the next one
+    numTakesMixed = audioProcessor.getNumTakes();
+    
     // Reset toggle state
     canToggleBetweenSources = false;
     currentMixedFile = juce::File();
@@ -222,16 +316,13 @@ void LucidkaraokeAudioProcessorEditor::loadFile(const juce::File& file)
     
     // Magic: automatically start stem processing in background
     progressBar->reset();
-    progressBar->setStatusText("Separating audio stems...");
+    progressBar->setStatusText("Looking for separated stems...");
     splitAudioStems(file);
 }
 
-void LucidkaraokeAudioProcessorEditor::loadMixedFile(const juce::File& file)
+void LucidkaraokeAudioProcessorEditor::showLivePreview()
 {
-    // Load mixed file into the secondary audio source
-    audioProcessor.loadMixedFile(file);
-    
-    // Switch to mixed source
+    // Switch to the live mix of the karaoke track and the takes
     audioProcessor.setSourceToggle(true);
     audioProcessor.setRecordingEnabled(false);
     
@@ -241,14 +332,9 @@ void LucidkaraokeAudioProcessorEditor::loadMixedFile(const juce::File& file)
     // Set to mixed file playback mode
     currentPlaybackMode = PlaybackMode::MixedFilePlayback;
     
-    // Store mixed file and enable toggle
-    currentMixedFile = file;
+    // Enable toggle
     canToggleBetweenSources = true;
     sourceToggleButton->setToggleState(true);
-    
-    // Update progress bar
-    progressBar->setComplete(true);
-    progressBar->setStatusText("Processing complete - Ready to play");
 }
 
 void LucidkaraokeAudioProcessorEditor::updateWaveformPosition()
@@ -264,18 +350,55 @@ void LucidkaraokeAudioProcessorEditor::splitAudioStems(const juce::File& inputFi
     if (!inputFile.existsAsFile())
         return;
     
-    // Create unique temp directory for this processing session
-    auto tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory)
-                       .getChildFile("lucidkaraoke_stems_" + juce::String(juce::Random::getSystemRandom().nextInt64()));
+    // Nothing to mix against until the lookup or the separation says otherwise
+    setStemOutputDirectory(juce::File());
+    stemProcessingInProgress = true;
+    progressiveStems.reset();
+    progressivePreviewActive = false;
     
-    // Track stem output directory for vocal mixing later
-    currentStemOutputDir = tempDir;
+    // Songs separated before come straight out of the cache
+    auto* lookup = new StemCache::Lookup(stemCache, inputFile, HttpStemProcessor::getCacheVariant(audioProcessor.getLosslessStems()));
     
-    // Set processing state
-    stemProcessingInProgress = true;
+    lookup->onLookupComplete = [this, inputFile](const juce::String& cacheKey, const juce::File& entry) {
+        juce::MessageManager::callAsync([this, inputFile, cacheKey, entry]() {
+            // Another song was loaded while this one was being hashed
+            if (inputFile != currentInputFile)
+                return;
+            
+            if (entry == juce::File())
+            {
+                separateAudioStems(inputFile, cacheKey);
+                return;
+            }
+            
+            setStemOutputDirectory(entry);
+            stemProcessingInProgress = false;
+            progressBar->setComplete(true);
+            progressBar->setStatusText("Stems loaded from cache - Ready to play");
+            
+            if (hasUnmixedTakes())
+                handleCompleteRecording();
+        });
+    };
+    
+    lookup->startThread();
+}
+
+void LucidkaraokeAudioProcessorEditor::separateAudioStems(const juce::File& inputFile, const juce::String& cacheKey)
+{
+    // Separate into the cache's staging directory, or a throwaway one if the song couldn't be hashed
+    auto tempDir = cacheKey.isNotEmpty() ? stemCache.beginEntry(cacheKey) : juce::File();
+    
+    if (tempDir == juce::File())
+        tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                      .getChildFile("lucidkaraoke_stems_" + juce::String(juce::Random::getSystemRandom().nextInt64()));
+    
+    // Not to be swept away while the service is still working on it
+    audioProcessor.getStorageManager().keep(tempDir);
     
     // Create and start the stem processor
     auto* processor = new HttpStemProcessor(inputFile, tempDir, serviceUrl);
+    processor->setLosslessStems(audioProcessor.getLosslessStems());
     
     // Wire up progress updates to the progress bar
     processor->onProgressUpdate = [this](double progress, const juce::String& statusMessage) {
@@ -283,18 +406,64 @@ void LucidkaraokeAudioProcessorEditor::splitAudioStems(const juce::File& inputFi
         progressBar->setStatusText(statusMessage);
     };
     
-    processor->onProcessingComplete = [this, tempDir](bool success, const juce::String& message) {
-        juce::MessageManager::callAsync([this, success, message, tempDir]() {
+    // The karaoke track can be played as soon as the first segment is back
+    auto segments = processor->getSegments();
+    progressiveStems = segments;
+    
+    processor->onFirstSegmentReady = [this, inputFile]() {
+        juce::MessageManager::callAsync([this, inputFile]() {
+            if (inputFile == currentInputFile)
+                startProgressivePreview();
+        });
+    };
+    
+    processor->onProcessingComplete = [this, inputFile, cacheKey, tempDir, segments](bool success, const juce::String& message) {
+        juce::MessageManager::callAsync([this, success, message, inputFile, cacheKey, tempDir, segments]() {
+            auto stemDir = tempDir;
+            audioProcessor.getStorageManager().release(tempDir);
+            
+            // The live mix may still be reading the segments, so it moves onto the finished
+            // karaoke track before they go - or, with nothing to move onto, back to the original
+            if (inputFile == currentInputFile && progressivePreviewActive)
+            {
+                if (!success || !audioProcessor.startLivePreview(tempDir.getChildFile("karaoke.wav")))
+                    stopProgressivePreview();
+                
+                progressivePreviewActive = false;
+            }
+            
+            segments->getDirectory().deleteRecursively();
+            
+            if (cacheKey.isNotEmpty() && tempDir.getParentDirectory() == stemCache.getRootDirectory())
+            {
+                if (success)
+                {
+                    auto entry = stemCache.commitEntry(cacheKey);
+                    
+                    if (entry != juce::File())
+                        stemDir = entry;
+                }
+                else
+                {
+                    stemCache.abandonEntry(cacheKey);
+                }
+            }
+            
+            // The stems are cached either way, but only the current song's are mixed against
+            if (inputFile != currentInputFile)
+                return;
+            
             // Reset processing state
             stemProcessingInProgress = false;
             
             if (success)
             {
+                setStemOutputDirectory(stemDir);
                 progressBar->setComplete(true);
                 progressBar->setStatusText("Processing complete - Ready to play");
                 
-                // Check if we have a completed recording waiting for the karaoke track
-                if (!audioProcessor.isRecording() && audioProcessor.isCompleteRecording())
+                // Check if we have takes waiting for the karaoke track
+                if (hasUnmixedTakes())
                 {
                     // Recording is complete and karaoke track is now ready - start mixing
                     handleCompleteRecording();
@@ -317,47 +486,113 @@ void LucidkaraokeAudioProcessorEditor::splitAudioStems(const juce::File& inputFi
     processor->startThread();
 }
 
+void LucidkaraokeAudioProcessorEditor::startProgressivePreview()
+{
+    if (progressiveStems == nullptr)
+        return;
+    
+    // Plays whatever has been separated so far, and silence where nothing has yet
+    if (!audioProcessor.startLivePreview(HttpStemProcessor::createKaraokeReader(progressiveStems), progressiveStems->getDirectory()))
+        return;
+    
+    progressivePreviewActive = true;
+    canToggleBetweenSources = true;
+}
+
+void LucidkaraokeAudioProcessorEditor::stopProgressivePreview()
+{
+    audioProcessor.stopLivePreview();
+    
+    waveformDisplay->loadFromFile(currentInputFile);
+    waveformDisplay->setDisplayMode(WaveformDisplay::DisplayMode::Normal);
+    currentPlaybackMode = PlaybackMode::Normal;
+    audioProcessor.setRecordingEnabled(true);
+    
+    canToggleBetweenSources = false;
+    sourceToggleButton->setToggleState(false);
+}
+
+void LucidkaraokeAudioProcessorEditor::setStemOutputDirectory(const juce::File& directory)
+{
+    // The current song's stems stay on disk whatever the storage budget
+    auto& storageManager = audioProcessor.getStorageManager();
+    storageManager.release(currentStemOutputDir);
+    storageManager.keep(directory);
+    storageManager.requestSweep();
+    
+    currentStemOutputDir = directory;
+}
+
+bool LucidkaraokeAudioProcessorEditor::hasUnmixedTakes() const
+{
+    return !audioProcessor.isRecording() && !audioProcessor.isPlaying() && !audioProcessor.isPaused()
+        && audioProcessor.getNumTakes() > numTakesMixed;
+}
+
 void LucidkaraokeAudioProcessorEditor::handleCompleteRecording()
 {
-    // Get the recording file from the processor
-    juce::File recordingFile = audioProcessor.getLastRecordingFile();
+    auto* takeManager = audioProcessor.getTakeManager();
     
-    if (!recordingFile.exists())
+    if (takeManager == nullptr || takeManager->getNumTakes() == 0 || !takeManager->getFile().existsAsFile())
     {
         juce::AlertWindow::showMessageBoxAsync(
             juce::AlertWindow::InfoIcon,
             "Recording Complete",
-            "Your recording is complete, but the recording file could not be found.\n"
+            "Your recording is complete, but the take file could not be found.\n"
             "Please check that the recording was saved properly."
         );
         return;
     }
     
     // Build the expected karaoke file path
-    juce::File karaokeFile = currentStemOutputDir.getChildFile("karaoke.mp3");
+    juce::File karaokeFile = currentStemOutputDir.getChildFile("karaoke.wav");
     
     if (!karaokeFile.exists())
     {
+        // What's been separated so far can be heard with the takes already; the mix waits for the rest
+        if (progressivePreviewActive && audioProcessor.startLivePreview(nullptr, progressiveStems->getDirectory()))
+            showLivePreview();
+        
         // Set progress bar to orange waiting state
         progressBar->setWaitingState(true);
         progressBar->setStatusText("Waiting on stem separation...");
         return;
     }
     
-    // Both files exist - start vocal mixing
-    mixVocalsWithKaraoke(recordingFile, karaokeFile);
+    // Both exist - the takes can be heard straight away in the live mix, while the mix file
+    // for export is rendered in the background
+    numTakesMixed = takeManager->getNumTakes();
+    
+    if (audioProcessor.startLivePreview(karaokeFile))
+        showLivePreview();
+    
+    mixVocalsWithKaraoke(*takeManager, karaokeFile);
 }
 
-void LucidkaraokeAudioProcessorEditor::mixVocalsWithKaraoke(const juce::File& recordingFile, const juce::File& karaokeFile)
+void LucidkaraokeAudioProcessorEditor::mixVocalsWithKaraoke(const TakeManager& takeManager, const juce::File& karaokeFile)
 {
     // Create output filename
     juce::String timestamp = juce::Time::getCurrentTime().formatted("%Y%m%d_%H%M%S");
     juce::String outputFileName = currentInputFile.getFileNameWithoutExtension() + 
-                                  "_with_vocals_" + timestamp + ".mp3";
+                                  "_with_vocals_" + timestamp + ".wav";
     juce::File outputFile = karaokeFile.getParentDirectory().getChildFile(outputFileName);
     
-    // Create vocal mixer with buffer size for latency compensation
-    auto* mixer = new VocalMixer(recordingFile, karaokeFile, outputFile, audioProcessor.getRecordingBufferSize());
+    // The takes are flattened into one composite vocal (newest take wins where they overlap),
+    // which the mixer then places using the alignment stored alongside it
+    auto compositeFile = karaokeFile.getParentDirectory().getChildFile("vocals_composite.wav");
+    auto* mixer = new VocalMixer(compositeFile, karaokeFile, outputFile);
+    mixer->setTakes(takeManager.getFile(), takeManager.getTakes());
+    mixer->setGuideVocal(HttpStemProcessor::createStemReader(currentStemOutputDir, "vocals"));
+    
+    vocalLagApplied = false;
+    mixer->onAlignmentDetected = [this](double lagSeconds, float confidence, bool applied) {
+        detectedVocalLagSeconds = lagSeconds;
+        detectedVocalLagConfidence = confidence;
+        vocalLagApplied = applied;
+        
+        // Line the live mix up the same way as the export
+        audioProcessor.setPreviewVocalOffsetSeconds(applied ? -lagSeconds : 0.0);
+    };
     
     // Wire up progress updates to the progress bar
     mixer->onProgressUpdate = [this](double progress, const juce::String& statusMessage) {
@@ -369,8 +604,15 @@ void LucidkaraokeAudioProcessorEditor::mixVocalsWithKaraoke(const juce::File& re
         juce::MessageManager::callAsync([this, success, message, outputFile]() {
             if (success)
             {
-                // Automatically load the mixed file for playback
-                loadMixedFile(outputFile);
+                // The live mix is already playing - the file is only for exporting
+                currentMixedFile = outputFile;
+                progressBar->setComplete(true);
+                
+                if (vocalLagApplied)
+                    progressBar->setStatusText("Mix ready to export - vocals shifted " + juce::String(-detectedVocalLagSeconds * 1000.0, 1)
+                                               + " ms (" + juce::String(juce::roundToInt(detectedVocalLagConfidence * 100.0f)) + "% match)");
+                else
+                    progressBar->setStatusText("Mix ready to export");
             }
             else
             {
@@ -387,10 +629,192 @@ void LucidkaraokeAudioProcessorEditor::mixVocalsWithKaraoke(const juce::File& re
     
     // Set progress bar to orange during mixing (in prep state)
     progressBar->setWaitingState(true);
-    progressBar->setStatusText("Mixing vocals with karaoke...");
+    progressBar->setStatusText(audioProcessor.hasLivePreview() ? "Live mix ready - rendering in the background..."
+                                                                : "Mixing vocals with karaoke...");
     mixer->startThread();
 }
 
+void LucidkaraokeAudioProcessorEditor::chooseExportCodec()
+{
+    using Codec = ExportJob::Codec;
+    
+    juce::PopupMenu menu;
+    for (auto codec : { Codec::Wav16, Codec::Wav24, Codec::Flac, Codec::OggVorbis, Codec::Mp3 })
+        menu.addItem(static_cast<int>(codec) + 1, ExportJob::getCodecName(codec));
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(exportButton.get()), [this](int result) {
+        if (result == 0)
+            return;
+        
+        auto codec = static_cast<Codec>(result - 1);
+        auto defaultFile = juce::File::getSpecialLocation(juce::File::userMusicDirectory)
+                               .getChildFile(currentMixedFile.getFileNameWithoutExtension() + ExportJob::getFileExtension(codec));
+        
+        exportChooser = std::make_unique<juce::FileChooser>("Export mix as " + ExportJob::getCodecName(codec), defaultFile,
+                                                            "*" + ExportJob::getFileExtension(codec));
+        
+        exportChooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                       | juce::FileBrowserComponent::warnAboutOverwriting,
+                                   [this, codec](const juce::FileChooser& chooser) {
+            auto destination = chooser.getResult();
+            
+            if (destination != juce::File())
+                exportMix(destination.withFileExtension(ExportJob::getFileExtension(codec)), codec);
+        });
+    });
+}
+
+void LucidkaraokeAudioProcessorEditor::showSettingsMenu()
+{
+    using Format = LucidkaraokeAudioProcessor::RecordingFormat;
+    
+    // Applies from the next take, so not while one is being recorded
+    auto canChangeRecording = !audioProcessor.isRecording();
+    
+    juce::PopupMenu formatMenu;
+    const std::pair<Format, const char*> formats[] = {
+        { Format::Wav16, "WAV 16-bit" },
+        { Format::Wav24, "WAV 24-bit" },
+        { Format::WavFloat32, "WAV 32-bit float" },
+        { Format::Flac24, "FLAC 24-bit" }
+    };
+    
+    for (auto& [format, name] : formats)
+        formatMenu.addItem(name, canChangeRecording, audioProcessor.getRecordingFormat() == format,
+                           [this, format = format]() { audioProcessor.setRecordingFormat(format); });
+    
+    // Kept from just before Play, so the first note isn't clipped when a take starts late
+    juce::PopupMenu preRollMenu;
+    
+    for (auto seconds : { 0.0, 0.25, 0.5, 1.0, 2.0, LucidkaraokeAudioProcessor::maxPreRollSeconds })
+        preRollMenu.addItem(seconds == 0.0 ? juce::String("Off") : juce::String(seconds) + " s", canChangeRecording,
+                            std::abs(audioProcessor.getPreRollSeconds() - seconds) < 0.001,
+                            [this, seconds]() { audioProcessor.setPreRollSeconds(seconds); });
+    
+    using Quality = PolyphaseResampler::Quality;
+    
+    // Only matters when the song's rate differs from the device's
+    juce::PopupMenu qualityMenu;
+    const std::pair<Quality, const char*> qualities[] = {
+        { Quality::Fast, "Fast" },
+        { Quality::Standard, "Standard" },
+        { Quality::High, "High" }
+    };
+    
+    for (auto& [quality, name] : qualities)
+        qualityMenu.addItem(name, true, audioProcessor.getResamplerQuality() == quality,
+                            [this, quality = quality]() { audioProcessor.setResamplerQuality(quality); });
+    
+    // The live mix only - the exported mix is balanced and loudness-matched on its own
+    juce::PopupMenu liveMixMenu;
+    const float levels[] = { -12.0f, -6.0f, -3.0f, 0.0f, 3.0f, 6.0f };
+    
+    auto levelName = [](float gainDb) { return (gainDb > 0.0f ? "+" : "") + juce::String(gainDb, 0) + " dB"; };
+    
+    liveMixMenu.addSectionHeader("Vocal level");
+    
+    for (auto gainDb : levels)
+        liveMixMenu.addItem(levelName(gainDb), true, std::abs(audioProcessor.getPreviewVocalGainDb() - gainDb) < 0.01f,
+                            [this, gainDb]() { audioProcessor.setPreviewVocalGainDb(gainDb); });
+    
+    liveMixMenu.addSectionHeader("Backing track level");
+    
+    for (auto gainDb : levels)
+        liveMixMenu.addItem(levelName(gainDb), true, std::abs(audioProcessor.getPreviewBackingGainDb() - gainDb) < 0.01f,
+                            [this, gainDb]() { audioProcessor.setPreviewBackingGainDb(gainDb); });
+    
+    liveMixMenu.addSectionHeader("Vocal pan");
+    const std::pair<float, const char*> pans[] = {
+        { -1.0f, "Left" },
+        { -0.5f, "Half left" },
+        { 0.0f, "Centre" },
+        { 0.5f, "Half right" },
+        { 1.0f, "Right" }
+    };
+    
+    for (auto& [pan, name] : pans)
+        liveMixMenu.addItem(name, true, audioProcessor.getPreviewVocalPan() == pan,
+                            [this, pan = pan]() { audioProcessor.setPreviewVocalPan(pan); });
+    
+    // The oldest stems, takes and mixes are deleted once they take up more than this
+    juce::PopupMenu storageMenu;
+    
+    for (auto gigabytes : { 2, 5, 10, 20, 50 })
+    {
+        auto megabytes = gigabytes * 1024;
+        storageMenu.addItem(juce::String(gigabytes) + " GB", true, audioProcessor.getStorageBudgetMegabytes() == megabytes,
+                            [this, megabytes]() { audioProcessor.setStorageBudgetMegabytes(megabytes); });
+    }
+    
+    // Applies to the next song separated
+    juce::PopupMenu stemsMenu;
+    stemsMenu.addItem("FLAC (lossless)", true, audioProcessor.getLosslessStems(),
+                      [this]() { audioProcessor.setLosslessStems(true); });
+    stemsMenu.addItem("MP3 (smaller download)", true, !audioProcessor.getLosslessStems(),
+                      [this]() { audioProcessor.setLosslessStems(false); });
+    
+    juce::PopupMenu menu;
+    menu.addSubMenu("Live mix", liveMixMenu);
+    menu.addSubMenu("Recording format", formatMenu);
+    menu.addSubMenu("Pre-roll", preRollMenu);
+    menu.addSubMenu("Playback quality", qualityMenu);
+    menu.addSubMenu("Stem format", stemsMenu);
+    menu.addSubMenu("Storage", storageMenu);
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(settingsButton.get()));
+}
+
+void LucidkaraokeAudioProcessorEditor::exportMix(const juce::File& destination, ExportJob::Codec codec)
+{
+    if (!currentMixedFile.existsAsFile())
+        return;
+    
+    // The last one has finished, but its thread may not quite have exited
+    if (exportJob != nullptr)
+        exportJob->stopThread(5000);
+    
+    exportJob = std::make_unique<ExportJob>(currentMixedFile, destination, codec);
+    exportInProgress = true;
+    
+    // Its updates are delivered asynchronously, so they may arrive after the editor has closed
+    juce::Component::SafePointer<LucidkaraokeAudioProcessorEditor> editor(this);
+    
+    exportJob->onProgressUpdate = [editor](double progress, const juce::String& statusMessage) {
+        if (editor == nullptr)
+            return;
+        
+        editor->progressBar->setProgress(progress);
+        editor->progressBar->setStatusText(statusMessage);
+    };
+    
+    exportJob->onExportComplete = [editor](bool success, const juce::String& message) {
+        juce::MessageManager::callAsync([editor, success, message]() {
+            if (editor == nullptr)
+                return;
+            
+            editor->exportInProgress = false;
+            
+            if (success)
+            {
+                editor->progressBar->setComplete(true);
+                editor->progressBar->setStatusText(message);
+            }
+            else
+            {
+                editor->progressBar->reset();
+                editor->progressBar->setStatusText("Export failed");
+                juce::AlertWindow::showMessageBoxAsync(
+                    juce::AlertWindow::WarningIcon,
+                    "Export Failed",
+                    message
+                );
+            }
+        });
+    };
+    
+    progressBar->setWaitingState(true);
+    exportJob->startThread();
+}
+
 void LucidkaraokeAudioProcessorEditor::togglePlaybackSource(bool showMixed)
 {
     DBG("togglePlaybackSource called with showMixed: " << (showMixed ? "true" : "false") << ", canToggleBetweenSources: " << (canToggleBetweenSources ? "true" : "false"));
@@ -401,15 +825,19 @@ void LucidkaraokeAudioProcessorEditor::togglePlaybackSource(bool showMixed)
         return;
     }
     
-    if (showMixed && currentMixedFile.exists())
+    if (showMixed && audioProcessor.hasLivePreview())
     {
-        // Seamlessly switch to mixed source - no file reloading
+        // Seamlessly switch to the live mix - no file reloading
         audioProcessor.setSourceToggle(true);
-        waveformDisplay->loadFromFile(currentMixedFile);
+        
+        // Until the export is done there's no mix waveform to show, so keep the original's
+        if (currentMixedFile.existsAsFile())
+            waveformDisplay->loadFromFile(currentMixedFile);
+        
         waveformDisplay->setDisplayMode(WaveformDisplay::DisplayMode::MixedFile);
         currentPlaybackMode = PlaybackMode::MixedFilePlayback;
         audioProcessor.setRecordingEnabled(false);
-        progressBar->setStatusText("Playing mixed file with vocals");
+        progressBar->setStatusText("Playing your vocals with the karaoke track");
     }
     else if (!showMixed && currentInputFile.exists())
     {
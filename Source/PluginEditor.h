@@ -18,6 +18,8 @@
 #include "Components/SourceToggleButton.h"
 #include "Audio/HttpStemProcessor.h"
 #include "Audio/VocalMixer.h"
+#include "Audio/ExportJob.h"
+#include "Audio/StemCache.h"
 
 //==============================================================================
 /**
@@ -53,22 +55,51 @@ private:
     std::unique_ptr<TransportControls> transportControls;
     std::unique_ptr<StemProgressBar> progressBar;
     std::unique_ptr<SourceToggleButton> sourceToggleButton;
+    std::unique_ptr<juce::TextButton> calibrateButton;
+    std::unique_ptr<juce::TextButton> duplexButton;
+    std::unique_ptr<juce::TextButton> exportButton;
+    std::unique_ptr<juce::TextButton> settingsButton;
+    std::unique_ptr<juce::FileChooser> exportChooser;
+    std::unique_ptr<ExportJob> exportJob;
     
     void loadFile(const juce::File& file);
-    void loadMixedFile(const juce::File& file);
+    void showLivePreview();
     void updateWaveformPosition();
     void splitAudioStems(const juce::File& inputFile);
+    void separateAudioStems(const juce::File& inputFile, const juce::String& cacheKey);
+    void setStemOutputDirectory(const juce::File& directory);
+    void startProgressivePreview();
+    void stopProgressivePreview();
     void handleCompleteRecording();
-    void mixVocalsWithKaraoke(const juce::File& recordingFile, const juce::File& karaokeFile);
+    bool hasUnmixedTakes() const;
+    void mixVocalsWithKaraoke(const TakeManager& takeManager, const juce::File& karaokeFile);
     void togglePlaybackSource(bool showMixed);
+    void chooseExportCodec();
+    void showSettingsMenu();
+    void exportMix(const juce::File& destination, ExportJob::Codec codec);
     
     // Track stem processing for vocal mixing
     juce::File currentStemOutputDir;
     juce::File currentInputFile;
     juce::File currentMixedFile;
+    StemCache stemCache;
+    
+    // Segments of the song being separated, while its karaoke track is still arriving
+    std::shared_ptr<StemSegments> progressiveStems;
+    bool progressivePreviewActive = false;
     bool stemProcessingInProgress;
     PlaybackMode currentPlaybackMode;
     bool canToggleBetweenSources;
+    bool calibrationPending = false;
+    int numTakesMixed = 0;
+    bool exportInProgress = false;
+    
+    // Timing of the last take against the original singer, as detected by the mixer
+    double detectedVocalLagSeconds = 0.0;
+    float detectedVocalLagConfidence = 0.0f;
+    bool vocalLagApplied = false;
+    
+    void updateCalibrationStatus();
     
     juce::String serviceUrl;
     void promptForServiceUrl();
@@ -8,6 +8,34 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "Audio/FilePreallocator.h"
+#include "Audio/IntermediateAudio.h"
+
+#if JucePlugin_Build_Standalone
+ #include <juce_audio_plugin_client/Standalone/juce_StandaloneFilterWindow.h>
+#endif
+
+namespace
+{
+    // How far ahead the live mix is read from disk and resampled, in device samples
+    constexpr int previewReadAheadSamples = 32768;
+
+    // Just under full scale - the preview limiter is a safety net, not part of the sound
+    constexpr float previewCeiling = 0.98f;
+
+    // Marks a block as in flight for as long as it's in scope
+    class CallbackSequenceScope
+    {
+    public:
+        explicit CallbackSequenceScope(std::atomic<juce::uint32>& counter) : sequence(counter) { ++sequence; }
+        ~CallbackSequenceScope() { ++sequence; }
+
+    private:
+        std::atomic<juce::uint32>& sequence;
+
+        JUCE_DECLARE_NON_COPYABLE(CallbackSequenceScope)
+    };
+}
 
 //==============================================================================
 LucidkaraokeAudioProcessor::LucidkaraokeAudioProcessor()
@@ -29,36 +57,60 @@ LucidkaraokeAudioProcessor::LucidkaraokeAudioProcessor()
     fileLogger = std::make_unique<juce::FileLogger>(logFile, "Lucid Karaoke Log", 10 * 1024 * 1024); // 10 MB max log size
     juce::Logger::setCurrentLogger(fileLogger.get());
 
+    juce::PropertiesFile::Options settingsOptions;
+    settingsOptions.applicationName = "LucidKaraoke";
+    settingsOptions.filenameSuffix = ".settings";
+    settingsOptions.folderName = "LucidKaraoke";
+    settingsOptions.osxLibrarySubFolder = "Application Support";
+    appProperties.setStorageParameters(settingsOptions);
+
     formatManager.registerBasicFormats();
     transportSource.addChangeListener(this);
 
     mixerSource.addInputSource(&transportSource, false);
     backgroundThread.startThread();
 
-    // Initialize recording device manager
-    recordingDeviceManager.initialiseWithDefaultDevices(1, 0); // 1 input, 0 outputs
-
-    juce::AudioDeviceManager::AudioDeviceSetup setup;
-    recordingDeviceManager.getAudioDeviceSetup(setup);
-
-    if (setup.inputDeviceName.isNotEmpty())
+    // The separate recording device is only opened when a take actually needs it,
+    // so a full-duplex standalone session never opens a second driver
+    if (auto* settings = appProperties.getUserSettings())
     {
-        setup.inputChannels.setBit(0);
-        recordingBufferSize = setup.bufferSize; // Store for latency compensation
-        recordingDeviceManager.setAudioDeviceSetup(setup, true);
+        recordingSource = static_cast<RecordingSource>(settings->getIntValue("recordingSource",
+                                                                            static_cast<int>(RecordingSource::SharedDevice)));
+        preRollSeconds = juce::jlimit(0.0, maxPreRollSeconds, settings->getDoubleValue("preRollSeconds", preRollSeconds));
+        recordingFormat = static_cast<RecordingFormat>(juce::jlimit(0, 3, settings->getIntValue("recordingFormat", 0)));
+        resamplerQuality = static_cast<PolyphaseResampler::Quality>(juce::jlimit(0, 2, settings->getIntValue("resamplerQuality", 1)));
+        losslessStems = settings->getBoolValue("losslessStems", losslessStems);
     }
 
+    auto storageBudgetMegabytes = defaultStorageBudgetMegabytes;
+
+    if (auto* settings = appProperties.getUserSettings())
+        storageBudgetMegabytes = juce::jmax(0, settings->getIntValue("storageBudgetMB", defaultStorageBudgetMegabytes));
+
+    storageManager = std::make_unique<StorageManager>(static_cast<juce::int64>(storageBudgetMegabytes) * 1024 * 1024);
+
     recordingCallback = std::make_unique<RecordingCallback>(*this);
+    recordingFifo = std::make_unique<RecordingFifo>(1, 32768);
+
+    // The standalone window (and its device) doesn't exist yet, so it decides on the first take.
+    // In a host we always record from the input bus and never open a device of our own.
+    if (wrapperType != wrapperType_Standalone)
+        selectRecordingInput();
 }
 
 LucidkaraokeAudioProcessor::~LucidkaraokeAudioProcessor()
 {
+    stopTimer();
+    latencyCalibrator.cancel();
     stopRecording();
+    disarmRecordingInput();
     recordingDeviceManager.removeAudioCallback(recordingCallback.get());
     backgroundThread.stopThread(5000);
     transportSource.removeChangeListener(this);
     mixerSource.removeAllInputs();
     transportSource.setSource(nullptr);
+    liveMixResampler.reset();
+    originalResampler.reset();
     readerSource.reset();
 }
 
@@ -127,8 +179,12 @@ void LucidkaraokeAudioProcessor::changeProgramName (int index, const juce::Strin
 //==============================================================================
 void LucidkaraokeAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    currentSampleRate = sampleRate;
     transportSource.prepareToPlay(samplesPerBlock, sampleRate);
     mixerSource.prepareToPlay(samplesPerBlock, sampleRate);
+    
+    previewBuffer.setSize(LiveMixSource::numOutputChannels, samplesPerBlock);
+    previewLimiter.prepare(sampleRate, 2, previewCeiling);
 }
 
 void LucidkaraokeAudioProcessor::releaseResources()
@@ -172,7 +228,72 @@ void LucidkaraokeAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    if (readerSource != nullptr)
+    // Publish where the first sample of this block sits in the song, so recorded
+    // blocks from the other device can be placed against it
+    const uint64_t* blockHostTimeNs = nullptr;
+    uint64_t playHeadHostTimeNs = 0;
+    juce::int64 hostTimelineSample = -1;
+
+    if (auto* playHead = getPlayHead())
+    {
+        if (auto position = playHead->getPosition())
+        {
+            if (auto hostTime = position->getHostTimeNs())
+            {
+                playHeadHostTimeNs = *hostTime;
+                blockHostTimeNs = &playHeadHostTimeNs;
+            }
+
+            // Where this block sits on the DAW's own timeline, if it's rolling
+            if (auto timeInSamples = position->getTimeInSamples(); timeInSamples && position->getIsPlaying())
+                hostTimelineSample = *timeInSamples;
+        }
+    }
+
+    AudioClock::Anchor anchor;
+    anchor.hostTimeNs = AudioClock::getHostTimeNs(blockHostTimeNs);
+    anchor.deviceSamples = playbackDeviceSamples;
+    anchor.sampleRate = currentSampleRate;
+    playbackDeviceSamples += buffer.getNumSamples();
+
+    // While calibrating, the test signal replaces the song and owns the timeline
+    auto calibrating = latencyCalibrator.isRunning();
+
+    if (calibrating)
+    {
+        anchor.position = latencyCalibrator.getOutputPosition();
+        anchor.isRunning = true;
+    }
+    else
+    {
+        anchor.position = static_cast<juce::int64>(transportSource.getCurrentPosition() * currentSampleRate);
+        anchor.isRunning = transportSource.isPlaying();
+    }
+
+    playbackClock.publish(anchor);
+
+    // On a full-duplex device or a host input bus the input for this block is still in the buffer,
+    // sample-locked to the output we're about to render - take it before the output overwrites it
+    if (inputFromProcessBlock.load() && totalNumInputChannels > 0)
+    {
+        if (calibrating)
+            latencyCalibrator.captureInput(buffer.getReadPointer(0), buffer.getNumSamples(), anchor.hostTimeNs, playbackClock);
+
+        captureRecordingBlock(buffer.getArrayOfReadPointers(), totalNumInputChannels, buffer.getNumSamples(),
+                              anchor.hostTimeNs, hostTimelineSample);
+    }
+
+    if (calibrating)
+    {
+        latencyCalibrator.renderOutput(buffer);
+        return;
+    }
+
+    if (readerSource != nullptr && usingMixedSource.load())
+    {
+        renderLivePreview(buffer);
+    }
+    else if (readerSource != nullptr)
     {
         juce::AudioSourceChannelInfo channelInfo(&buffer, 0, buffer.getNumSamples());
         mixerSource.getNextAudioBlock(channelInfo);
@@ -222,79 +343,244 @@ void LucidkaraokeAudioProcessor::loadFile(const juce::File& file)
             new juce::AudioFormatReaderSource(reader, true)
         );
         
-        transportSource.setSource(newSource.get(), 0, nullptr, reader->sampleRate);
+        // Resampled here rather than by the transport, so it's given a source rate of zero
+        auto newResampler = std::make_unique<PolyphaseResamplingSource>(newSource.get(), reader->sampleRate, 2,
+                                                                        resamplerQuality);
+        
+        transportSource.setSource(newResampler.get(), 0, nullptr, 0.0);
+        originalResampler = std::move(newResampler);
         readerSource = std::move(newSource);
         lastFileURL = juce::URL(file);
         
-        // Reset mixed source when loading a new original file
-        mixedReaderSource.reset();
+        // The live mix belongs to the previous song
+        liveMixResampler.reset();
+        liveMixSource.reset();
+        liveMixBackingFile = juce::File();
+        previewVocalOffsetSeconds = 0.0;
         usingMixedSource = false;
         
         changeState(Stopped);
+
+        // Takes for this song live in one container, so coming back to it later picks them up again
+        if (!isRecording())
+        {
+            auto takesFile = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                                 .getChildFile("LucidKaraoke_Takes_" + file.getFileNameWithoutExtension() + "_"
+                                               + juce::String::toHexString(file.getFullPathName().hashCode64()) + ".takes");
+
+            if (takeManager != nullptr)
+                storageManager->release(takeManager->getFile());
+
+            storageManager->keep(takesFile);
+            takeManager = std::make_unique<TakeManager>(takesFile);
+        }
+
+        // Open the input now rather than on Play, so the first take starts instantly
+        if (!isRecording())
+            armRecordingInput();
     }
 }
 
-void LucidkaraokeAudioProcessor::loadMixedFile(const juce::File& file)
+void LucidkaraokeAudioProcessor::setSourceToggle(bool useMixed)
 {
-    auto* reader = formatManager.createReaderFor(file);
+    if (useMixed && liveMixSource != nullptr)
+    {
+        // Switch to the live mix
+        if (!usingMixedSource)
+            attachTransportSource(true);
+    }
+    else if (!useMixed && readerSource != nullptr)
+    {
+        // Switch to original source
+        if (usingMixedSource)
+            attachTransportSource(false);
+    }
+}
+
+void LucidkaraokeAudioProcessor::attachTransportSource(bool useMixed)
+{
+    // Store current position and state
+    auto currentPosition = transportSource.getCurrentPosition();
+    auto currentState = state;
     
-    if (reader != nullptr)
+    // Both sources are already at the device rate, so the transport doesn't resample
+    if (useMixed)
     {
-        mixedReaderSource = std::make_unique<juce::AudioFormatReaderSource>(reader, true);
-        
-        // Don't change state - mixed file is loaded in background
-        // Toggle will be available once this is loaded
+        // The takes come off the disk, so they're read ahead - and resampled - on the background
+        // thread. All three stem channels have to make it through the transport's buffering.
+        transportSource.setSource(liveMixResampler.get(), previewReadAheadSamples, &backgroundThread,
+                                  0.0, LiveMixSource::numOutputChannels);
+    }
+    else
+    {
+        transportSource.setSource(originalResampler.get(), 0, nullptr, 0.0);
     }
+    
+    // Restore position and state
+    transportSource.setPosition(currentPosition);
+    if (currentState == Playing)
+    {
+        transportSource.start();
+    }
+    
+    usingMixedSource = useMixed;
 }
 
-void LucidkaraokeAudioProcessor::setSourceToggle(bool useMixed)
+void LucidkaraokeAudioProcessor::setResamplerQuality(PolyphaseResampler::Quality newQuality)
 {
-    if (useMixed && mixedReaderSource != nullptr)
+    resamplerQuality = newQuality;
+    
+    if (auto* settings = appProperties.getUserSettings())
     {
-        // Switch to mixed source
-        if (!usingMixedSource)
-        {
-            // Store current position and state
-            auto currentPosition = transportSource.getCurrentPosition();
-            auto currentState = state;
-            
-            // Switch source
-            transportSource.setSource(mixedReaderSource.get(), 0, nullptr, 
-                                    mixedReaderSource->getAudioFormatReader()->sampleRate);
-            
-            // Restore position and state
-            transportSource.setPosition(currentPosition);
-            if (currentState == Playing)
-            {
-                transportSource.start();
-            }
-            
-            usingMixedSource = true;
-        }
+        settings->setValue("resamplerQuality", static_cast<int>(newQuality));
+        settings->saveIfNeeded();
     }
-    else if (!useMixed && readerSource != nullptr)
+    
+    if (originalResampler != nullptr)
+        originalResampler->setQuality(newQuality);
+    if (liveMixResampler != nullptr)
+        liveMixResampler->setQuality(newQuality);
+    
+    // The filter is rebuilt when the transport prepares the source again
+    if (usingMixedSource ? liveMixResampler != nullptr : originalResampler != nullptr)
+        attachTransportSource(usingMixedSource);
+}
+
+bool LucidkaraokeAudioProcessor::startLivePreview(const juce::File& backingTrackFile)
+{
+    // The karaoke track is a float intermediate, read straight from a memory mapping
+    if (liveMixSource != nullptr && backingTrackFile == liveMixBackingFile)
+        return startLivePreview(nullptr, backingTrackFile);
+    
+    return startLivePreview(IntermediateAudio::createReader(backingTrackFile), backingTrackFile);
+}
+
+bool LucidkaraokeAudioProcessor::startLivePreview(std::unique_ptr<juce::AudioFormatReader> reader, const juce::File& backingTrackFile)
+{
+    if (readerSource == nullptr || takeManager == nullptr)
+        return false;
+    
+    // Same backing track: just swap the takes in, even mid-song
+    if (liveMixSource != nullptr && backingTrackFile == liveMixBackingFile)
     {
-        // Switch to original source
+        liveMixSource->setTakes(takeManager->getFile(), takeManager->getTakes());
+        
+        // Throw away what was read ahead with the old takes
         if (usingMixedSource)
+            transportSource.setPosition(transportSource.getCurrentPosition());
+        
+        return true;
+    }
+    
+    if (reader == nullptr)
+        return false;
+    
+    auto newSource = std::make_unique<LiveMixSource>(std::move(reader));
+    newSource->setTakes(takeManager->getFile(), takeManager->getTakes());
+    newSource->setVocalOffsetSeconds(previewVocalOffsetSeconds);
+    auto newResampler = std::make_unique<PolyphaseResamplingSource>(newSource.get(), newSource->getSampleRate(),
+                                                                    LiveMixSource::numOutputChannels, resamplerQuality);
+    
+    // The transport mustn't be reading the old live mix while it's replaced
+    auto wasUsingMixedSource = usingMixedSource.load();
+    
+    if (wasUsingMixedSource)
+        setSourceToggle(false);
+    
+    // The old resampler reads from the old live mix, so it goes first
+    liveMixResampler = std::move(newResampler);
+    liveMixSource = std::move(newSource);
+    liveMixBackingFile = backingTrackFile;
+    
+    if (wasUsingMixedSource)
+        setSourceToggle(true);
+    
+    return true;
+}
+
+void LucidkaraokeAudioProcessor::stopLivePreview()
+{
+    // The transport mustn't be reading the live mix while it goes
+    setSourceToggle(false);
+    
+    liveMixResampler.reset();
+    liveMixSource.reset();
+    liveMixBackingFile = juce::File();
+}
+
+void LucidkaraokeAudioProcessor::setPreviewVocalGainDb(float gainDb)
+{
+    previewVocalGain = juce::Decibels::decibelsToGain(gainDb);
+}
+
+void LucidkaraokeAudioProcessor::setPreviewBackingGainDb(float gainDb)
+{
+    previewBackingGain = juce::Decibels::decibelsToGain(gainDb);
+}
+
+void LucidkaraokeAudioProcessor::setPreviewVocalPan(float pan)
+{
+    previewVocalPan = juce::jlimit(-1.0f, 1.0f, pan);
+}
+
+void LucidkaraokeAudioProcessor::setPreviewVocalOffsetSeconds(double seconds)
+{
+    previewVocalOffsetSeconds = seconds;
+    
+    if (liveMixSource == nullptr)
+        return;
+    
+    liveMixSource->setVocalOffsetSeconds(seconds);
+    
+    // The offset moves which vocal samples get read, so drop anything already read ahead
+    if (usingMixedSource)
+        transportSource.setPosition(transportSource.getCurrentPosition());
+}
+
+void LucidkaraokeAudioProcessor::renderLivePreview(juce::AudioBuffer<float>& buffer)
+{
+    auto numSamples = buffer.getNumSamples();
+    auto numOutputChannels = buffer.getNumChannels();
+    
+    // Balance-style pan: centred, the vocal is at full level on both sides. That's the same
+    // balance against the backing track as the export, but not the same level - the export
+    // halves both inputs and then loudness-matches the sum, whereas here they're summed at
+    // unity so switching over from the original song doesn't drop the backing track by 6 dB
+    auto vocalGain = previewVocalGain.load();
+    auto pan = previewVocalPan.load();
+    auto targetBackingGain = previewBackingGain.load();
+    auto targetVocalLeft = vocalGain * juce::jmin(1.0f, 1.0f - pan);
+    auto targetVocalRight = vocalGain * juce::jmin(1.0f, 1.0f + pan);
+    
+    for (int offset = 0; offset < numSamples; offset += previewBuffer.getNumSamples())
+    {
+        auto blockLength = juce::jmin(previewBuffer.getNumSamples(), numSamples - offset);
+        juce::AudioSourceChannelInfo stems(&previewBuffer, 0, blockLength);
+        transportSource.getNextAudioBlock(stems);
+        
+        auto* vocal = previewBuffer.getReadPointer(2);
+        
+        // Ramp from the last block's levels so moving a control doesn't click
+        if (numOutputChannels >= 2)
         {
-            // Store current position and state
-            auto currentPosition = transportSource.getCurrentPosition();
-            auto currentState = state;
-            
-            // Switch source
-            transportSource.setSource(readerSource.get(), 0, nullptr, 
-                                    readerSource->getAudioFormatReader()->sampleRate);
-            
-            // Restore position and state
-            transportSource.setPosition(currentPosition);
-            if (currentState == Playing)
-            {
-                transportSource.start();
-            }
-            
-            usingMixedSource = false;
+            buffer.copyFromWithRamp(0, offset, previewBuffer.getReadPointer(0), blockLength, appliedBackingGain, targetBackingGain);
+            buffer.copyFromWithRamp(1, offset, previewBuffer.getReadPointer(1), blockLength, appliedBackingGain, targetBackingGain);
+            buffer.addFromWithRamp(0, offset, vocal, blockLength, appliedVocalLeft, targetVocalLeft);
+            buffer.addFromWithRamp(1, offset, vocal, blockLength, appliedVocalRight, targetVocalRight);
         }
+        else if (numOutputChannels == 1)
+        {
+            buffer.copyFromWithRamp(0, offset, previewBuffer.getReadPointer(0), blockLength, appliedBackingGain, targetBackingGain);
+            buffer.addFromWithRamp(0, offset, vocal, blockLength, appliedVocalLeft, targetVocalLeft);
+        }
+        
+        appliedBackingGain = targetBackingGain;
+        appliedVocalLeft = targetVocalLeft;
+        appliedVocalRight = targetVocalRight;
     }
+    
+    // Summed at unity, a loud vocal would clip - the limiter only catches those peaks
+    previewLimiter.process(buffer, 0, numSamples);
 }
 
 void LucidkaraokeAudioProcessor::play()
@@ -303,15 +589,10 @@ void LucidkaraokeAudioProcessor::play()
     {
         changeState(Playing);
         
-        // Start recording automatically when playback starts
+        // Start recording automatically when playback starts - from wherever the transport
+        // is, so any position is a punch-in point
         if (!isRecording())
-        {
-            // Track if this is a complete recording session (starting from beginning)
-            recordingStartPosition = getPosition();
-            completeRecordingSession = (recordingStartPosition <= 0.01); // Allow small tolerance for start position
-            
             startRecording();
-        }
     }
 }
 
@@ -324,6 +605,10 @@ void LucidkaraokeAudioProcessor::pause()
     else if (state == Paused)
     {
         changeState(Playing);
+        
+        // Resuming punches in a new take where the last one stopped
+        if (!isRecording())
+            startRecording();
     }
 }
 
@@ -333,44 +618,46 @@ void LucidkaraokeAudioProcessor::stop()
     {
         changeState(Stopped);
         
-        // Stop and save recording when transport stops
+        // Stop and save recording when transport stops. The take is kept like any other.
         if (isRecording())
-        {
             stopRecording();
-            // Manual stop - not a complete recording session
-            completeRecordingSession = false;
-        }
+        else
+            sendChangeMessage();
     }
 }
 
 void LucidkaraokeAudioProcessor::setPosition(double position)
 {
-    auto* currentSource = usingMixedSource ? mixedReaderSource.get() : readerSource.get();
-    if (currentSource != nullptr)
+    if (isLoaded())
     {
-        auto lengthInSeconds = currentSource->getTotalLength() / currentSource->getAudioFormatReader()->sampleRate;
-        auto timePosition = position * lengthInSeconds;
+        auto timePosition = position * getCurrentSourceLengthSeconds();
         transportSource.setPosition(timePosition);
     }
 }
 
 double LucidkaraokeAudioProcessor::getPosition() const
 {
-    auto* currentSource = usingMixedSource ? mixedReaderSource.get() : readerSource.get();
-    if (currentSource != nullptr)
-    {
-        auto lengthInSeconds = currentSource->getTotalLength() / currentSource->getAudioFormatReader()->sampleRate;
-        if (lengthInSeconds > 0)
-            return transportSource.getCurrentPosition() / lengthInSeconds;
-    }
+    auto lengthInSeconds = getCurrentSourceLengthSeconds();
+    if (lengthInSeconds > 0)
+        return transportSource.getCurrentPosition() / lengthInSeconds;
     return 0.0;
 }
 
 double LucidkaraokeAudioProcessor::getLength() const
 {
-    auto* currentSource = usingMixedSource ? mixedReaderSource.get() : readerSource.get();
-    if (currentSource != nullptr)
-        return currentSource->getTotalLength();
+    if (usingMixedSource && liveMixSource != nullptr)
+        return static_cast<double>(liveMixSource->getTotalLength());
+    if (readerSource != nullptr)
+        return static_cast<double>(readerSource->getTotalLength());
+    return 0.0;
+}
+
+double LucidkaraokeAudioProcessor::getCurrentSourceLengthSeconds() const
+{
+    if (usingMixedSource && liveMixSource != nullptr)
+        return static_cast<double>(liveMixSource->getTotalLength()) / liveMixSource->getSampleRate();
+    if (readerSource != nullptr)
+        return static_cast<double>(readerSource->getTotalLength()) / readerSource->getAudioFormatReader()->sampleRate;
     return 0.0;
 }
 
@@ -386,7 +673,7 @@ bool LucidkaraokeAudioProcessor::isPaused() const
 
 bool LucidkaraokeAudioProcessor::isLoaded() const
 {
-    return (usingMixedSource ? mixedReaderSource != nullptr : readerSource != nullptr);
+    return (usingMixedSource ? liveMixSource != nullptr : readerSource != nullptr);
 }
 
 void LucidkaraokeAudioProcessor::changeListenerCallback(juce::ChangeBroadcaster* source)
@@ -399,15 +686,7 @@ void LucidkaraokeAudioProcessor::changeListenerCallback(juce::ChangeBroadcaster*
             // File has reached the end - stop recording and playback
             changeState(Stopped);
             if (isRecording())
-            {
                 stopRecording();
-                
-                // If this was a complete recording session, trigger vocal mixing
-                if (completeRecordingSession)
-                {
-                    sendChangeMessage(); // Notify UI about complete recording
-                }
-            }
         }
     }
 }
@@ -428,20 +707,13 @@ void LucidkaraokeAudioProcessor::changeState(TransportState newState)
                 
             case Paused:
                 transportSource.stop();
-                // Pause recording (keep connection alive but stop writing)
+                // Pausing closes the take, so seeking before resuming can't misplace the rest of it
                 if (isRecording())
-                {
-                    recordingPaused = true;
-                }
+                    stopRecording();
                 break;
                 
             case Playing:
                 transportSource.start();
-                // Resume recording if it was paused
-                if (isRecording())
-                {
-                    recordingPaused = false;
-                }
                 break;
         }
     }
@@ -456,64 +728,121 @@ void LucidkaraokeAudioProcessor::startRecording()
         
     stopRecording(); // Stop any existing recording
 
-    // Create a unique filename in temp directory
-    auto tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory);
-    auto timestamp = juce::Time::getCurrentTime().formatted("%Y%m%d_%H%M%S");
-    recordingFile = tempDir.getChildFile("LucidKaraoke_Recording_" + timestamp + ".wav");
+    // Normally already armed when the song was loaded, in which case this costs nothing
+    if (!inputArmed.load())
+        armRecordingInput();
 
-    // Create WAV writer for mono recording
-    juce::WavAudioFormat wavFormat;
-    std::unique_ptr<juce::FileOutputStream> fileStream(recordingFile.createOutputStream());
+    if (takeManager == nullptr)
+        return;
+
+    auto sampleRate = getRecordingInputSampleRate();
+    auto isFlac = recordingFormat == RecordingFormat::Flac24;
 
-    if (fileStream != nullptr)
+    // Every take is appended to the song's take container
+    auto takeStream = takeManager->beginTake();
+
+    if (takeStream != nullptr)
     {
-        auto* currentDevice = recordingDeviceManager.getCurrentAudioDevice();
-        auto sampleRate = currentDevice ? currentDevice->getCurrentSampleRate() : 44100.0;
-        auto bitDepth = 16;
+        auto* currentDevice = getActiveRecordingDevice();
+
+        recordingSampleRate = sampleRate;
+
+        // Prefer the measured round trip, otherwise trust what the driver reports. A shared
+        // device is compared against its own output, so both directions count. A plugin can't
+        // see the host's driver latency at all, so without a calibration it records as-is.
+        // The round trip is only ever taken out here, never reported to the host: nothing we
+        // play is delayed by it, so the host's compensation would shift our output instead.
+        if (calibratedLatencySeconds >= 0.0)
+            recordingLatencyCompensation = juce::roundToInt(calibratedLatencySeconds * sampleRate);
+        else if (currentDevice == nullptr)
+            recordingLatencyCompensation = 0;
+        else if (inputFromProcessBlock.load())
+            recordingLatencyCompensation = currentDevice->getInputLatencyInSamples() + currentDevice->getOutputLatencyInSamples();
+        else
+            recordingLatencyCompensation = currentDevice->getInputLatencyInSamples();
+        recordingStartSeconds = transportSource.getCurrentPosition();
+
+        // Reserve room for the rest of the song up front. FLAC roughly halves what we need.
+        auto bytesPerSample = getRecordingBitDepth() / 8;
+        auto expectedSeconds = transportSource.getLengthInSeconds() - recordingStartSeconds + preRollSeconds + 10.0;
+        auto expectedBytes = static_cast<juce::int64>(expectedSeconds * sampleRate * bytesPerSample / (isFlac ? 2 : 1));
+
+        auto& containerFile = takeManager->getFile();
+
+        // Deletions wait until the take is finished, so they never compete with it for the disk
+        storageManager->setPaused(true);
 
-        if (auto writer = wavFormat.createWriterFor(fileStream.release(),
-                                                    sampleRate,
-                                                    1, // Mono
-                                                    bitDepth,
-                                                    {},
-                                                    0))
+        if (!FilePreallocator::reserve(containerFile, containerFile.getSize() + expectedBytes))
+            juce::Logger::writeToLog("Could not preallocate " + containerFile.getFileName());
+
+        if (auto* newWriter = createRecordingWriter(takeStream.get(), sampleRate))
         {
             // Passes responsibility for deleting the stream to the writer object
-            threadedWriter.reset(new juce::AudioFormatWriter::ThreadedWriter(writer, backgroundThread, 32768));
+            takeStream.release();
 
-            // Start the audio device callback *before* setting the flag
-            recordingDeviceManager.addAudioCallback(recordingCallback.get());
+            // Hand the writer to the FIFO and let the background thread start draining it
+            // before the audio callback can push anything
+            recordingFifo->reset();
+            recordingFifo->setWriter(std::unique_ptr<juce::AudioFormatWriter>(newWriter));
 
-            // Now, swap over our active writer pointer so that the audio callback will start using it..
-            const juce::ScopedLock sl(writerLock);
-            activeWriter = threadedWriter.get();
-            
-            // Reset recording pause state when starting new recording
-            recordingPaused = false;
+            // A separate recording device runs off its own crystal, so resample the take onto the
+            // playback clock as it's written (the drift estimate has been converging since arming)
+            recordingFifo->setResamplingEnabled(!inputFromProcessBlock.load());
+            backgroundThread.addTimeSliceClient(recordingFifo.get());
+
+            takeSamplesCaptured = 0;
+            takeSongStartSample = 0;
+            takeAlignmentResolved = false;
+            takeHostTimelineStartSample = -1;
+            takePreRollSamples = 0;
+            takePreRollPending = true;
+            recordingActive = true;
             
             // Notify UI that recording has started
             sendChangeMessage();
         }
+        else
+        {
+            takeStream.reset();
+            takeManager->abandonTake();
+            storageManager->setPaused(false);
+        }
     }
 }
 
 void LucidkaraokeAudioProcessor::stopRecording()
 {
-    // First, clear this pointer to stop the audio callback from using our writer object..
-    { 
-        const juce::ScopedLock sl(writerLock);
-        activeWriter = nullptr;
-    }
+    // First, stop the audio callback from pushing any more data. The input stays armed and
+    // goes back to filling the pre-roll, so just wait out a block that's already in flight,
+    // after which the FIFO has no producer.
+    auto wasRecording = recordingActive.exchange(false);
+    waitForInputCallback();
 
-    // Now we can delete the writer object. It's done in this order because the deletion could
-    // take a little time while remaining data gets flushed to disk, so it's best to avoid blocking
-    // the audio callback while this happens.
-    threadedWriter.reset();
+    // Now take the FIFO away from the background thread and flush whatever is left.
+    // Deleting the writer can take a little time while the file is finalised, but the
+    // audio callback no longer shares anything with us so it can't be blocked by it.
+    backgroundThread.removeTimeSliceClient(recordingFifo.get());
+    recordingFifo->drain();
+    recordingFifo->releaseWriter().reset();
 
-    recordingDeviceManager.removeAudioCallback(recordingCallback.get());
-    
-    // Reset recording pause state when fully stopping
-    recordingPaused = false;
+    if (recordingFifo->getNumOverruns() > 0)
+        juce::Logger::writeToLog("Recording FIFO overruns: " + juce::String(recordingFifo->getNumOverruns())
+                                 + " (" + juce::String(recordingFifo->getNumDroppedSamples()) + " samples dropped)");
+
+    if (wasRecording && takeManager != nullptr)
+    {
+        juce::Logger::writeToLog("Recording clock drift: " + juce::String(driftEstimator.getDriftPpm(), 1) + " ppm");
+
+        // Closes the take's chunk off with its placement, then hands back the unused reservation
+        if (!takeManager->finishTake(*createTakeInfo()))
+            juce::Logger::writeToLog("Failed to store take in " + takeManager->getFile().getFullPathName());
+
+        FilePreallocator::releaseUnused(takeManager->getFile());
+    }
+
+    // Sweeps can go ahead again, now the take has grown the container
+    if (wasRecording)
+        storageManager->setPaused(false);
     
     // Notify UI that recording has stopped
     sendChangeMessage();
@@ -521,7 +850,485 @@ void LucidkaraokeAudioProcessor::stopRecording()
 
 bool LucidkaraokeAudioProcessor::isRecording() const
 {
-    return activeWriter.load() != nullptr;
+    return recordingActive.load();
+}
+
+void LucidkaraokeAudioProcessor::captureRecordingBlock(const float* const* data, int numChannels, int numSamples,
+                                                       juce::int64 blockHostTimeNs, juce::int64 hostTimelineSample)
+{
+    const CallbackSequenceScope inFlight(inputCallbackSequence);
+
+    if (!inputArmed.load())
+        return;
+
+    // Track both device clocks for every block, even between takes, so the drift estimate
+    // has converged by the time one starts. The playback side is whatever processBlock published last.
+    if (!inputFromProcessBlock.load())
+    {
+        driftEstimator.addRecordingObservation(blockHostTimeNs, recordingDeviceSamples);
+        recordingDeviceSamples += numSamples;
+
+        AudioClock::Anchor playbackAnchor;
+        if (playbackClock.read(playbackAnchor))
+            driftEstimator.addPlaybackObservation(playbackAnchor.hostTimeNs, playbackAnchor.deviceSamples);
+    }
+
+    if (numChannels <= 0 || data[0] == nullptr)
+        return;
+
+    if (!recordingActive.load())
+    {
+        writePreRoll(data[0], numSamples);
+        return;
+    }
+
+    recordingFifo->setResamplingRatio(driftEstimator.getRatio());
+
+    // A take starts with whatever was sung just before it, which then sits at negative song positions
+    if (takePreRollPending.exchange(false))
+    {
+        takePreRollSamples = pushPreRoll();
+        takeSamplesCaptured = takePreRollSamples.load();
+    }
+
+    auto samplesBefore = takeSamplesCaptured.load();
+
+    // The first block captured while the transport is running pins the whole take to the
+    // song timeline. Blocks captured before playback got going simply land at negative positions.
+    if (!takeAlignmentResolved.load())
+    {
+        AudioClock::Anchor anchor;
+
+        if (playbackClock.read(anchor) && anchor.isRunning)
+        {
+            auto songPosition = AudioClock::getPositionAt(anchor, blockHostTimeNs, recordingSampleRate);
+            takeSongStartSample = static_cast<juce::int64>(std::llround(songPosition))
+                                    - samplesBefore - recordingLatencyCompensation;
+
+            // Also remember where the take landed on the DAW timeline so it can be dropped onto a track
+            if (hostTimelineSample >= 0)
+                takeHostTimelineStartSample = hostTimelineSample - samplesBefore - recordingLatencyCompensation;
+
+            takeAlignmentResolved = true;
+        }
+    }
+
+    if (recordingFifo->push(data, numChannels, numSamples))
+        takeSamplesCaptured = samplesBefore + numSamples;
+}
+
+void LucidkaraokeAudioProcessor::writePreRoll(const float* data, int numSamples)
+{
+    auto capacity = preRollBuffer.getNumSamples();
+
+    if (capacity == 0)
+        return;
+
+    // Only the most recent capacity samples of a huge block can survive anyway
+    if (numSamples > capacity)
+    {
+        data += numSamples - capacity;
+        numSamples = capacity;
+    }
+
+    auto firstPart = juce::jmin(numSamples, capacity - preRollWritePosition);
+    preRollBuffer.copyFrom(0, preRollWritePosition, data, firstPart);
+
+    if (numSamples > firstPart)
+        preRollBuffer.copyFrom(0, 0, data + firstPart, numSamples - firstPart);
+
+    preRollWritePosition = (preRollWritePosition + numSamples) % capacity;
+    preRollFilled = juce::jmin(capacity, preRollFilled + numSamples);
+}
+
+int LucidkaraokeAudioProcessor::pushPreRoll()
+{
+    auto capacity = preRollBuffer.getNumSamples();
+    auto numSamples = juce::jmin(preRollSamples.load(), preRollFilled);
+
+    if (numSamples <= 0)
+        return 0;
+
+    // Oldest sample first, which may mean wrapping around the end of the ring
+    auto start = (preRollWritePosition - numSamples + capacity) % capacity;
+    auto firstPart = juce::jmin(numSamples, capacity - start);
+
+    const float* firstChunk[] = { preRollBuffer.getReadPointer(0, start) };
+    const float* secondChunk[] = { preRollBuffer.getReadPointer(0) };
+
+    // The FIFO is sized to hold a full pre-roll on top of normal headroom
+    if (!recordingFifo->push(firstChunk, 1, firstPart))
+        return 0;
+
+    if (numSamples > firstPart && !recordingFifo->push(secondChunk, 1, numSamples - firstPart))
+        return firstPart;
+
+    preRollFilled = 0;
+    return numSamples;
+}
+
+std::unique_ptr<juce::XmlElement> LucidkaraokeAudioProcessor::createTakeInfo()
+{
+    // Never saw the transport running - fall back to where playback was started from
+    if (!takeAlignmentResolved.load())
+        takeSongStartSample = static_cast<juce::int64>(recordingStartSeconds * recordingSampleRate)
+                                - takePreRollSamples.load() - recordingLatencyCompensation;
+
+    // Stored with the take so the mixer can place it without guessing
+    auto takeInfo = std::make_unique<juce::XmlElement>("TAKE");
+    takeInfo->setAttribute("sampleRate", recordingSampleRate);
+    takeInfo->setAttribute("songStartSample", juce::String(takeSongStartSample.load()));
+    // What reached the file, which drift correction makes a little more or less than was captured
+    takeInfo->setAttribute("numSamples", juce::String(recordingFifo->getNumSamplesWritten()));
+    takeInfo->setAttribute("latencyCompensationSamples", recordingLatencyCompensation);
+    takeInfo->setAttribute("preRollSamples", takePreRollSamples.load());
+    takeInfo->setAttribute("clockAligned", takeAlignmentResolved.load());
+    takeInfo->setAttribute("driftPpm", driftEstimator.getDriftPpm());
+    takeInfo->setAttribute("recordedAt", juce::Time::getCurrentTime().toISO8601(true));
+
+    if (takeHostTimelineStartSample.load() >= 0)
+        takeInfo->setAttribute("hostTimelineStartSample", juce::String(takeHostTimelineStartSample.load()));
+
+    return takeInfo;
+}
+
+//==============================================================================
+// Latency calibration
+bool LucidkaraokeAudioProcessor::startLatencyCalibration()
+{
+    if (calibrationInProgress || state != Stopped || isRecording())
+        return false;
+
+    if (!inputArmed.load() && !selectRecordingInput())
+        return false;
+
+    latencyCalibrator.prepare(currentSampleRate, getRecordingInputSampleRate());
+
+    if (!inputFromProcessBlock.load())
+        recordingDeviceManager.addAudioCallback(recordingCallback.get());
+
+    calibrationInProgress = true;
+    calibrationStartTime = juce::Time::getMillisecondCounter();
+    startTimer(50);
+
+    sendChangeMessage();
+    return true;
+}
+
+void LucidkaraokeAudioProcessor::timerCallback()
+{
+    if (!calibrationInProgress)
+    {
+        stopTimer();
+        return;
+    }
+
+    if (latencyCalibrator.isCaptureComplete())
+    {
+        finishLatencyCalibration();
+    }
+    else if (juce::Time::getMillisecondCounter() - calibrationStartTime > 5000)
+    {
+        // Nothing came back - no output running, or no input signal at all
+        juce::Logger::writeToLog("Latency calibration timed out");
+        latencyCalibrator.cancel();
+        lastCalibrationSucceeded = false;
+        calibrationInProgress = false;
+
+        if (!inputArmed.load())
+            recordingDeviceManager.removeAudioCallback(recordingCallback.get());
+        stopTimer();
+        sendChangeMessage();
+    }
+}
+
+void LucidkaraokeAudioProcessor::finishLatencyCalibration()
+{
+    stopTimer();
+
+    if (!inputArmed.load())
+        recordingDeviceManager.removeAudioCallback(recordingCallback.get());
+
+    float confidence = 0.0f;
+    auto latencySamples = latencyCalibrator.analyse(confidence);
+
+    lastCalibrationSucceeded = latencySamples >= 0;
+
+    if (lastCalibrationSucceeded)
+    {
+        calibratedLatencySeconds = latencySamples / getRecordingInputSampleRate();
+
+        if (auto* settings = appProperties.getUserSettings())
+        {
+            settings->setValue("roundTripLatency:" + getRecordingDeviceName(), calibratedLatencySeconds);
+            settings->saveIfNeeded();
+        }
+    }
+
+    calibrationInProgress = false;
+    sendChangeMessage();
+}
+
+void LucidkaraokeAudioProcessor::loadCalibratedLatency()
+{
+    calibratedLatencySeconds = -1.0;
+
+    if (auto* settings = appProperties.getUserSettings())
+        calibratedLatencySeconds = settings->getDoubleValue("roundTripLatency:" + getRecordingDeviceName(), -1.0);
+}
+
+juce::String LucidkaraokeAudioProcessor::getRecordingDeviceName() const
+{
+    // In a host the calibration belongs to whatever the DAW is routing into us
+    if (wrapperType != wrapperType_Standalone)
+        return "Host input - " + juce::String(juce::PluginHostType().getHostDescription());
+
+    if (auto* device = getActiveRecordingDevice())
+        return device->getName();
+
+    return {};
+}
+
+//==============================================================================
+// Recording device selection
+void LucidkaraokeAudioProcessor::setRecordingSource(RecordingSource newSource)
+{
+    recordingSource = newSource;
+
+    if (auto* settings = appProperties.getUserSettings())
+    {
+        settings->setValue("recordingSource", static_cast<int>(newSource));
+        settings->saveIfNeeded();
+    }
+
+    if (inputArmed.load() && !isRecording())
+        armRecordingInput();
+}
+
+void LucidkaraokeAudioProcessor::setStorageBudgetMegabytes(int megabytes)
+{
+    megabytes = juce::jmax(0, megabytes);
+    storageManager->setBudget(static_cast<juce::int64>(megabytes) * 1024 * 1024);
+
+    if (auto* settings = appProperties.getUserSettings())
+    {
+        settings->setValue("storageBudgetMB", megabytes);
+        settings->saveIfNeeded();
+    }
+}
+
+void LucidkaraokeAudioProcessor::setLosslessStems(bool shouldBeLossless)
+{
+    losslessStems = shouldBeLossless;
+
+    if (auto* settings = appProperties.getUserSettings())
+    {
+        settings->setValue("losslessStems", shouldBeLossless);
+        settings->saveIfNeeded();
+    }
+}
+
+void LucidkaraokeAudioProcessor::setPreRollSeconds(double newPreRollSeconds)
+{
+    preRollSeconds = juce::jlimit(0.0, maxPreRollSeconds, newPreRollSeconds);
+    preRollSamples = juce::jlimit(0, preRollBuffer.getNumSamples(),
+                                  juce::roundToInt(preRollSeconds * getRecordingInputSampleRate()));
+
+    if (auto* settings = appProperties.getUserSettings())
+    {
+        settings->setValue("preRollSeconds", preRollSeconds);
+        settings->saveIfNeeded();
+    }
+}
+
+void LucidkaraokeAudioProcessor::setRecordingFormat(RecordingFormat newFormat)
+{
+    recordingFormat = newFormat;
+
+    if (auto* settings = appProperties.getUserSettings())
+    {
+        settings->setValue("recordingFormat", static_cast<int>(newFormat));
+        settings->saveIfNeeded();
+    }
+}
+
+int LucidkaraokeAudioProcessor::getRecordingBitDepth() const
+{
+    switch (recordingFormat)
+    {
+        case RecordingFormat::Wav24:
+        case RecordingFormat::Flac24:
+            return 24;
+        case RecordingFormat::WavFloat32:
+            return 32;
+        case RecordingFormat::Wav16:
+        default:
+            return 16;
+    }
+}
+
+juce::AudioFormatWriter* LucidkaraokeAudioProcessor::createRecordingWriter(juce::OutputStream* stream, double sampleRate)
+{
+    // 32-bit WAV is written as IEEE float, so a hot singer can go over full scale without clipping
+    if (recordingFormat == RecordingFormat::Flac24)
+    {
+        juce::FlacAudioFormat flacFormat;
+
+        // Lowest compression level - it's encoded in real time on the recorder thread
+        return flacFormat.createWriterFor(stream, sampleRate, 1, getRecordingBitDepth(), {}, 0);
+    }
+
+    juce::WavAudioFormat wavFormat;
+    return wavFormat.createWriterFor(stream, sampleRate, 1, getRecordingBitDepth(), {}, 0);
+}
+
+void LucidkaraokeAudioProcessor::armRecordingInput()
+{
+    if (!recordingEnabled || calibrationInProgress || isRecording())
+        return;
+
+    disarmRecordingInput();
+
+    if (!selectRecordingInput())
+        return;
+
+    // Nothing on the audio side touches any of this until the input is armed again below
+    auto sampleRate = getRecordingInputSampleRate();
+    auto capacity = static_cast<int>(std::ceil(maxPreRollSeconds * sampleRate));
+
+    preRollBuffer.setSize(1, capacity);
+    preRollBuffer.clear();
+    preRollWritePosition = 0;
+    preRollFilled = 0;
+    preRollSamples = juce::jlimit(0, capacity, juce::roundToInt(preRollSeconds * sampleRate));
+
+    // Enough headroom for the writer to stall for a second at the device rate, on top of a full pre-roll
+    recordingFifo = std::make_unique<RecordingFifo>(1, capacity + juce::roundToInt(sampleRate));
+    driftEstimator.reset(currentSampleRate, sampleRate);
+    recordingDeviceSamples = 0;
+
+    inputArmed = true;
+
+    if (!inputFromProcessBlock.load())
+        recordingDeviceManager.addAudioCallback(recordingCallback.get());
+}
+
+void LucidkaraokeAudioProcessor::disarmRecordingInput()
+{
+    inputArmed = false;
+
+    if (!calibrationInProgress)
+        recordingDeviceManager.removeAudioCallback(recordingCallback.get());
+
+    waitForInputCallback();
+}
+
+void LucidkaraokeAudioProcessor::waitForInputCallback()
+{
+    // The state was changed before this looks, so a block that starts from here on sees the
+    // new state. Only one already in flight can have seen the old one - wait for it to leave,
+    // without taking a lock the audio thread would then have to wait on.
+    auto sequence = inputCallbackSequence.load();
+
+    if ((sequence & 1) == 0)
+        return;
+
+    while (inputCallbackSequence.load() == sequence)
+        juce::Thread::yield();
+}
+
+juce::AudioIODevice* LucidkaraokeAudioProcessor::getDuplexDevice() const
+{
+   #if JucePlugin_Build_Standalone
+    // Only usable when the standalone device is actually running inputs and isn't muting
+    // them to avoid feedback, otherwise we'd record silence
+    if (wrapperType == wrapperType_Standalone)
+    {
+        if (auto* holder = juce::StandalonePluginHolder::getInstance())
+        {
+            auto* device = holder->deviceManager.getCurrentAudioDevice();
+
+            if (device != nullptr && device->isPlaying()
+                && device->getActiveInputChannels().countNumberOfSetBits() > 0
+                && !static_cast<bool>(holder->getMuteInputValue().getValue()))
+                return device;
+        }
+    }
+   #endif
+
+    return nullptr;
+}
+
+bool LucidkaraokeAudioProcessor::selectRecordingInput()
+{
+    auto available = true;
+
+    if (wrapperType != wrapperType_Standalone)
+    {
+        // The DAW owns the audio interface - take whatever it sends to our input bus
+        inputFromProcessBlock = getTotalNumInputChannels() > 0;
+        available = inputFromProcessBlock.load();
+    }
+    else
+    {
+        inputFromProcessBlock = recordingSource == RecordingSource::SharedDevice && getDuplexDevice() != nullptr;
+
+        // Fall back to opening the default input on its own
+        if (!inputFromProcessBlock.load())
+        {
+            openRecordingDevice();
+            available = recordingDeviceManager.getCurrentAudioDevice() != nullptr;
+        }
+    }
+
+    // Latency is measured per input, so pick up the right calibration for whichever one won
+    auto deviceName = getRecordingDeviceName();
+
+    if (deviceName != calibratedDeviceName)
+    {
+        calibratedDeviceName = deviceName;
+        loadCalibratedLatency();
+    }
+
+    return available;
+}
+
+double LucidkaraokeAudioProcessor::getRecordingInputSampleRate() const
+{
+    // Anything arriving through processBlock runs at the processor's own rate
+    if (inputFromProcessBlock.load())
+        return currentSampleRate;
+
+    if (auto* device = recordingDeviceManager.getCurrentAudioDevice())
+        return device->getCurrentSampleRate();
+
+    return 44100.0;
+}
+
+juce::AudioIODevice* LucidkaraokeAudioProcessor::getActiveRecordingDevice() const
+{
+    if (inputFromProcessBlock.load())
+        return getDuplexDevice();
+
+    return recordingDeviceManager.getCurrentAudioDevice();
+}
+
+void LucidkaraokeAudioProcessor::openRecordingDevice()
+{
+    if (recordingDeviceOpened)
+        return;
+
+    recordingDeviceOpened = true;
+    recordingDeviceManager.initialiseWithDefaultDevices(1, 0); // 1 input, 0 outputs
+
+    juce::AudioDeviceManager::AudioDeviceSetup setup;
+    recordingDeviceManager.getAudioDeviceSetup(setup);
+
+    if (setup.inputDeviceName.isNotEmpty())
+    {
+        setup.inputChannels.setBit(0);
+        recordingDeviceManager.setAudioDeviceSetup(setup, true);
+    }
 }
 
 //==============================================================================
@@ -533,15 +1340,12 @@ void LucidkaraokeAudioProcessor::RecordingCallback::audioDeviceIOCallbackWithCon
     int numOutputChannels,
     int numSamples, const juce::AudioIODeviceCallbackContext& context)
 {
-    juce::ignoreUnused(context);
+    auto blockHostTimeNs = AudioClock::getHostTimeNs(context.hostTimeNs);
 
-    const juce::ScopedLock sl(owner.writerLock);
+    if (owner.latencyCalibrator.isRunning() && numInputChannels > 0)
+        owner.latencyCalibrator.captureInput(inputChannelData[0], numSamples, blockHostTimeNs, owner.playbackClock);
 
-    if (owner.activeWriter.load() != nullptr && !owner.recordingPaused && 
-        numInputChannels > 0 && inputChannelData[0] != nullptr)
-    {
-        owner.activeWriter.load()->write(inputChannelData, numSamples);
-    }
+    owner.captureRecordingBlock(inputChannelData, numInputChannels, numSamples, blockHostTimeNs);
 
     // Clear output buffers (we don't want to output anything)
     for (int i = 0; i < numOutputChannels; ++i)
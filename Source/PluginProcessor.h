@@ -9,13 +9,23 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Audio/RecordingFifo.h"
+#include "Audio/AudioClock.h"
+#include "Audio/LatencyCalibrator.h"
+#include "Audio/DriftEstimator.h"
+#include "Audio/TakeManager.h"
+#include "Audio/LiveMixSource.h"
+#include "Audio/PeakLimiter.h"
+#include "Audio/PolyphaseResamplingSource.h"
+#include "Audio/StorageManager.h"
 
 //==============================================================================
 /**
 */
 class LucidkaraokeAudioProcessor  : public juce::AudioProcessor,
                                    public juce::ChangeListener,
-                                   public juce::ChangeBroadcaster
+                                   public juce::ChangeBroadcaster,
+                                   private juce::Timer
 {
 public:
     //==============================================================================
@@ -58,10 +68,34 @@ public:
     //==============================================================================
     // Audio file handling
     void loadFile(const juce::File& file);
-    void loadMixedFile(const juce::File& file);
     void setSourceToggle(bool useMixed);
     juce::AudioFormatReaderSource* getOriginalSource() const { return readerSource.get(); }
-    juce::AudioFormatReaderSource* getMixedSource() const { return mixedReaderSource.get(); }
+    
+    // The mixed source is a live mix of this backing track and every take so far, so a take
+    // can be heard as soon as it's recorded. Calling it again picks up new takes.
+    bool startLivePreview(const juce::File& backingTrackFile);
+    
+    // The same for a backing track that's still arriving - the file only identifies it, and with
+    // the same one as last time the takes are swapped in and reader isn't needed
+    bool startLivePreview(std::unique_ptr<juce::AudioFormatReader> reader, const juce::File& backingTrackFile);
+    bool hasLivePreview() const { return liveMixSource != nullptr; }
+    
+    // Back to the original, letting go of the backing track the live mix was reading
+    void stopLivePreview();
+    
+    // Live mix controls. Level and pan apply from the next block.
+    void setPreviewVocalGainDb(float gainDb);
+    void setPreviewBackingGainDb(float gainDb);
+    void setPreviewVocalPan(float pan);     // -1 is hard left, 1 hard right
+    float getPreviewVocalGainDb() const { return juce::Decibels::gainToDecibels(previewVocalGain.load()); }
+    float getPreviewBackingGainDb() const { return juce::Decibels::gainToDecibels(previewBackingGain.load()); }
+    float getPreviewVocalPan() const { return previewVocalPan; }
+    void setPreviewVocalOffsetSeconds(double seconds);
+    
+    // Filter used to bring playback to the device rate. Higher tiers cost more CPU per block.
+    void setResamplerQuality(PolyphaseResampler::Quality newQuality);
+    PolyphaseResampler::Quality getResamplerQuality() const { return resamplerQuality; }
+    
     void play();
     void pause();
     void stop();
@@ -81,10 +115,63 @@ public:
     void startRecording();
     void stopRecording();
     bool isRecording() const;
-    bool isCompleteRecording() const { return completeRecordingSession; }
-    juce::File getLastRecordingFile() const { return recordingFile; }
-    int getRecordingBufferSize() const { return recordingBufferSize; }
+    
+    // Every take recorded against the current song, newest last
+    const TakeManager* getTakeManager() const { return takeManager.get(); }
+    int getNumTakes() const { return takeManager != nullptr ? takeManager->getNumTakes() : 0; }
+    juce::int64 getLastRecordingSongStartSample() const { return takeSongStartSample.load(); }
     void setRecordingEnabled(bool enabled) { recordingEnabled = enabled; }
+    
+    // How much of the input from just before Play is kept at the start of each take
+    void setPreRollSeconds(double newPreRollSeconds);
+    double getPreRollSeconds() const { return preRollSeconds; }
+    static constexpr double maxPreRollSeconds = 4.0;
+    
+    // File format for new takes. FLAC is encoded in real time and roughly halves the disk traffic.
+    enum class RecordingFormat
+    {
+        Wav16,
+        Wav24,
+        WavFloat32,
+        Flac24
+    };
+    
+    void setRecordingFormat(RecordingFormat newFormat);
+    RecordingFormat getRecordingFormat() const { return recordingFormat; }
+    
+    //==============================================================================
+    // Round-trip latency calibration
+    bool startLatencyCalibration();
+    bool isCalibratingLatency() const { return calibrationInProgress; }
+    bool didLastCalibrationSucceed() const { return lastCalibrationSucceeded; }
+    double getCalibratedLatencySeconds() const { return calibratedLatencySeconds; }
+    juce::int64 getRecordingOverrunCount() const { return recordingFifo->getNumOverruns(); }
+    juce::int64 getRecordingDroppedSamples() const { return recordingFifo->getNumDroppedSamples(); }
+    double getRecordingDriftPpm() const { return driftEstimator.getDriftPpm(); }
+    
+    // Where takes come from in the standalone app. SharedDevice records from the app's own device
+    // in processBlock when it runs full duplex, and falls back to SeparateDevice when it can't.
+    // As a plugin, takes always come from the host's input bus.
+    enum class RecordingSource
+    {
+        SeparateDevice,
+        SharedDevice
+    };
+    
+    void setRecordingSource(RecordingSource newSource);
+    RecordingSource getRecordingSource() const { return recordingSource; }
+    bool isRecordingFromProcessBlock() const { return inputFromProcessBlock.load(); }
+    
+    // Disk the stem cache, takes and other intermediates may use before the oldest are deleted
+    void setStorageBudgetMegabytes(int megabytes);
+    int getStorageBudgetMegabytes() const { return static_cast<int>(storageManager->getBudget() / (1024 * 1024)); }
+    StorageManager& getStorageManager() { return *storageManager; }
+    static constexpr int defaultStorageBudgetMegabytes = 10 * 1024;
+    
+    // Whether the separation service is asked for FLAC stems or smaller MP3 ones. Songs already
+    // cached in the other format are separated again.
+    void setLosslessStems(bool shouldBeLossless);
+    bool getLosslessStems() const { return losslessStems; }
 
 private:
     class RecordingCallback : public juce::AudioIODeviceCallback
@@ -107,14 +194,61 @@ private:
     
     friend class RecordingCallback;
 
+    // Pushes one block of input into the current take, aligning it to the playback clock
+    void captureRecordingBlock(const float* const* data, int numChannels, int numSamples, juce::int64 blockHostTimeNs,
+                               juce::int64 hostTimelineSample = -1);
+    std::unique_ptr<juce::XmlElement> createTakeInfo();
+
+    void timerCallback() override;
+    void finishLatencyCalibration();
+    void loadCalibratedLatency();
+    juce::String getRecordingDeviceName() const;
+
+    juce::AudioIODevice* getDuplexDevice() const;
+    bool selectRecordingInput();
+    double getRecordingInputSampleRate() const;
+    juce::AudioIODevice* getActiveRecordingDevice() const;
+    void openRecordingDevice();
+
+    // The input stays open from the moment a song is loaded, keeping the last few seconds
+    // in a ring buffer so a take starts instantly and can include some pre-roll
+    void armRecordingInput();
+    void disarmRecordingInput();
+    void waitForInputCallback();
+    void writePreRoll(const float* data, int numSamples);
+    int pushPreRoll();
+
+    int getRecordingBitDepth() const;
+    juce::AudioFormatWriter* createRecordingWriter(juce::OutputStream* stream, double sampleRate);
+
 private:
     //==============================================================================
     juce::AudioFormatManager formatManager;
     std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
-    std::unique_ptr<juce::AudioFormatReaderSource> mixedReaderSource;
+    std::unique_ptr<LiveMixSource> liveMixSource;
+    juce::File liveMixBackingFile;
+    
+    // Both sources reach the transport through these, already at the device rate
+    std::unique_ptr<PolyphaseResamplingSource> originalResampler;
+    std::unique_ptr<PolyphaseResamplingSource> liveMixResampler;
+    PolyphaseResampler::Quality resamplerQuality = PolyphaseResampler::Quality::Standard;
     juce::AudioTransportSource transportSource;
     juce::MixerAudioSource mixerSource;
-    bool usingMixedSource;
+    std::atomic<bool> usingMixedSource;
+    
+    // The live mix arrives as backing track and vocal stems, and is mixed down in processBlock
+    // so level and pan changes don't wait for the read-ahead buffer
+    juce::AudioBuffer<float> previewBuffer;
+    PeakLimiter previewLimiter;
+    std::atomic<float> previewVocalGain { 1.0f };
+    std::atomic<float> previewBackingGain { 1.0f };
+    std::atomic<float> previewVocalPan { 0.0f };
+    float appliedBackingGain = 1.0f, appliedVocalLeft = 1.0f, appliedVocalRight = 1.0f;
+    double previewVocalOffsetSeconds = 0.0;
+    
+    void renderLivePreview(juce::AudioBuffer<float>& buffer);
+    void attachTransportSource(bool useMixed);
+    double getCurrentSourceLengthSeconds() const;
     
     enum TransportState
     {
@@ -125,36 +259,79 @@ private:
     
     TransportState state;
     juce::URL lastFileURL;
+    double currentSampleRate = 44100.0;
+    
+    // Where the transport was at which host time, published from processBlock
+    AudioClock playbackClock;
+    juce::int64 playbackDeviceSamples = 0;
     
     void changeState(TransportState newState);
     
     //==============================================================================
     // Recording members
-    std::unique_ptr<juce::AudioFormatWriter> writer;
-    juce::File recordingFile;
+    std::unique_ptr<TakeManager> takeManager;
     
-    // Independent audio device for recording
+    // Independent audio device for recording, opened on first use
     juce::AudioDeviceManager recordingDeviceManager;
     std::unique_ptr<juce::AudioIODeviceCallback> recordingCallback;
+    bool recordingDeviceOpened = false;
+    
+    RecordingSource recordingSource = RecordingSource::SharedDevice;
+    std::atomic<bool> inputFromProcessBlock { false };
+    std::atomic<bool> inputArmed { false };
+    
+    // Bumped on the way into and out of captureRecordingBlock, so it's odd while a block is
+    // in there. Lets the message thread wait a block out without a lock the audio thread needs.
+    std::atomic<juce::uint32> inputCallbackSequence { 0 };
+    
+    // Pre-roll ring, only touched by the input callback while armed
+    juce::AudioBuffer<float> preRollBuffer;
+    int preRollWritePosition = 0;
+    int preRollFilled = 0;
+    std::atomic<int> preRollSamples { 0 };
+    std::atomic<bool> takePreRollPending { false };
+    std::atomic<int> takePreRollSamples { 0 };
+    double preRollSeconds = 0.5;
+    
+    RecordingFormat recordingFormat = RecordingFormat::Wav16;
+    bool losslessStems = true;
 
-    // For threaded recording
+    // For threaded recording - the input callback only ever pushes into the FIFO,
+    // the background thread owns the writer and does all of the disk I/O
     juce::TimeSliceThread backgroundThread { "Audio Recorder Thread" };
-    std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> threadedWriter;
-    juce::CriticalSection writerLock;
-    std::atomic<juce::AudioFormatWriter::ThreadedWriter*> activeWriter { nullptr };
+    std::unique_ptr<RecordingFifo> recordingFifo;
+    std::atomic<bool> recordingActive { false };
     
-    // Track complete recording sessions (from start to finish)
-    bool completeRecordingSession = false;
-    double recordingStartPosition = 0.0;
+    // Alignment of the current take against the song. takeSongStartSample is the song
+    // position (in recording samples) of the first recorded sample, and may be negative
+    double recordingSampleRate = 44100.0;
+    double recordingStartSeconds = 0.0;
+    int recordingLatencyCompensation = 0;
+    std::atomic<juce::int64> takeSamplesCaptured { 0 };
+    std::atomic<juce::int64> takeSongStartSample { 0 };
+    std::atomic<bool> takeAlignmentResolved { false };
+    std::atomic<juce::int64> takeHostTimelineStartSample { -1 };
     
-    // Track recording pause state for transport synchronization
-    bool recordingPaused = false;
-    
-    // Store audio buffer size for latency compensation
-    int recordingBufferSize = 0;
+    // Playback vs recording device clock drift, corrected by resampling in the FIFO
+    DriftEstimator driftEstimator;
+    juce::int64 recordingDeviceSamples = 0;
     
     // Control recording availability
     bool recordingEnabled = true;
+    
+    // Round-trip latency measured for the current recording device, in seconds (-1 = not measured)
+    LatencyCalibrator latencyCalibrator;
+    bool calibrationInProgress = false;
+    bool lastCalibrationSucceeded = false;
+    juce::uint32 calibrationStartTime = 0;
+    double calibratedLatencySeconds = -1.0;
+    juce::String calibratedDeviceName;
+    
+    // Persistent per-user settings (calibration results etc.)
+    juce::ApplicationProperties appProperties;
+    
+    // Evicts old stems and takes in the background, and holds off while recording
+    std::unique_ptr<StorageManager> storageManager;
 
     // File logger
     std::unique_ptr<juce::FileLogger> fileLogger;
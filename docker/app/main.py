@@ -5,6 +5,9 @@ Simple wrapper around DeMucs CLI with pre-downloaded weights
 """
 
 import os
+import re
+import uuid
+import hashlib
 import tempfile
 import shutil
 import zipfile
@@ -12,7 +15,7 @@ import subprocess
 from pathlib import Path
 from typing import Optional
 
-from fastapi import FastAPI, File, UploadFile, HTTPException, BackgroundTasks
+from fastapi import FastAPI, File, Form, UploadFile, HTTPException, BackgroundTasks
 from fastapi.responses import FileResponse
 from fastapi.middleware.cors import CORSMiddleware
 import uvicorn
@@ -30,6 +33,51 @@ def is_gpu_available() -> bool:
         except:
             return False
 
+# Finished separations, keyed by the SHA-256 of the uploaded file, so a client that sends
+# just the hash of something we've already separated gets the stems without uploading it
+RESULT_CACHE_DIR = Path(os.getenv("RESULT_CACHE_DIR", "/app/temp/results"))
+RESULT_CACHE_MAX_BYTES = int(os.getenv("RESULT_CACHE_MAX_MB", 5000)) * 1024 * 1024
+
+HASH_PATTERN = re.compile(r"^[0-9a-f]{64}$")
+MODEL_PATTERN = re.compile(r"^[A-Za-z0-9_]+$")
+
+def result_cache_path(audio_hash: str, model: str, format: str, bitrate: int) -> Path:
+    """Where the stems for this file and these settings are kept"""
+    variant = f"{model}_{format}_{bitrate}" if format == "mp3" else f"{model}_{format}"
+    return RESULT_CACHE_DIR / f"{audio_hash}_{variant}.zip"
+
+def store_result(output_zip: Path, cache_path: Path):
+    """Copies a finished archive into the result cache, then trims the cache to size"""
+    try:
+        RESULT_CACHE_DIR.mkdir(parents=True, exist_ok=True)
+        # Written under another name and renamed, so a concurrent lookup never sees half of it
+        partial_path = cache_path.with_name(f".{cache_path.name}.{uuid.uuid4().hex}")
+        shutil.copyfile(output_zip, partial_path)
+        os.replace(partial_path, cache_path)
+        prune_result_cache()
+    except OSError as e:
+        print(f"Could not cache result {cache_path.name}: {e}")
+
+def prune_result_cache():
+    """Deletes the least recently used results until the cache is within its budget"""
+    entries = []
+    for path in RESULT_CACHE_DIR.glob("*.zip"):
+        try:
+            stat = path.stat()
+            entries.append((stat.st_mtime, stat.st_size, path))
+        except OSError:
+            pass
+
+    total = sum(size for _, size, _ in entries)
+    for _, size, path in sorted(entries):
+        if total <= RESULT_CACHE_MAX_BYTES:
+            break
+        try:
+            path.unlink()
+            total -= size
+        except OSError:
+            pass
+
 app = FastAPI(
     title="DeMucs Stem Separation Service",
     description="HTTP API for AI-powered audio stem separation using DeMucs CLI",
@@ -74,14 +122,55 @@ async def list_models():
 @app.post("/separate")
 async def separate_stems(
     background_tasks: BackgroundTasks,
-    audio_file: UploadFile = File(...),
-    model: Optional[str] = "htdemucs_ft",
-    format: Optional[str] = "mp3",
-    bitrate: Optional[int] = 320
+    audio_file: Optional[UploadFile] = File(None),
+    audio_hash: Optional[str] = Form(None),
+    model: Optional[str] = Form("htdemucs_ft"),
+    format: Optional[str] = Form("mp3"),
+    bitrate: Optional[int] = Form(320)
 ):
     """
-    Separate audio stems from uploaded file using DeMucs CLI
+    Separate audio stems from uploaded file using DeMucs CLI.
+
+    Send audio_hash (the file's SHA-256) without audio_file to ask for stems we already
+    have: they come back straight away, or a 404 asks for the upload.
     """
+    if audio_hash is not None:
+        audio_hash = audio_hash.lower()
+        if not HASH_PATTERN.match(audio_hash):
+            raise HTTPException(status_code=400, detail="audio_hash must be a hex SHA-256 digest")
+
+    if not MODEL_PATTERN.match(model or ""):
+        raise HTTPException(status_code=400, detail=f"Invalid model name: {model}")
+    
+    # Lossless formats let the client mix and re-encode without stacking up MP3 generations
+    format_flags = {
+        "mp3": ["--mp3", "--mp3-bitrate", str(bitrate)],
+        "flac": ["--flac"],
+        "wav": ["--float32"],
+    }
+    if format not in format_flags:
+        raise HTTPException(
+            status_code=400,
+            detail=f"Unsupported output format: {format}. Supported: {', '.join(format_flags)}"
+        )
+    
+    if audio_file is None:
+        if audio_hash is None:
+            raise HTTPException(status_code=400, detail="Send audio_file, or audio_hash to look up a previous result")
+        
+        # Touched so the cache evicts what hasn't been asked for in longest
+        cached_zip = result_cache_path(audio_hash, model, format, bitrate)
+        try:
+            os.utime(cached_zip)
+        except FileNotFoundError:
+            raise HTTPException(status_code=404, detail="No stems for this hash - upload the audio")
+        
+        return FileResponse(
+            path=str(cached_zip),
+            filename=f"{audio_hash[:16]}_stems.zip",
+            media_type="application/zip"
+        )
+    
     if not audio_file.filename:
         raise HTTPException(status_code=400, detail="No file provided")
     
@@ -106,6 +195,11 @@ async def separate_stems(
             content = await audio_file.read()
             f.write(content)
         
+        # Keyed by what actually arrived rather than what the client says it sent
+        uploaded_hash = hashlib.sha256(content).hexdigest()
+        if audio_hash is not None and audio_hash != uploaded_hash:
+            print(f"audio_hash {audio_hash} doesn't match the upload ({uploaded_hash}), caching under the latter")
+        
         # Run DeMucs CLI command
         output_dir = Path(temp_dir) / "output"
         output_dir.mkdir(exist_ok=True)
@@ -115,8 +209,7 @@ async def separate_stems(
         print(f"DEBUG: is_gpu_available() result before command build: {gpu_is_available_for_demucs}")
         cmd = [
             "python", "-m", "demucs",
-            "--mp3",
-            "--mp3-bitrate", str(bitrate),
+            *format_flags[format],
             "-n", model,
             "-o", str(output_dir)
         ]
@@ -146,12 +239,15 @@ async def separate_stems(
         if not stems_dir.exists():
             raise Exception("Stems directory not found")
         
-        # Create ZIP file with stems
+        # Create ZIP file with stems. Stored rather than deflated: the audio is already
+        # compressed, and stored entries can be read in place without extracting them.
         output_zip = Path(temp_dir) / f"{Path(audio_file.filename).stem}_stems.zip"
-        with zipfile.ZipFile(output_zip, 'w', zipfile.ZIP_DEFLATED) as zipf:
-            for stem_file in stems_dir.glob("*.mp3"):
+        with zipfile.ZipFile(output_zip, 'w', zipfile.ZIP_STORED) as zipf:
+            for stem_file in stems_dir.glob(f"*.{format}"):
                 zipf.write(stem_file, stem_file.name)
         
+        store_result(output_zip, result_cache_path(uploaded_hash, model, format, bitrate))
+        
         # Schedule cleanup
         background_tasks.add_task(cleanup_temp_dir, temp_dir)
         
@@ -5,6 +5,7 @@ This script performs basic voice conversion using minimal RVC components
 """
 
 import argparse
+import json
 import os
 import sys
 import numpy as np
@@ -14,6 +15,10 @@ import torch
 import torchcrepe
 from scipy.signal import savgol_filter
 
+def report_progress(fraction, stage):
+    """Print a progress line for LucidKaraoke to parse - one JSON object per line"""
+    print(json.dumps({"progress": round(fraction, 3), "stage": stage}), flush=True)
+
 def extract_f0_crepe(audio, sr, hop_length=512):
     """Extract F0 using CREPE"""
     print("Extracting pitch using CREPE...")
@@ -80,12 +85,14 @@ def simple_voice_conversion(input_path, output_path, pitch_shift=0, f0_method="c
     In a full implementation, this would load and use RVC models
     """
     print(f"Loading audio from: {input_path}")
+    report_progress(0.05, "Loading audio")
     
     # Load audio
     audio, sr = librosa.load(input_path, sr=None)
     print(f"Audio loaded: {len(audio)} samples at {sr}Hz")
     
     # Extract F0
+    report_progress(0.1, "Extracting pitch")
     if f0_method == "crepe":
         f0 = extract_f0_crepe(audio, sr)
     else:
@@ -97,6 +104,7 @@ def simple_voice_conversion(input_path, output_path, pitch_shift=0, f0_method="c
     # Apply pitch shift
     if pitch_shift != 0:
         print(f"Applying pitch shift: {pitch_shift} semitones")
+        report_progress(0.5, "Shifting pitch")
         f0_shifted = apply_pitch_shift(f0, pitch_shift)
         
         # Use PSOLA or simple time-stretching for pitch shifting
@@ -107,6 +115,7 @@ def simple_voice_conversion(input_path, output_path, pitch_shift=0, f0_method="c
     
     # Apply some basic filtering to simulate voice conversion
     print("Applying voice processing...")
+    report_progress(0.75, "Processing voice")
     
     # Add slight formant shifting effect
     if pitch_shift != 0:
@@ -129,9 +138,13 @@ def simple_voice_conversion(input_path, output_path, pitch_shift=0, f0_method="c
     audio_converted = audio_converted / np.max(np.abs(audio_converted)) * 0.9
     
     print(f"Saving converted audio to: {output_path}")
-    sf.write(output_path, audio_converted, sr)
+    report_progress(0.9, "Saving audio")
+    # WAV output is an intermediate for the mixer, so keep it as float
+    subtype = "FLOAT" if output_path.lower().endswith(".wav") else None
+    sf.write(output_path, audio_converted, sr, subtype=subtype)
     
     print("Voice conversion completed successfully!")
+    report_progress(1.0, "Done")
     return True
 
 def main():